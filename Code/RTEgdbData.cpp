@@ -30,44 +30,85 @@
 #include "cmd_line.h"
 #include "rtedbg.h"
 #include "logger.h"
+#include "hex_codec.h"
+#include "data_stream.h"
+#include "autotune.h"
+#include "benchmark_suite.h"
+#include "file_writer.h"
+#include "snapshot_series.h"
+#include "multi_target.h"
+#include "packet_capture.h"
+#include "transfer_stats.h"
+#include "parallel_read.h"
 #include <tlhelp32.h>
 
 
 
 //********** Global variables ***********
-parameters_t parameters;             // Command line parameters
-uint32_t old_msg_filter;             // Filter value before data logging is disabled
-rtedbg_header_t rtedbg_header;       // Header of the g_rtedbg structure loaded from embedded system
-static unsigned* p_rtedbg_structure; // Pointer to memory area allocated for the g_rtedbg structure
+// The parameters and the target state are thread local - each -targets thread
+// transfers the data from its own embedded system (see multi_target.cpp).
+thread_local parameters_t parameters;             // Command line parameters
+thread_local uint32_t old_msg_filter;             // Filter value before data logging is disabled
+thread_local rtedbg_header_t rtedbg_header;       // Header of the g_rtedbg structure loaded from embedded system
+static thread_local unsigned* p_rtedbg_structure; // Pointer to memory area allocated for the g_rtedbg structure
+static thread_local bool snapshot_valid = false;  // true - p_rtedbg_structure contains the last data written to the file
+                                                  // (updated after the circular buffer has been cleared)
+static thread_local bool snapshot_submitted = false; // true - the last snapshot has been submitted to the writer thread (-async)
+static thread_local bool crc_supported = true;    // false - the GDB server does not support the qCRC request
+static thread_local unsigned* caller_buffer = NULL; // Buffer for the g_rtedbg structure provided by the library user
+static thread_local unsigned caller_buffer_size = 0; // Size of the caller_buffer [bytes]
+static bool auto_capture_armed = true; // false - the fill level trigger fires again when the usage drops below the level
+static uint32_t polled_filter = 0;   // Message filter value found at the previous poll (-auto argument)
+static unsigned auto_capture_count = 0; // Number of automatic data transfers
+static bool status_header_valid = false; // true - the cached rtedbg_header can be used for the logging status
+static unsigned status_idle_polls = 0; // Number of logging status polls without a buffer index change
 
 
 //*********** Local functions ***********
 static bool allocate_memory_for_g_rtedbg_structure(void);
 static void benchmark_data_transfer(void);
+static double measure_average_read_time(unsigned count, unsigned pipeline_depth);
 static int  check_header_info(void);
 static int  check_message_filter_disabled(void);
+static int  clear_circular_buffer(bool snapshot_available);
 static void decrease_priorities(void);
 static void delay_before_data_transfer(void);
 static void display_errors(const char* message);
-static void display_logging_state(clock_t* start_time);
+static bool display_logging_state(clock_t* start_time);
+static const char* auto_capture_trigger(unsigned buffer_usage);
+static int  poll_index_and_filter(void);
+static void auto_capture(void);
 static void execute_decode_batch_file(void);
 static int  erase_buffer_index(void);
 static DWORD GetProcessIdByName(const char* processName);
 static void increase_priorities(void);
-static int  load_rtedbg_structure_header(void);
+static void log_transfer_phases(const double* phase_times);
 static int  pause_data_logging(void);
 static int  persistent_connection(void);
 static void print_filter_info(void);
 static void print_rtedbg_header_info(void);
 static int  read_memory_block(unsigned char * buffer, uint32_t address, uint32_t size);
+static int  read_changed_parts(bool* data_changed);
+static int  read_logged_region(unsigned char* data, unsigned previous_index, unsigned* bytes_read,
+                unsigned* round_trips);
+static int  read_tail_window(void);
+static int  verify_snapshot_crc(void);
 static void repeat_start_command_file(void);
-static int  reset_circular_buffer(void);
+static int  reset_circular_buffer(bool snapshot_available);
+static int  clear_used_buffer_parts(void);
 static int  save_rtedbg_structure(void);
+static int  write_snapshot(bool complete_snapshot);
+static int  minimal_pause_transfer(double* phase_times, LARGE_INTEGER* phase_start, bool* overtaken);
+static int  read_oldest_data_first(uint32_t* words_logged);
+static int  update_header_from_snapshot(void);
 static void send_commands_from_file(char name_start);
 static int  set_or_restore_message_filter(void);
+static uint32_t restored_message_filter(void);
+static int  restore_filter_and_buffer_index(void);
 static void set_process_priority(const char * process_name, DWORD dwPriorityClass, bool report_error);
 static bool single_shot_active(void);
 static int  single_data_transfer(void);
+static void end_transfer_phase(double* phase_times, unsigned phase, LARGE_INTEGER* phase_start);
 static void show_help(void);
 static void switch_to_post_mortem_logging(void);
 static void switch_to_single_shot_logging(void);
@@ -83,11 +124,36 @@ static void switch_to_single_shot_logging(void);
  *         1 - error occurred
  */
 
+#ifndef RTEGDB_LIBRARY
 int __cdecl main(int argc, char * argv[])
 {
     int rez;
     clock_t main_start_time = clock_ms();
     process_command_line_parameters(argc, argv);
+    gdb_lib_init();                         // Shared tables prepared before any transfer thread is started
+
+    if (parameters.extract_series)
+    {
+        return series_extract_snapshot();   // Rebuild a snapshot without connecting to the GDB server
+    }
+
+    if (parameters.convert_file != NULL)
+    {
+        return capture_convert();           // Convert the capture file to text without connecting
+    }
+
+    if (parameters.target_count > 0)
+    {
+        increase_priorities();
+        rez = multi_target_transfer();      // Parallel data transfer from several embedded systems
+        decrease_priorities();
+        close_log_file();
+        (void)_fcloseall();
+        return rez;
+    }
+
+    start_communication_logging();
+    stats_init();
 
     if (gdb_connect(parameters.gdb_port) != GDB_OK)
     {
@@ -96,6 +162,7 @@ int __cdecl main(int argc, char * argv[])
             printf("Could not connect to the GDB server. Check the log file for details.\n");
         }
 
+        close_log_file();
         return 1;
     }
 
@@ -106,15 +173,23 @@ int __cdecl main(int argc, char * argv[])
         decrease_priorities();
         gdb_detach();
         gdb_socket_cleanup();
+        close_log_file();
         (void)_fcloseall();
         return 1;
     }
-    
+
+    parallel_read_start();
+    autotune_transfer_settings();
+
     if (parameters.persistent_connection)
     {
         rez = persistent_connection();
         printf("\n");
     }
+    else if (parameters.benchmark_file != NULL)
+    {
+        rez = run_benchmark_suite();
+    }
     else
     {
         rez = single_data_transfer();
@@ -126,12 +201,28 @@ int __cdecl main(int argc, char * argv[])
         }
     }
 
+    if (file_writer_stop() != GDB_OK)
+    {
+        rez = 1;
+    }
+
+    series_close();
+
+    if (parameters.stats)
+    {
+        stats_display();
+        (void)stats_write_file();
+    }
+
     decrease_priorities();
+    parallel_read_stop();
     gdb_detach();
     gdb_socket_cleanup();
+    close_log_file();
     (void)_fcloseall();
     return rez;
     }
+#endif  // RTEGDB_LIBRARY
 
 
 /***
@@ -148,65 +239,174 @@ static int single_data_transfer(void)
         printf("\nReading from embedded system ... ");
     }
 
-    gdb_handle_unexpected_messages();
-
-    // Read the current message filter value before turning off filtering.
-    int rez = gdb_read_memory((unsigned char*)&old_msg_filter, MESSAGE_FILTER_ADDRESS, 4U);
-    if (rez != GDB_OK)
+    if (data_transfer_cycle(NULL) != GDB_OK)
     {
         return 1;
     }
 
-    // Pause data logging if the old message filter is not zero.
-    if (old_msg_filter != 0)
+    if (parameters.async_write && snapshot_submitted)
     {
-        if (pause_data_logging() != GDB_OK)
+        // The file is written and decoded by the writer thread
+        if (parameters.decode_file != NULL)
         {
-            return 1;
+            file_writer_decode(parameters.decode_file);
         }
+
+        return 0;
     }
 
+    if (logging_to_file())
+    {
+        printf("\nData written to \"%s\"\n", parameters.bin_file_name);
+    }
+
+    // Execute the decode batch file if specified.
+    execute_decode_batch_file();
+
+    return 0;
+}
+
+
+/***
+ * @brief Read the g_rtedbg structure, write it to the binary file and clear the
+ *        circular buffer (single data transfer without the decoding).
+ *        The number of requests sent to the GDB server is kept to a minimum:
+ *        - the message filter is read together with the header,
+ *        - the header contents are refreshed from the complete structure read.
+ *
+ * @param phase_times  Array for the duration of the TRANSFER_PHASES phases [ms]
+ *                     (NULL - the phases are only logged)
+ *
+ * @return GDB_OK    - no error
+ *         GDB_ERROR - error occurred (data not received)
+ */
+
+int data_transfer_cycle(double* phase_times)
+{
+    double local_phase_times[TRANSFER_PHASES];
+    if (phase_times == NULL)
+    {
+        phase_times = local_phase_times;
+    }
+
+    LARGE_INTEGER phase_start;
+    start_timer(&phase_start);
+    snapshot_submitted = false;
+
+    gdb_handle_unexpected_messages();
+
+    // The header contains the current message filter value and the structure size.
     if (load_rtedbg_structure_header() != GDB_OK)
     {
-        return 1;
+        return GDB_ERROR;
     }
 
+    old_msg_filter = rtedbg_header.filter;
+
     if (check_header_info() != GDB_OK)
     {
-        return 1;
+        return GDB_ERROR;
+    }
+
+    end_transfer_phase(phase_times, PHASE_HEADER, &phase_start);
+
+    if (parameters.minimal_pause && (old_msg_filter != 0) && !single_shot_active())
+    {
+        bool overtaken = false;
+        int rez = minimal_pause_transfer(phase_times, &phase_start, &overtaken);
+
+        if (!overtaken)
+        {
+            return rez;
+        }
+
+        // The firmware logged more data than the buffer size during the read - repeat with the logging paused
+        start_timer(&phase_start);
+    }
+
+    // Pause data logging if the old message filter is not zero.
+    if (old_msg_filter != 0)
+    {
+        if (pause_data_logging() != GDB_OK)
+        {
+            return GDB_ERROR;
+        }
     }
 
+    end_transfer_phase(phase_times, PHASE_PAUSE, &phase_start);
+
     if (save_rtedbg_structure() != GDB_OK)
     {
         (void)set_or_restore_message_filter();
-        return 1;
+        return GDB_ERROR;
     }
 
+    end_transfer_phase(phase_times, PHASE_READ, &phase_start);
+
     if (check_message_filter_disabled() != GDB_OK)
     {
         set_or_restore_message_filter();
-        return 1;
+        file_writer_handover();
+        return GDB_ERROR;
     }
 
-    if (reset_circular_buffer() != GDB_OK)
+    // The snapshot contains the complete circular buffer only if the -tail argument is not used
+    if (clear_circular_buffer(parameters.tail_kb == 0) != GDB_OK)
     {
-        return 1;
+        return GDB_ERROR;
     }
 
-    if (set_or_restore_message_filter() != GDB_OK)
-    {
-        return 1;
-    }
+    end_transfer_phase(phase_times, PHASE_CLEAR, &phase_start);
 
-    if (logging_to_file())
+    int rez = restore_filter_and_buffer_index();
+
+    // The writer thread may still be busy with the previous snapshot - wait with the logging enabled
+    file_writer_handover();
+
+    if (rez != GDB_OK)
     {
-        printf("\nData written to \"%s\"\n", parameters.bin_file_name);
+        return GDB_ERROR;
     }
 
-    // Execute the decode batch file if specified.
-    execute_decode_batch_file();
+    end_transfer_phase(phase_times, PHASE_RESTORE, &phase_start);
+    log_transfer_phases(phase_times);
+    stats_add_phases(phase_times);
+    stats_count(COUNT_TRANSFERS, 1U);
+    return GDB_OK;
+}
 
-    return 0;
+
+/***
+ * @brief Log the duration of the data transfer phases.
+ *
+ * @param phase_times  Duration of the TRANSFER_PHASES phases [ms]
+ */
+
+static void log_transfer_phases(const double* phase_times)
+{
+    log_data("\nTransfer phases [us]: header %llu", (long long)(phase_times[PHASE_HEADER] * 1000.0));
+    log_data(", pause %llu", (long long)(phase_times[PHASE_PAUSE] * 1000.0));
+    log_data(", read %llu", (long long)(phase_times[PHASE_READ] * 1000.0));
+    log_data(", clear %llu", (long long)(phase_times[PHASE_CLEAR] * 1000.0));
+    log_data(", restore %llu", (long long)(phase_times[PHASE_RESTORE] * 1000.0));
+}
+
+
+/***
+ * @brief Save the duration of a data transfer phase and start the timer for the next one.
+ *
+ * @param phase_times  Array for the phase durations (NULL - not measured)
+ * @param phase        Phase that has been completed
+ * @param phase_start  Start time of the phase
+ */
+
+static void end_transfer_phase(double* phase_times, unsigned phase, LARGE_INTEGER* phase_start)
+{
+    if (phase_times != NULL)
+    {
+        phase_times[phase] = time_elapsed(phase_start);
+        start_timer(phase_start);
+    }
 }
 
 
@@ -248,8 +448,11 @@ static void show_help(void)
         "\n   '0' - Restart the batch file defined with the -start argument."
         "\n   '1' ... '9' - Start the command file 1.cmd ... 9.cmd. "
         "\n   'B' - Benchmark data transfer speed."
+        "\n   'X' - Benchmark hex encoding and decoding speed."
         "\n   'H' - Load the data logging structure header and display information."
+        "\n   'C' - Start / stop streaming to the file defined with the -stream argument."
         "\n   'L' - Enable / disable logging to the log file."
+        "\n   'T' - Display the transfer statistics (-stats argument)."
         "\n   '?' - View an overview of available commands."
         "\n   'Esc' - Exit."
         "\n----------------------------------------------------------------------"
@@ -423,7 +626,7 @@ static void switch_to_single_shot_logging(void)
         return;
     }
 
-    if (reset_circular_buffer() != GDB_OK)
+    if (reset_circular_buffer(false) != GDB_OK)
     {
         return;
     }
@@ -460,7 +663,7 @@ static void switch_to_post_mortem_logging(void)
         }
     }
 
-    if (reset_circular_buffer() != GDB_OK)
+    if (reset_circular_buffer(false) != GDB_OK)
     {
         return;
     }
@@ -563,6 +766,43 @@ void set_new_filter_value(const char* filter_value)
 }
 
 
+/***
+ * @brief Measure the average time needed to read the complete g_rtedbg structure.
+ * 
+ * @param count           Number of repeated data transfers
+ * @param pipeline_depth  Pipeline depth used for the memory reads
+ * 
+ * @return Average time in ms or a negative value if the data could not be read
+ */
+
+static double measure_average_read_time(unsigned count, unsigned pipeline_depth)
+{
+    double time_sum = 0;
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        LARGE_INTEGER start_time;
+        start_timer(&start_time);
+
+        int rez = gdb_read_memory_pipelined(
+            (unsigned char*)p_rtedbg_structure,
+            parameters.start_address,
+            parameters.size,
+            pipeline_depth
+            );
+
+        if (rez != GDB_OK)
+        {
+            return -1.0;
+        }
+
+        time_sum += time_elapsed(&start_time);
+    }
+
+    return time_sum / (double)count;
+}
+
+
 /***
  * @brief Execute the memory read benchmark using the GDB server protocol.
  * 
@@ -570,6 +810,8 @@ void set_new_filter_value(const char* filter_value)
  * non-real-time Windows scheduling.
  * The results are first written to a data field.
  * Full results are written to the speed_test.csv file and summary to the console.
+ * If pipelined reads are enabled, a shorter reference measurement without pipelining
+ * is also made, and the speed gain is reported.
  */
 
 static void benchmark_data_transfer(void)
@@ -579,6 +821,7 @@ static void benchmark_data_transfer(void)
     double time_sum = 0;
 
     printf("\n\nMeasuring the read memory times...\nWait max. 20 seconds for the benchmark to complete.");
+    snapshot_valid = false;     // The structure is read while logging is active
 
     if (!parameters.log_gdb_communication)
     {
@@ -648,6 +891,19 @@ static void benchmark_data_transfer(void)
     {
         double min_speed = (double)parameters.size / max_time;
         double avg_speed = (double)parameters.size * (double)measurements / time_sum;
+        double pipelining_gain = 0;
+        const unsigned pipeline_depth = parameters.pipeline_depth;
+
+        if (pipeline_depth > 1)
+        {
+            // Reference measurement without pipelining
+            double reference_time = measure_average_read_time(BENCHMARK_REFERENCE_COUNT, 1U);
+
+            if (reference_time > 0)
+            {
+                pipelining_gain = reference_time / (time_sum / (double)measurements);
+            }
+        }
 
         FILE* report;
         int rez = fopen_s(&report, "speed_test.csv", "w");
@@ -672,6 +928,13 @@ static void benchmark_data_transfer(void)
                 min_time, max_time, parameters.size,
                 min_speed, avg_speed
             );
+
+            if (pipelining_gain > 0)
+            {
+                fprintf(report, "Pipeline depth %u, speed gain compared to no pipelining: %.2f.\n",
+                    pipeline_depth, pipelining_gain);
+            }
+
             fclose(report);
         }
 
@@ -681,6 +944,12 @@ static void benchmark_data_transfer(void)
             min_time, max_time, parameters.size,
             min_speed, avg_speed
         );
+
+        if (pipelining_gain > 0)
+        {
+            printf("Pipeline depth %u, speed gain compared to no pipelining: %.2f.\n",
+                pipeline_depth, pipelining_gain);
+        }
     }
 
     enable_logging(true);
@@ -690,19 +959,35 @@ static void benchmark_data_transfer(void)
 
 /***
  * @brief  Display the status of logging in the embedded system.
+ *         Only the buffer index and the message filter are polled. The poll interval
+ *         is short while the index is changing and longer while logging is idle.
+ *         With the -auto argument, the header is polled more often and the
+ *         automatic data transfer conditions are checked.
  * 
  * @param start_time  Time when the persistent_connection() function started or
  *                    when the logging status was last displayed.
+ *
+ * @return true - automatic data transfer should be started
  */
 
-static void display_logging_state(clock_t* start_time)
+static bool display_logging_state(clock_t* start_time)
 {
     clock_t current_time = clock_ms();
+    const bool auto_capture_enabled = parameters.auto_capture_level != 0;
+    clock_t poll_interval = (status_idle_polls >= STATUS_POLL_IDLE_COUNT) ? STATUS_POLL_SLOW_MS : STATUS_POLL_FAST_MS;
 
-    if ((current_time - *start_time) < 350)
+    if (auto_capture_enabled)
     {
-        Sleep(50);
-        return;
+        poll_interval = AUTO_CAPTURE_POLL_INTERVAL;
+    }
+
+    clock_t elapsed = current_time - *start_time;
+    if (elapsed < poll_interval)
+    {
+        // Wait for the next poll, but check the keyboard in the meantime
+        clock_t wait = poll_interval - elapsed;
+        Sleep((DWORD)((wait < KEYBOARD_POLL_MS) ? wait : KEYBOARD_POLL_MS));
+        return false;
     }
 
     if (!parameters.log_gdb_communication)
@@ -713,9 +998,19 @@ static void display_logging_state(clock_t* start_time)
     gdb_handle_unexpected_messages();
 
     *start_time = current_time;
-    int rez = load_rtedbg_structure_header();
+    uint32_t previous_index = rtedbg_header.last_index;
+    int rez = poll_index_and_filter();
     enable_logging(true);
 
+    if (rtedbg_header.last_index != previous_index)
+    {
+        status_idle_polls = 0;
+    }
+    else if (status_idle_polls < STATUS_POLL_IDLE_COUNT)
+    {
+        status_idle_polls++;
+    }
+
     unsigned size = rtedbg_header.buffer_size - 4U;
     unsigned buffer_usage = (unsigned)((100U * rtedbg_header.last_index + size / 2U) / size);
     if (buffer_usage > 100)
@@ -739,7 +1034,106 @@ static void display_logging_state(clock_t* start_time)
     else
     {
         printf("\rCannot read data from the embedded system.              ");
+        return false;
+    }
+
+    const char* reason = auto_capture_enabled ? auto_capture_trigger(buffer_usage) : NULL;
+    if (reason == NULL)
+    {
+        return false;
+    }
+
+    printf("\nAutomatic data transfer %u - %s.", auto_capture_count + 1U, reason);
+    return true;
+}
+
+
+/***
+ * @brief  Read the buffer index, the message filter and the configuration word (the first
+ *         12 bytes of the header) to the cached header. The configuration word contains
+ *         the single shot state set by the firmware. The complete header is loaded only
+ *         the first time and after a communication error.
+ * 
+ * @return GDB_OK    - no error
+ *         GDB_ERROR - data not received or incorrect header
+ */
+
+static int poll_index_and_filter(void)
+{
+    int rez;
+
+    if (status_header_valid)
+    {
+        rez = gdb_read_memory((unsigned char*)&rtedbg_header, parameters.start_address,
+            offsetof(rtedbg_header_t, timestamp_frequency));
+    }
+    else
+    {
+        rez = load_rtedbg_structure_header();
+    }
+
+    status_header_valid = (rez == GDB_OK);
+    return rez;
+}
+
+
+/***
+ * @brief  Check the automatic data transfer conditions (-auto=NN argument):
+ *         - the single shot buffer usage has reached NN %,
+ *         - the message filter has been set to zero (logging stopped by the firmware).
+ *         The fill level trigger is re-armed when the usage drops below the level
+ *         (the buffer index is reset by the data transfer).
+ * 
+ * @param buffer_usage  Single shot buffer usage [%]
+ *
+ * @return Reason for the data transfer, NULL - no transfer needed
+ */
+
+static const char* auto_capture_trigger(unsigned buffer_usage)
+{
+    const bool logging_stopped = (polled_filter != 0) && (rtedbg_header.filter == 0);
+    polled_filter = rtedbg_header.filter;
+
+    if (RTE_SINGLE_SHOT_WAS_ACTIVE && RTE_SINGLE_SHOT_LOGGING_ENABLED)
+    {
+        if (buffer_usage < parameters.auto_capture_level)
+        {
+            auto_capture_armed = true;
+        }
+        else if (auto_capture_armed)
+        {
+            auto_capture_armed = false;
+            return "buffer fill level reached";
+        }
+    }
+
+    if (logging_stopped)
+    {
+        return "logging stopped by the firmware";
+    }
+
+    return NULL;
+}
+
+
+/***
+ * @brief  Transfer the data as with the Space key in the persistent mode.
+ *         The trigger is re-armed immediately.
+ */
+
+static void auto_capture(void)
+{
+    stream_flush();
+    int rez = single_data_transfer();
+    stream_resync();
+    auto_capture_count++;
+
+    if ((rez != 0) && logging_to_file())
+    {
+        printf("\nError - check the log file for details.\n");
     }
+
+    display_errors("\nAutomatic data transfer failed: ");
 }
 
 
@@ -750,6 +1144,7 @@ static void display_logging_state(clock_t* start_time)
 static void reconnect_to_gdb_server(void)
 {
     decrease_priorities();
+    parallel_read_stop();
     gdb_socket_cleanup();
 
     if (gdb_connect(parameters.gdb_port) != GDB_OK)
@@ -761,6 +1156,7 @@ static void reconnect_to_gdb_server(void)
     }
     else
     {
+        parallel_read_start();
         increase_priorities();
         printf("\nOK\n");
     }
@@ -804,7 +1200,11 @@ static int persistent_connection(void)
     {
         if (!_kbhit())
         {
-            display_logging_state(&start_time);
+            stream_new_data();
+            if (display_logging_state(&start_time))
+            {
+                auto_capture();
+            }
             continue;
         }
 
@@ -829,12 +1229,24 @@ static int persistent_connection(void)
             benchmark_data_transfer();
             break;
 
+        case 'X':
+            benchmark_hex_decoding();
+            break;
+
         case 'S':
+            stream_flush();
             switch_to_single_shot_logging();
+            stream_resync();
             break;
 
         case 'P':
+            stream_flush();
             switch_to_post_mortem_logging();
+            stream_resync();
+            break;
+
+        case 'C':
+            start_stop_streaming();
             break;
 
         case 'F':
@@ -845,6 +1257,11 @@ static int persistent_connection(void)
             disable_enable_logging_to_file();
             break;
 
+        case 'T':
+            stats_display();
+            (void)stats_write_file();
+            break;
+
         case 'R':
             reconnect_to_gdb_server();
             break;
@@ -866,7 +1283,9 @@ static int persistent_connection(void)
             break;
 
         case ' ':
+            stream_flush();
             rez = single_data_transfer();
+            stream_resync();
             if ((rez != 0) && logging_to_file())
             {
                 printf("\nError - check the log file for details.\n");
@@ -877,6 +1296,11 @@ static int persistent_connection(void)
             printf("\n\nPress the 'Y' button to exit the program.");
             if (toupper(_getch()) == 'Y')
             {
+                if (streaming_active())
+                {
+                    start_stop_streaming();     // Write the remaining data and close the file
+                }
+
                 return 0;
             }
             break;
@@ -935,7 +1359,7 @@ static void display_errors(const char* message)
 
         case ERR_BAD_MSG_FORMAT:
         case ERR_BAD_MSG_CHECKSUM:
-        case ERR_RUN_LENGTH_ENCODING_NOT_IMPLEMENTED:
+        case ERR_BAD_RUN_LENGTH_ENCODING:
         case ERR_BAD_INPUT_DATA:
         case ERR_MSG_NOT_SENT_COMPLETELY:
         case ERR_BAD_RESPONSE:
@@ -946,6 +1370,10 @@ static void display_errors(const char* message)
             printf("GDB server reported error.");
             break;
 
+        case ERR_OUT_OF_MEMORY:
+            printf("not enough memory.");
+            break;
+
         default:
             break;
     }
@@ -962,7 +1390,7 @@ static void display_errors(const char* message)
  *         GDB_ERROR - data not received
  */
 
-static int load_rtedbg_structure_header(void)
+int load_rtedbg_structure_header(void)
 {
     int res = gdb_read_memory(
         (unsigned char *)&rtedbg_header, parameters.start_address, sizeof(rtedbg_header));
@@ -972,6 +1400,19 @@ static int load_rtedbg_structure_header(void)
         return GDB_ERROR;
     }
 
+    if (rtedbg_header.buffer_size > (MAX_BUFFER_SIZE / 4U))
+    {
+        // Checked before the size calculation to prevent an overflow
+        log_data(
+            "\nThe buffer size specified in the g_rtedbg structure header is too large (%llu words",
+            (long long)rtedbg_header.buffer_size);
+        log_data(
+            " > %llu).\n"
+            "Check that the correct data structure address is passed as a parameter and that the rte_init() function has already been called.",
+            (long long)(MAX_BUFFER_SIZE / 4U));
+        return GDB_ERROR;
+    }
+
     unsigned new_size = rtedbg_header.buffer_size * 4U + sizeof(rtedbg_header_t);
 
     if ((parameters.size == 0U)             // Automatically obtain the size of the structure
@@ -991,24 +1432,11 @@ static int load_rtedbg_structure_header(void)
             return GDB_ERROR;
         }
 
-        if (parameters.size > MAX_BUFFER_SIZE)
-        {
-            log_data(
-                "\nThe buffer size specified in the g_rtedbg structure header is too large (%llu)",
-                (long long)parameters.size);
-            log_data(
-                " > %llu).\n"
-                "Check that the correct data structure address is passed as a parameter and that the rte_init() function has already been called.",
-                (long long)MAX_BUFFER_SIZE);
-            return GDB_ERROR;
-        }
-
         if (p_rtedbg_structure != NULL)
         {
             // The size has changed, release the buffer to allocate a new one.
             log_data("\nLog data structure changed to: %llu", new_size);
-            free(p_rtedbg_structure);
-            p_rtedbg_structure = NULL;
+            free_rtedbg_structure_memory();
         }
     }
 
@@ -1031,6 +1459,19 @@ static int load_rtedbg_structure_header(void)
  */
 
 static int set_or_restore_message_filter(void)
+{
+    uint32_t old_filter = restored_message_filter();
+    return gdb_write_memory((const unsigned char *)&old_filter, MESSAGE_FILTER_ADDRESS, 4U);
+}
+
+
+/***
+ * @brief Get the message filter value to be written at the end of the data transfer.
+ *
+ * @return New filter value (command line argument) or the value before logging was paused
+ */
+
+static uint32_t restored_message_filter(void)
 {
     uint32_t old_filter = old_msg_filter;
 
@@ -1044,12 +1485,40 @@ static int set_or_restore_message_filter(void)
         old_filter = parameters.filter;     // User defined filter value (command line argument)
     }
 
-    return gdb_write_memory((const unsigned char *)&old_filter, MESSAGE_FILTER_ADDRESS, 4U);
+    return old_filter;
+}
+
+
+/***
+ * @brief Restore the message filter and erase the circular buffer index if the buffer was
+ *        cleared or single shot logging was active. The index and the filter are written
+ *        with two requests - the GDB protocol does not define the order in which the
+ *        words of a single memory write are written to the embedded system memory.
+ *        The logging stays paused until the index has been erased.
+ *
+ * @return GDB_OK    - no error
+ *         GDB_ERROR - data not written
+ */
+
+static int restore_filter_and_buffer_index(void)
+{
+    if (parameters.clear_buffer || single_shot_active())
+    {
+        if (erase_buffer_index() != GDB_OK)
+        {
+            return GDB_ERROR;
+        }
+    }
+
+    uint32_t filter = restored_message_filter();
+    return gdb_write_memory((const unsigned char *)&filter, MESSAGE_FILTER_ADDRESS, 4U);
 }
 
 
 /***
  * @brief Read the complete g_rtedbg structure from the embedded system and write it to a file.
+ *        If the -crc argument is used, only the parts changed since the last transfer
+ *        are read and the file is not rewritten if nothing has changed.
  * 
  * @return GDB_OK    - no error
  *         GDB_ERROR - data not received or file operation failed
@@ -1063,15 +1532,98 @@ static int save_rtedbg_structure(void)
     }
 
     delay_before_data_transfer();
-    int err = read_memory_block(
-        (unsigned char *)p_rtedbg_structure,
-        parameters.start_address,
-        parameters.size);
+    bool data_changed = true;
+    bool complete_snapshot = true;      // false - only a part of the circular buffer has been read
+    int err;
+
+    if (parameters.async_write && file_writer_error())
+    {
+        snapshot_valid = false;     // The last snapshot is not in the file
+    }
+
+    if (parameters.tail_kb != 0)
+    {
+        err = read_tail_window();
+        complete_snapshot = false;
+    }
+    else if (parameters.crc_change_detection && crc_supported && snapshot_valid)
+    {
+        err = read_changed_parts(&data_changed);
+    }
+    else
+    {
+        err = read_memory_block(
+            (unsigned char *)p_rtedbg_structure,
+            parameters.start_address,
+            parameters.size);
+    }
+
+    snapshot_valid = false;
+
+    if ((err == GDB_OK) && complete_snapshot && parameters.crc_verify && crc_supported)
+    {
+        err = verify_snapshot_crc();
+    }
+
+    if (err == GDB_OK)
+    {
+        err = update_header_from_snapshot();
+    }
+
     if (err != GDB_OK)
     {
         return GDB_ERROR;
     }
 
+    if (!data_changed)
+    {
+        p_rtedbg_structure[1] = old_msg_filter;
+        snapshot_valid = true;
+        log_string(" No new data - the file has not been rewritten. ", NULL);
+
+        if (logging_to_file())
+        {
+            printf("\nNo new data since the last transfer - \"%s\" not rewritten.", parameters.bin_file_name);
+        }
+
+        return GDB_OK;
+    }
+
+    // Restore the old message filter (as it was before logging was disabled)
+    p_rtedbg_structure[1] = old_msg_filter;
+    return write_snapshot(complete_snapshot);
+}
+
+
+/***
+ * @brief Write the g_rtedbg structure snapshot to the binary file (directly or with the
+ *        background writer) and append it to the snapshot series.
+ *
+ * @param complete_snapshot  false - only a part of the circular buffer has been read
+ *
+ * @return GDB_OK    - no error
+ *         GDB_ERROR - file operation failed
+ */
+
+static int write_snapshot(bool complete_snapshot)
+{
+    snapshot_submitted = false;
+
+    if (parameters.bin_file_name == NULL)
+    {
+        snapshot_valid = complete_snapshot;     // Library API - the data is not written to a file
+        return GDB_OK;
+    }
+
+    if (parameters.async_write && (file_writer_submit(p_rtedbg_structure, parameters.size) == GDB_OK))
+    {
+        snapshot_submitted = true;      // Written by the writer thread after file_writer_handover()
+        snapshot_valid = complete_snapshot;
+        return GDB_OK;
+    }
+
+    LARGE_INTEGER span_start;
+    stats_span_start(&span_start);
     FILE * bin_file;
     errno_t rez = fopen_s(&bin_file, parameters.bin_file_name, "wb");
 
@@ -1093,9 +1645,6 @@ static int save_rtedbg_structure(void)
         return GDB_ERROR;
     }
 
-    // Restore the old message filter (as it was before logging was disabled)
-    p_rtedbg_structure[1] = old_msg_filter;
-
     size_t written = fwrite(p_rtedbg_structure, 1U, parameters.size, bin_file);
     if (written != parameters.size)
     {
@@ -1115,6 +1664,553 @@ static int save_rtedbg_structure(void)
     }
 
     (void)fclose(bin_file);
+    stats_span_end(SPAN_FILE_WRITE, &span_start);
+    snapshot_valid = complete_snapshot;
+
+    if (series_append_snapshot(p_rtedbg_structure, parameters.size) != GDB_OK)
+    {
+        log_string("\nThe snapshot could not be added to the series file \"%s\".", parameters.series_file_name);
+    }
+
+    return GDB_OK;
+}
+
+
+/***
+ * @brief Post-mortem data transfer with the shortest logging pause (-minpause argument).
+ *        The logging is paused only while the header is read - the message filter is
+ *        restored before the circular buffer is read. The buffer is read starting with
+ *        the oldest data (just after the buffer index), so that it is read before the
+ *        firmware overwrites it. The words logged during the read are marked as unused
+ *        (0xFFFFFFFF) in the snapshot, because they may contain a mix of old and new data.
+ *
+ * @param phase_times  Array for the duration of the TRANSFER_PHASES phases [ms]
+ * @param phase_start  Start time of the current phase
+ * @param overtaken    Set to true if the firmware has logged more data than the buffer
+ *                     size during the read - the snapshot is not consistent and not written
+ *
+ * @return GDB_OK    - no error
+ *         GDB_ERROR - data not received or file operation failed
+ */
+
+static int minimal_pause_transfer(double* phase_times, LARGE_INTEGER* phase_start, bool* overtaken)
+{
+    if (p_rtedbg_structure == NULL)
+    {
+        return GDB_ERROR;
+    }
+
+    if (parameters.async_write && file_writer_error())
+    {
+        snapshot_valid = false;
+    }
+
+    // Header snapshot with the logging paused - the buffer index is not changed by the firmware
+    if ((pause_data_logging() != GDB_OK)
+        || (gdb_read_memory((unsigned char*)p_rtedbg_structure, parameters.start_address,
+            sizeof(rtedbg_header_t)) != GDB_OK))
+    {
+        (void)set_or_restore_message_filter();
+        return GDB_ERROR;
+    }
+
+    if (set_or_restore_message_filter() != GDB_OK)
+    {
+        return GDB_ERROR;
+    }
+
+    end_transfer_phase(phase_times, PHASE_PAUSE, phase_start);
+    snapshot_valid = false;
+    uint32_t words_logged = 0;
+
+    if ((read_oldest_data_first(&words_logged) != GDB_OK)
+        || (update_header_from_snapshot() != GDB_OK))
+    {
+        return GDB_ERROR;
+    }
+
+    const unsigned buffer_words = (parameters.size - sizeof(rtedbg_header_t)) / 4U;
+
+    if (words_logged >= buffer_words)
+    {
+        log_string("\nThe complete circular buffer was overwritten during the data transfer.", NULL);
+        *overtaken = true;
+        return GDB_ERROR;
+    }
+
+    if (words_logged > 0)
+    {
+        log_data(" %llu words logged during the transfer marked as unused. ", (long long)words_logged);
+
+        if (logging_to_file())
+        {
+            printf("\n%u words logged during the data transfer are marked as unused (0xFFFFFFFF).", words_logged);
+        }
+    }
+
+    p_rtedbg_structure[1] = old_msg_filter;
+    int rez = write_snapshot(false);     // The next transfer must read the complete buffer
+    file_writer_handover();              // The message filter has already been restored
+    end_transfer_phase(phase_times, PHASE_READ, phase_start);
+    end_transfer_phase(phase_times, PHASE_CLEAR, phase_start);
+    end_transfer_phase(phase_times, PHASE_RESTORE, phase_start);
+
+    if (rez != GDB_OK)
+    {
+        return GDB_ERROR;
+    }
+
+    log_transfer_phases(phase_times);
+    stats_add_phases(phase_times);
+    stats_count(COUNT_TRANSFERS, 1U);
+    return GDB_OK;
+}
+
+
+/***
+ * @brief Read the circular buffer with the logging enabled - first the oldest data from
+ *        the buffer index to the end of the buffer and then the data from the buffer start
+ *        to the index. The index is read again after the transfer. The words between the
+ *        two index values may have been overwritten during the read - they are set to
+ *        0xFFFFFFFF (unused buffer) in the snapshot.
+ *
+ * @param words_logged  Number of words logged by the firmware during the read
+ *
+ * @return GDB_OK    - no error
+ *         GDB_ERROR - data not received
+ */
+
+static int read_oldest_data_first(uint32_t* words_logged)
+{
+    LARGE_INTEGER start_time;
+    start_timer(&start_time);
+    unsigned* buffer = &p_rtedbg_structure[sizeof(rtedbg_header_t) / 4U];
+    const unsigned buffer_words = (parameters.size - sizeof(rtedbg_header_t)) / 4U;
+    const unsigned buffer_address = parameters.start_address + sizeof(rtedbg_header_t);
+    const uint32_t start_index = p_rtedbg_structure[0];
+    unsigned oldest;
+
+    if (RTE_BUFF_SIZE_IS_POWER_OF_2)
+    {
+        oldest = start_index & (buffer_words - 1U);     // Free running index
+    }
+    else
+    {
+        oldest = (start_index < buffer_words) ? start_index : 0;
+    }
+
+    if (gdb_read_memory((unsigned char*)&buffer[oldest], buffer_address + 4U * oldest,
+            4U * (buffer_words - oldest)) != GDB_OK)
+    {
+        return GDB_ERROR;
+    }
+
+    if ((oldest > 0) && (gdb_read_memory((unsigned char*)buffer, buffer_address, 4U * oldest) != GDB_OK))
+    {
+        return GDB_ERROR;
+    }
+
+    uint32_t end_index;
+    if (gdb_read_memory((unsigned char*)&end_index, parameters.start_address, 4U) != GDB_OK)
+    {
+        return GDB_ERROR;
+    }
+
+    if (RTE_BUFF_SIZE_IS_POWER_OF_2)
+    {
+        *words_logged = end_index - start_index;
+    }
+    else if ((start_index >= buffer_words) || (end_index >= buffer_words))
+    {
+        *words_logged = buffer_words;   // Index out of range - the snapshot can not be checked
+    }
+    else
+    {
+        *words_logged = (end_index >= start_index)
+            ? (end_index - start_index) : (end_index + buffer_words - start_index);
+    }
+
+    unsigned count = (*words_logged < buffer_words) ? *words_logged : buffer_words;
+
+    for (unsigned i = 0, index = oldest; i < count; i++)
+    {
+        buffer[index] = 0xFFFFFFFFU;
+        index = (index + 1U < buffer_words) ? (index + 1U) : 0;
+    }
+
+    log_data(", %llu kB/s. ", (long long)(4U * buffer_words / time_elapsed(&start_time)));
+    return GDB_OK;
+}
+
+
+/***
+ * @brief Copy the header from the g_rtedbg structure just read (logging paused) to the
+ *        rtedbg_header. The header does not have to be read again after the transfer.
+ * 
+ * @return GDB_OK    - no error
+ *         GDB_ERROR - the structure size changed after the header was loaded
+ */
+
+static int update_header_from_snapshot(void)
+{
+    const rtedbg_header_t* header = (const rtedbg_header_t*)p_rtedbg_structure;
+
+    if (header->buffer_size != rtedbg_header.buffer_size)
+    {
+        log_string("\nThe g_rtedbg structure size changed during the data transfer.", NULL);
+        last_gdb_error = ERR_BAD_RESPONSE;
+        return GDB_ERROR;
+    }
+
+    memcpy(&rtedbg_header, header, sizeof(rtedbg_header_t));
+    rtedbg_header.filter = old_msg_filter;
+    return GDB_OK;
+}
+
+
+/***
+ * @brief Read the header and the parts of the circular buffer whose CRC (calculated by
+ *        the GDB server) differs from the CRC of the data read during the last transfer.
+ *        The CRC of the complete circular buffer is checked first. If it differs, the part
+ *        of the buffer logged since the last transfer (between the previous and the current
+ *        buffer index) is read and the CRC of the complete buffer is checked again locally.
+ *        Only if it still differs (e.g. the buffer was changed in another way), the circular
+ *        buffer is compared in CRC_CHUNK_SIZE parts, and adjacent changed parts are read
+ *        with a single read request. If the GDB server does not support the qCRC
+ *        request, the complete structure is read.
+ * 
+ * @param data_changed  Set to false if neither the header nor the buffer have changed
+ * 
+ * @return GDB_OK    - no error
+ *         GDB_ERROR - data not received
+ */
+
+static int read_changed_parts(bool* data_changed)
+{
+    LARGE_INTEGER start_time;
+    start_timer(&start_time);
+    unsigned char* snapshot = (unsigned char*)p_rtedbg_structure;
+    rtedbg_header_t header;
+
+    if (gdb_read_memory((unsigned char*)&header, parameters.start_address, sizeof(header)) != GDB_OK)
+    {
+        return GDB_ERROR;
+    }
+
+    const unsigned previous_index = p_rtedbg_structure[0];     // Index at the last transfer
+    header.filter = old_msg_filter;         // The filter value written to the file
+    *data_changed = memcmp(&header, snapshot, sizeof(header)) != 0;
+    memcpy(snapshot, &header, sizeof(header));
+    p_rtedbg_structure[1] = 0;              // As it is in the embedded system during the transfer
+
+    const unsigned data_address = parameters.start_address + sizeof(rtedbg_header_t);
+    const unsigned data_size = parameters.size - sizeof(rtedbg_header_t);
+    unsigned char* data = snapshot + sizeof(rtedbg_header_t);
+    unsigned crc;
+
+    if (gdb_memory_crc(data_address, data_size, &crc) != GDB_OK)
+    {
+        log_string("\nqCRC request not supported - reading the complete structure.", NULL);
+        crc_supported = false;
+        last_gdb_error = 0;
+        gdb_flush_socket();
+        *data_changed = true;
+        return read_memory_block(snapshot, parameters.start_address, parameters.size);
+    }
+
+    if (crc == gdb_crc32(data, data_size))
+    {
+        log_timing(" circular buffer unchanged (%.1f ms). ", &start_time);
+        return GDB_OK;
+    }
+
+    *data_changed = true;
+    unsigned bytes_read = 0;
+    unsigned round_trips = 2;               // Header read and complete buffer CRC
+
+    if (read_logged_region(data, previous_index, &bytes_read, &round_trips) != GDB_OK)
+    {
+        return GDB_ERROR;
+    }
+
+    if (crc == gdb_crc32(data, data_size))
+    {
+        log_data(" %llu kB of new data read", (long long)(bytes_read / 1024U));
+        log_data(" (round trips: %llu", (long long)round_trips);
+        log_timing(", %.1f ms). ", &start_time);
+        return GDB_OK;
+    }
+
+    unsigned run_start = 0;
+    unsigned run_length = 0;
+
+    for (unsigned offset = 0; offset < data_size; offset += CRC_CHUNK_SIZE)
+    {
+        unsigned length = data_size - offset;
+        if (length > CRC_CHUNK_SIZE)
+        {
+            length = CRC_CHUNK_SIZE;
+        }
+
+        if (gdb_memory_crc(data_address + offset, length, &crc) != GDB_OK)
+        {
+            return GDB_ERROR;
+        }
+
+        round_trips++;
+
+        if (crc != gdb_crc32(&data[offset], length))
+        {
+            if (run_length == 0)
+            {
+                run_start = offset;
+            }
+
+            run_length += length;
+            if ((offset + length) < data_size)
+            {
+                continue;
+            }
+        }
+
+        if (run_length > 0)
+        {
+            // Read the changed parts
+            if (gdb_read_memory(&data[run_start], data_address + run_start, run_length) != GDB_OK)
+            {
+                return GDB_ERROR;
+            }
+
+            bytes_read += run_length;
+            round_trips++;
+            run_length = 0;
+        }
+    }
+
+    log_data(" %llu kB of changed data read", (long long)(bytes_read / 1024U));
+    log_data(" (round trips: %llu", (long long)round_trips);
+    log_timing(", %.1f ms). ", &start_time);
+    return GDB_OK;
+}
+
+
+/***
+ * @brief Read the part of the circular buffer logged since the last transfer - from the
+ *        previous to the current buffer index (header in the snapshot). The part starts up to
+ *        CRC_CHUNK_SIZE bytes before the previous index, because the firmware could still
+ *        be writing the messages for which it had reserved space at the last transfer.
+ *        The part is aligned to CRC_CHUNK_SIZE and wraps around to the start of the buffer
+ *        in the post-mortem mode. The complete buffer is read if the index is out of range
+ *        or if the firmware has logged more data than the buffer size.
+ *
+ * @param data            Circular buffer in the snapshot
+ * @param previous_index  Buffer index at the last transfer
+ * @param bytes_read      Number of bytes read is added to this variable
+ * @param round_trips     Number of read requests is added to this variable
+ *
+ * @return GDB_OK    - no error
+ *         GDB_ERROR - data not received
+ */
+
+static int read_logged_region(unsigned char* data, unsigned previous_index, unsigned* bytes_read,
+                unsigned* round_trips)
+{
+    const unsigned buffer_words = (parameters.size - sizeof(rtedbg_header_t)) / 4U;
+    const unsigned buffer_address = parameters.start_address + sizeof(rtedbg_header_t);
+    const unsigned chunk_words = CRC_CHUNK_SIZE / 4U;
+    const unsigned margin = (chunk_words < buffer_words) ? chunk_words : buffer_words;
+    const unsigned index = p_rtedbg_structure[0];   // Header already read to the snapshot
+    unsigned start;
+    unsigned words;
+
+    if (single_shot_active())
+    {
+        unsigned end = (index < buffer_words) ? index : buffer_words;
+        start = (previous_index < end) ? previous_index : 0;     // Index reset by the last transfer
+        start = (start > margin) ? (start - margin) : 0;
+        start -= start % chunk_words;
+        words = end - start;
+    }
+    else if (RTE_BUFF_SIZE_IS_POWER_OF_2 && ((index - previous_index) < buffer_words))
+    {
+        start = ((previous_index & (buffer_words - 1U)) + buffer_words - margin) % buffer_words;
+        start -= start % chunk_words;
+        words = ((index & (buffer_words - 1U)) + buffer_words - start) % buffer_words;
+    }
+    else if (!RTE_BUFF_SIZE_IS_POWER_OF_2 && (index < buffer_words) && (previous_index < buffer_words))
+    {
+        start = (previous_index + buffer_words - margin) % buffer_words;
+        start -= start % chunk_words;
+        words = (index + buffer_words - start) % buffer_words;
+    }
+    else
+    {
+        start = 0;                          // Read the complete buffer
+        words = buffer_words;
+    }
+
+    words = (words + chunk_words - 1U) / chunk_words * chunk_words;
+    if (words > buffer_words)
+    {
+        words = buffer_words;
+    }
+
+    unsigned first_part = buffer_words - start;
+    if (first_part > words)
+    {
+        first_part = words;
+    }
+
+    if (first_part > 0)
+    {
+        if (gdb_read_memory(&data[4U * start], buffer_address + 4U * start, 4U * first_part) != GDB_OK)
+        {
+            return GDB_ERROR;
+        }
+
+        (*round_trips)++;
+    }
+
+    if (words > first_part)
+    {
+        // Wrap-around - the rest of the data is at the start of the circular buffer
+        if (gdb_read_memory(data, buffer_address, 4U * (words - first_part)) != GDB_OK)
+        {
+            return GDB_ERROR;
+        }
+
+        (*round_trips)++;
+    }
+
+    *bytes_read += 4U * words;
+    return GDB_OK;
+}
+
+
+/***
+ * @brief Read the header and only the last -tail=N kB of data written to the circular
+ *        buffer before logging was paused. The rest of the circular buffer in the snapshot
+ *        is filled with 0xFFFFFFFF (unused buffer), so that the file can be decoded as a
+ *        normal data transfer file. The window ends at the buffer index and wraps around
+ *        to the end of the buffer in the post-mortem mode. In the single shot mode,
+ *        the data before the index is read.
+ * 
+ * @return GDB_OK    - no error
+ *         GDB_ERROR - data not received
+ */
+
+static int read_tail_window(void)
+{
+    LARGE_INTEGER start_time;
+    start_timer(&start_time);
+    unsigned* buffer = &p_rtedbg_structure[sizeof(rtedbg_header_t) / 4U];
+    const unsigned buffer_words = (parameters.size - sizeof(rtedbg_header_t)) / 4U;
+    const unsigned buffer_address = parameters.start_address + sizeof(rtedbg_header_t);
+
+    // The index is read again because the firmware could log data before logging was paused
+    if (gdb_read_memory((unsigned char*)p_rtedbg_structure, parameters.start_address,
+            sizeof(rtedbg_header_t)) != GDB_OK)
+    {
+        return GDB_ERROR;
+    }
+
+    const unsigned last_index = p_rtedbg_structure[0];
+    unsigned window = parameters.tail_kb * 256U;
+    unsigned end;
+    unsigned start;
+    bool wrap_around = false;
+
+    if (window > buffer_words)
+    {
+        window = buffer_words;
+    }
+
+    if (single_shot_active())
+    {
+        end = (last_index < buffer_words) ? last_index : buffer_words;
+        start = (end > window) ? (end - window) : 0;
+    }
+    else
+    {
+        if (RTE_BUFF_SIZE_IS_POWER_OF_2)
+        {
+            end = last_index & (buffer_words - 1U);     // Free running index
+        }
+        else if (last_index < buffer_words)
+        {
+            end = last_index;
+        }
+        else
+        {
+            end = 0;                // Index out of range - read the complete buffer
+            window = buffer_words;
+        }
+
+        start = (end >= window) ? (end - window) : (end + buffer_words - window);
+        wrap_around = (start >= end);
+    }
+
+    memset(buffer, 0xFF, 4U * buffer_words);
+    int rez = GDB_OK;
+
+    if (wrap_around)
+    {
+        // Wrap-around - read the part at the end of the buffer first
+        rez = gdb_read_memory((unsigned char*)&buffer[start], buffer_address + 4U * start,
+            4U * (buffer_words - start));
+        start = 0;
+    }
+
+    if ((rez == GDB_OK) && (end > start))
+    {
+        rez = gdb_read_memory((unsigned char*)&buffer[start], buffer_address + 4U * start, 4U * (end - start));
+    }
+
+    if (rez != GDB_OK)
+    {
+        return GDB_ERROR;
+    }
+
+    log_data(" last %llu kB of the circular buffer read", (long long)(window / 256U));
+    log_timing(" (%.1f ms). ", &start_time);
+    return GDB_OK;
+}
+
+
+/***
+ * @brief Compare the CRC of the complete g_rtedbg structure calculated by the GDB server
+ *        with the CRC of the data read. The message filter must still be zero.
+ * 
+ * @return GDB_OK    - data correct or CRC check not supported
+ *         GDB_ERROR - CRC does not match or communication error
+ */
+
+static int verify_snapshot_crc(void)
+{
+    unsigned crc;
+
+    if (gdb_memory_crc(parameters.start_address, parameters.size, &crc) != GDB_OK)
+    {
+        if (last_gdb_error != ERR_BAD_RESPONSE)
+        {
+            return GDB_ERROR;
+        }
+
+        log_string("\nqCRC request not supported - the data cannot be verified.", NULL);
+        crc_supported = false;
+        last_gdb_error = 0;
+        gdb_flush_socket();
+        return GDB_OK;
+    }
+
+    if (crc != gdb_crc32((const unsigned char*)p_rtedbg_structure, parameters.size))
+    {
+        log_string("\nData verification failed - the CRC of the data read is not correct.", NULL);
+        last_gdb_error = ERR_BAD_RESPONSE;
+        return GDB_ERROR;
+    }
+
+    log_string(" CRC OK. ", NULL);
     return GDB_OK;
 }
 
@@ -1134,7 +2230,7 @@ static int read_memory_block(unsigned char * buffer, uint32_t address, uint32_t
 {
     LARGE_INTEGER start_time;
     start_timer(&start_time);
-    int res = gdb_read_memory(buffer, address, block_size);
+    int res = parallel_read_memory(buffer, address, block_size);
 
     if (res != GDB_OK)
     {
@@ -1198,43 +2294,77 @@ static bool single_shot_active(void)
  * @brief Reset the complete contents of the circular buffer to 0xFFFFFFFF if enabled
  *        or reset just the buffer index if not enabled and single shot logging
  *        was active.
+ *        If the -clear=incremental argument is used and the snapshot of the g_rtedbg
+ *        structure has just been loaded, only the parts of the circular buffer that
+ *        do not contain 0xFFFFFFFF are cleared.
+ * 
+ * @param snapshot_available  true - the p_rtedbg_structure contains the current
+ *                            circular buffer contents (logging is paused)
  * 
  * @return GDB_OK    - no error
  *         GDB_ERROR - buffer not reset
  */
 
-static int reset_circular_buffer(void)
+static int reset_circular_buffer(bool snapshot_available)
 {
-    int rez = GDB_OK;
+    int rez = clear_circular_buffer(snapshot_available);
 
-    if (parameters.clear_buffer)
+    if ((rez == GDB_OK) && (parameters.clear_buffer || single_shot_active()))
     {
-        unsigned circular_buffer_size = parameters.size - sizeof(rtedbg_header);
-        unsigned char* circular_buffer = (unsigned char*)malloc(circular_buffer_size);
-        if (circular_buffer == NULL)
-        {
-            log_string("\nCould not allocate memory buffer.", NULL);
-            return GDB_ERROR;
-        }
+        rez = erase_buffer_index();   // Restart logging at the start of the circular buffer
+    }
+
+    return rez;
+}
 
-        memset(circular_buffer, 0xFFU, circular_buffer_size);
 
+/***
+ * @brief Reset the contents of the circular buffer to 0xFFFFFFFF if enabled with the
+ *        -clear argument. The buffer index is not changed.
+ * 
+ * @param snapshot_available  true - the p_rtedbg_structure contains the current
+ *                            circular buffer contents (logging is paused)
+ * 
+ * @return GDB_OK    - no error
+ *         GDB_ERROR - buffer not cleared
+ */
+
+static int clear_circular_buffer(bool snapshot_available)
+{
+    int rez = GDB_OK;
+
+    if (parameters.clear_buffer)
+    {
         LARGE_INTEGER start_time;
         start_timer(&start_time);
 
-        if (logging_to_file())
+        if (parameters.clear_incremental && snapshot_available && (p_rtedbg_structure != NULL))
         {
-            printf("\nClearing the circular buffer ...");
+            rez = clear_used_buffer_parts();
         }
+        else
+        {
+            if (logging_to_file())
+            {
+                printf("\nClearing the circular buffer ...");
+            }
 
-        rez = gdb_write_memory(
-            circular_buffer,
-            parameters.start_address + sizeof(rtedbg_header_t),
-            circular_buffer_size);
-        free(circular_buffer);
+            rez = gdb_fill_memory(
+                parameters.start_address + sizeof(rtedbg_header_t),
+                parameters.size - sizeof(rtedbg_header_t),
+                0xFFFFFFFFU);
+
+            if ((rez == GDB_OK) && snapshot_valid)
+            {
+                // Keep the snapshot equal to the buffer contents
+                memset(&p_rtedbg_structure[sizeof(rtedbg_header_t) / 4U], 0xFF,
+                    parameters.size - sizeof(rtedbg_header_t));
+            }
+        }
 
         if (rez != GDB_OK)
         {
+            snapshot_valid = false;
             return GDB_ERROR;
         }
 
@@ -1242,12 +2372,77 @@ static int reset_circular_buffer(void)
             (long long)((parameters.size - sizeof(rtedbg_header)) / time_elapsed(&start_time)));
     }
 
-    if (parameters.clear_buffer || single_shot_active())
+    return rez;
+}
+
+
+/***
+ * @brief Clear only the parts of the circular buffer that have been used since the last
+ *        clear, i.e. the words that are not 0xFFFFFFFF in the loaded snapshot.
+ *        Logging must be paused. Used parts separated by fewer than CLEAR_MERGE_GAP_WORDS
+ *        unused words are cleared with a single write. This covers the single shot
+ *        mode (only the start of the buffer is used) and the post-mortem mode with
+ *        wrap-around (the used part may be anywhere in the buffer).
+ * 
+ * @return GDB_OK    - no error
+ *         GDB_ERROR - buffer not cleared
+ */
+
+static int clear_used_buffer_parts(void)
+{
+    unsigned* buffer = &p_rtedbg_structure[sizeof(rtedbg_header_t) / 4U];
+    const unsigned buffer_words = (parameters.size - sizeof(rtedbg_header_t)) / 4U;
+    unsigned words_cleared = 0;
+    unsigned parts_cleared = 0;
+    unsigned i = 0;
+
+    if (logging_to_file())
     {
-        rez = erase_buffer_index();   // Restart logging at the start of the circular buffer
+        printf("\nClearing the used parts of the circular buffer ...");
     }
 
-    return rez;
+    while (i < buffer_words)
+    {
+        if (buffer[i] == 0xFFFFFFFFU)
+        {
+            i++;
+            continue;
+        }
+
+        unsigned start = i;
+        unsigned end = i + 1U;          // Index after the last used word
+
+        for (i = end; i < buffer_words; i++)
+        {
+            if (buffer[i] != 0xFFFFFFFFU)
+            {
+                end = i + 1U;
+            }
+            else if ((i - end) >= CLEAR_MERGE_GAP_WORDS)
+            {
+                break;
+            }
+        }
+
+        int rez = gdb_fill_memory(
+            parameters.start_address + sizeof(rtedbg_header_t) + 4U * start,
+            4U * (end - start),
+            0xFFFFFFFFU);
+
+        if (rez != GDB_OK)
+        {
+            snapshot_valid = false;
+            return GDB_ERROR;
+        }
+
+        memset(&buffer[start], 0xFF, 4U * (end - start));   // Keep the snapshot equal to the buffer contents
+        words_cleared += end - start;
+        parts_cleared++;
+    }
+
+    log_data(" %llu part(s),", (long long)parts_cleared);
+    log_data(" %llu kB cleared", (long long)(words_cleared * 4U / 1024U));
+    return GDB_OK;
 }
 
 
@@ -1286,7 +2481,10 @@ static int check_header_info(void)
 
 __declspec(noreturn) void close_files_and_exit(void)
 {
+    (void)file_writer_stop();
+    series_close();
     decrease_priorities();
+    parallel_read_stop();
     gdb_detach();
     gdb_socket_cleanup();
 
@@ -1296,6 +2494,7 @@ __declspec(noreturn) void close_files_and_exit(void)
             "\nThe log file contains further details.\n\n");
     }
 
+    close_log_file();
     (void)_fcloseall();
     exit(1);
 }
@@ -1345,7 +2544,7 @@ void initialize_data_logging_structure(unsigned cfg_word, unsigned timestamp_fre
         return;
     }
 
-    if (reset_circular_buffer() != GDB_OK)
+    if (reset_circular_buffer(false) != GDB_OK)
     {
         return;
     }
@@ -1399,10 +2598,23 @@ static bool allocate_memory_for_g_rtedbg_structure(void)
         return true;    // Memory already allocated
     }
 
+    if (caller_buffer != NULL)
+    {
+        if (parameters.size > caller_buffer_size)
+        {
+            log_data("\nThe buffer provided for the g_rtedbg structure is too small (%llu bytes needed).",
+                (long long)parameters.size);
+            return false;
+        }
+
+        p_rtedbg_structure = caller_buffer;     // The data is read directly to the caller's buffer
+        return true;
+    }
+
     p_rtedbg_structure = (unsigned*)malloc(parameters.size);
     if (p_rtedbg_structure == NULL)
     {
-        log_string("\nCould not allocate memory buffer.", NULL);
+        log_data("\nCould not allocate memory buffer (%llu bytes).", (long long)parameters.size);
         return false;
     }
 
@@ -1410,6 +2622,43 @@ static bool allocate_memory_for_g_rtedbg_structure(void)
 }
 
 
+/***
+ * @brief Free the memory allocated for the g_rtedbg structure copy of the calling thread.
+ */
+
+void free_rtedbg_structure_memory(void)
+{
+    if (p_rtedbg_structure != caller_buffer)
+    {
+        free(p_rtedbg_structure);
+    }
+
+    p_rtedbg_structure = NULL;
+    snapshot_valid = false;
+}
+
+
+/***
+ * @brief Use the caller's buffer instead of the allocated memory for the g_rtedbg structure
+ *        copy (library API). The buffer must be 32-bit word aligned.
+ *
+ * @param buffer  Buffer for the g_rtedbg structure (NULL - allocate the memory)
+ * @param size    Size of the buffer [bytes]
+ */
+
+void set_rtedbg_structure_buffer(unsigned* buffer, unsigned size)
+{
+    if ((buffer == caller_buffer) && (size == caller_buffer_size))
+    {
+        return;     // The previous snapshot is still in the buffer
+    }
+
+    free_rtedbg_structure_memory();
+    caller_buffer = buffer;
+    caller_buffer_size = (buffer != NULL) ? size : 0;
+}
+
+
 /***
  * @brief Get process ID by process name
  * 
@@ -9,20 +9,72 @@
  * @author    B. Premzel
  */
 
+#pragma once
+
+#include "rtedbg.h"
+
 #define RTEGDBDATA_VERSION "v1.01"
 
 #define MIN_BUFFER_SIZE  (64U + 16U)    // Minimum buffer size for g_rtedbg circular buffer
-#define MAX_BUFFER_SIZE  2100000U       // Maximum buffer size for g_rtedbg circular buffer
+#define MAX_BUFFER_SIZE  (64U * 1024U * 1024U)
+                                        // Maximum buffer size for g_rtedbg circular buffer (plausibility check -
+                                        // the actual limit is the memory available on the host)
 #define MESSAGE_FILTER_ADDRESS  (parameters.start_address + offsetof(rtedbg_header_t, filter))
                                         // Address of the message filter
 #define RTE_CFG_WORD_ADDRESS    (parameters.start_address + offsetof(rtedbg_header_t, rte_cfg))
                                         // Address of the RTE configuration word
 
 #define MAX_DRIVERS 5                   // Maximum number of drivers that should get elevated execution priority
+#define MAX_TARGETS 16U                 // Maximum number of embedded systems accessed in parallel (-targets argument)
+#define MAX_CONNECTIONS 8U              // Maximum number of GDB server connections for a parallel read (-connections argument)
+#define PARALLEL_MIN_CHUNK_SIZE (32U * 1024U) // Min. size of the memory block part read over each connection [bytes]
+#define PARALLEL_MIN_GAIN 1.2           // Min. speed gain of the parallel read - otherwise a single connection is used
+#define PARALLEL_PROBE_SIZE (256U * 1024U) // Max. size of the probe read for the parallel read gain measurement [bytes]
 #define BENCHMARK_REPEAT_COUNT 1000     // Maximum number of data transfers in the benchmark
 #define MAX_BENCHMARK_TIME_MS 20000     // Maximum time for the data transfer benchmark in milliseconds
+#define BENCHMARK_REFERENCE_COUNT 20    // Number of data transfers without pipelining to measure the pipelining gain
+#define BENCHMARK_SUITE_COUNT 1000U     // Max. number of measurements per test (-benchmark argument)
+#define BENCHMARK_CYCLE_COUNT 20U       // Max. number of complete data transfer cycles measured
+#define BENCHMARK_SUITE_TEST_TIME_MS 5000 // Max. time for a single test of the benchmark suite
+#define BENCHMARK_SIZE_STEP 4U          // Ratio of consecutive block sizes in the read/write tests
+#define CLEAR_MERGE_GAP_WORDS 32U       // Cleared areas closer than this number of words are cleared with a single write
+#define CRC_CHUNK_SIZE 4096U            // Size of the circular buffer parts compared with the qCRC request [bytes]
+#define STATUS_POLL_FAST_MS 100        // Logging status poll interval [ms] while the buffer index is changing (persistent mode)
+#define STATUS_POLL_SLOW_MS 1000       // Logging status poll interval [ms] while the buffer index is not changing
+#define STATUS_POLL_IDLE_COUNT 10U     // Number of polls without an index change before the slow poll interval is used
+#define KEYBOARD_POLL_MS 50            // Max. time between the keyboard checks in the persistent mode [ms]
+#define AUTO_CAPTURE_POLL_INTERVAL 20  // Header poll interval [ms] with the -auto argument (persistent mode)
+#define STREAM_COMPLETION_DELAY 20U     // Delay [ms] before the last data is streamed - enables the firmware to finish the messages
+#define SERIES_PAGE_SIZE 4096U          // Snapshot series - size of the pages compared with the previous snapshot [bytes]
+#define SERIES_KEYFRAME_INTERVAL 64U    // Snapshot series - all pages are stored in every n-th snapshot
+#define AUTOTUNE_PROFILE_FILE "RTEgdbData_tune.txt" // File with the transfer settings found with -autotune
+#define AUTOTUNE_MAX_PROFILES 64U       // Max. number of GDB server profiles in the file
+#define AUTOTUNE_MIN_MSG_SIZE 1024U     // Smallest message size tested
+#define AUTOTUNE_MAX_CANDIDATES 32U     // Max. number of message sizes tested
+#define AUTOTUNE_READ_SIZE (64U * 1024U)// Min. size of the data read for a single measurement [bytes]
+#define AUTOTUNE_REPEAT_COUNT 3U        // Number of measurements for each setting (the fastest one is used)
+#define AUTOTUNE_MAX_TIME_MS 10000      // Max. time for the autotune measurements
+#define LOG_WRITER_BUFFER_SIZE (1024U * 1024U) // Size of each of the two buffers of the background log writer
+#define LOG_WRITER_FLUSH_MS 200         // Max. time [ms] the buffered log data waits before it is written to the file
+
+// Phases of the data transfer (logged and measured by the benchmark suite)
+enum transfer_phases
+{
+    PHASE_HEADER = 0,                   // g_rtedbg header (with the message filter) loaded and checked
+    PHASE_PAUSE,                        // Data logging paused
+    PHASE_READ,                         // g_rtedbg structure read and written to the file
+    PHASE_CLEAR,                        // Circular buffer cleared
+    PHASE_RESTORE,                      // Message filter and buffer index restored
+    TRANSFER_PHASES                     // Number of phases
+};
+
+extern thread_local rtedbg_header_t rtedbg_header;
 
 __declspec(noreturn) void close_files_and_exit(void);
+int  data_transfer_cycle(double* phase_times);
+int  load_rtedbg_structure_header(void);
+void set_rtedbg_structure_buffer(unsigned* buffer, unsigned size);
+void free_rtedbg_structure_memory(void);
 void initialize_data_logging_structure(unsigned cmd_word, unsigned timestamp_frequency);
 void set_new_filter_value(const char* filter_value);
 long clock_ms(void);
@@ -0,0 +1,398 @@
+/*
+ * Copyright (c) 2024 Branko Premzel.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * @file    autotune.cpp
+ * @brief   Automatic selection of the memory read packet size and pipeline depth.
+ * @author  B. Premzel
+ *
+ * With the -autotune argument, several message sizes (and pipeline depths up to the
+ * -pipeline=n value) are tested with a short timed read of the g_rtedbg structure after
+ * the connection to the GDB server. The fastest setting is used for the data transfers.
+ *
+ * The result is saved to the profile file together with the GDB server identity (CRC of the
+ * capability data) and the port number. The next time the same GDB server is used,
+ * the saved setting is applied immediately. Use -autotune=force to repeat the measurement.
+ */
+
+#include "pch.h"
+#include <stdlib.h>
+#include <string.h>
+#include "gdb_lib.h"
+#include "RTEgdbData.h"
+#include "cmd_line.h"
+#include "rtedbg.h"
+#include "logger.h"
+#include "autotune.h"
+
+
+typedef struct
+{
+    unsigned identity;              // GDB server identity (see gdb_server_identity())
+    unsigned port;                  // GDB server port number
+    unsigned message_size;          // Selected max. message size [bytes]
+    unsigned pipeline_depth;        // Selected pipeline depth
+} tune_profile_t;
+
+
+/*---------------- Local functions ---------------*/
+static bool load_profile(tune_profile_t* profile);
+static void save_profile(const tune_profile_t* profile);
+static unsigned read_profiles(tune_profile_t* profiles, unsigned max_count);
+static void apply_profile(const tune_profile_t* profile);
+static int  sweep_transfer_settings(tune_profile_t* profile);
+static unsigned get_message_size_candidates(unsigned max_size, unsigned* sizes);
+static double measure_read_time(unsigned char* buffer, unsigned length);
+
+
+/***
+ * @brief Apply the saved transfer settings for the connected GDB server or find the
+ *        fastest settings if they have not been saved yet (or -autotune=force is used).
+ */
+
+void autotune_transfer_settings(void)
+{
+    if (!parameters.autotune)
+    {
+        return;
+    }
+
+    tune_profile_t profile;
+    profile.identity = gdb_server_identity();
+    profile.port = parameters.gdb_port;
+
+    if (!parameters.autotune_force && load_profile(&profile))
+    {
+        apply_profile(&profile);
+        log_data("\nAutotune profile: max. message size %llu", (long long)profile.message_size);
+        log_data(", pipeline depth %llu", (long long)profile.pipeline_depth);
+        return;
+    }
+
+    if (sweep_transfer_settings(&profile) == GDB_OK)
+    {
+        save_profile(&profile);
+    }
+}
+
+
+/***
+ * @brief Set the max. message size and the pipeline depth.
+ *
+ * @param profile  Transfer settings
+ */
+
+static void apply_profile(const tune_profile_t* profile)
+{
+    gdb_set_max_message_size(profile->message_size);
+    parameters.pipeline_depth = profile->pipeline_depth;
+}
+
+
+/***
+ * @brief Measure the transfer speed for the candidate settings and apply the fastest one.
+ *        The original settings are restored if no measurement was successful.
+ *
+ * @param profile  Profile to which the selected settings are written
+ *
+ * @return GDB_OK    - settings selected
+ *         GDB_ERROR - measurement not possible
+ */
+
+static int sweep_transfer_settings(tune_profile_t* profile)
+{
+    rtedbg_header_t header;
+
+    if (gdb_read_memory((unsigned char*)&header, parameters.start_address, sizeof(header)) != GDB_OK)
+    {
+        return GDB_ERROR;
+    }
+
+    if ((header.buffer_size < 4U) || (header.buffer_size > (MAX_BUFFER_SIZE / 4U)))
+    {
+        printf("\nAutotune skipped - the g_rtedbg structure has not been initialized yet.");
+        return GDB_ERROR;
+    }
+
+    const unsigned original_message_size = parameters.max_message_size;
+    const unsigned original_pipeline_depth = parameters.pipeline_depth;
+
+    // The sizes over the PacketSize are tested only if allowed with the -msgsize argument
+    const unsigned max_size =
+        (original_message_size != 0) ? original_message_size : gdb_server_packet_size();
+    const unsigned max_depth = (original_pipeline_depth > 1U) ? original_pipeline_depth : 1U;
+
+    // Read several of the largest packets (or the whole structure if it is smaller)
+    unsigned read_size = header.buffer_size * 4U + sizeof(rtedbg_header_t);
+    unsigned min_read_size = (max_size > (AUTOTUNE_READ_SIZE / 4U)) ? (4U * max_size) : AUTOTUNE_READ_SIZE;
+    if (read_size > min_read_size)
+    {
+        read_size = min_read_size;
+    }
+
+    unsigned char* buffer = (unsigned char*)malloc(read_size);
+    if (buffer == NULL)
+    {
+        log_string("\nCould not allocate memory buffer.", NULL);
+        return GDB_ERROR;
+    }
+
+    unsigned sizes[AUTOTUNE_MAX_CANDIDATES];
+    unsigned size_count = get_message_size_candidates(max_size, sizes);
+    double best_speed = 0;
+    clock_t start_time = clock_ms();
+
+    printf("\nAutotuning the data transfer settings ... ");
+
+    if (!parameters.log_gdb_communication)
+    {
+        enable_logging(false);      // Disable logging to speed up the data transfer
+    }
+
+    for (unsigned depth = 1U; ; )
+    {
+        for (unsigned i = 0; i < size_count; i++)
+        {
+            tune_profile_t candidate = *profile;
+            candidate.message_size = sizes[i];
+            candidate.pipeline_depth = depth;
+            apply_profile(&candidate);
+
+            double time = measure_read_time(buffer, read_size);
+            if (time <= 0)
+            {
+                continue;           // Setting not usable with this GDB server
+            }
+
+            double speed = (double)read_size / time;
+            if (speed > best_speed)
+            {
+                best_speed = speed;
+                *profile = candidate;
+            }
+
+            if ((clock_ms() - start_time) > AUTOTUNE_MAX_TIME_MS)
+            {
+                break;
+            }
+        }
+
+        if ((depth >= max_depth) || ((clock_ms() - start_time) > AUTOTUNE_MAX_TIME_MS))
+        {
+            break;
+        }
+
+        depth = ((2U * depth) < max_depth) ? (2U * depth) : max_depth;
+    }
+
+    enable_logging(true);
+    free(buffer);
+
+    if (best_speed <= 0)
+    {
+        parameters.pipeline_depth = original_pipeline_depth;
+        gdb_set_max_message_size(original_message_size);
+        printf("failed - the original settings are used.");
+        return GDB_ERROR;
+    }
+
+    apply_profile(profile);
+    printf("max. message size %u, pipeline depth %u (%.1f kB/s)",
+        profile->message_size, profile->pipeline_depth, best_speed);
+    log_data("\nAutotune: max. message size %llu", (long long)profile->message_size);
+    log_data(", pipeline depth %llu", (long long)profile->pipeline_depth);
+    return GDB_OK;
+}
+
+
+/***
+ * @brief Prepare the list of message sizes to be tested - two sizes per octave,
+ *        starting with the largest allowed size.
+ *
+ * @param max_size  Largest message size
+ * @param sizes     Array for the AUTOTUNE_MAX_CANDIDATES sizes
+ *
+ * @return Number of sizes in the array
+ */
+
+static unsigned get_message_size_candidates(unsigned max_size, unsigned* sizes)
+{
+    unsigned count = 0;
+    sizes[count++] = max_size;
+
+    for (unsigned size = max_size; count < (AUTOTUNE_MAX_CANDIDATES - 1U); size /= 2U)
+    {
+        if (((size * 3U) / 4U) < AUTOTUNE_MIN_MSG_SIZE)
+        {
+            break;
+        }
+
+        sizes[count++] = (size * 3U) / 4U;
+
+        if ((size / 2U) < AUTOTUNE_MIN_MSG_SIZE)
+        {
+            break;
+        }
+
+        sizes[count++] = size / 2U;
+    }
+
+    return count;
+}
+
+
+/***
+ * @brief Measure the time needed to read the start of the g_rtedbg structure.
+ *        The shortest of several measurements is used.
+ *
+ * @param buffer  Buffer for the data
+ * @param length  Number of bytes to read
+ *
+ * @return Read time [ms], -1 if the data could not be read
+ */
+
+static double measure_read_time(unsigned char* buffer, unsigned length)
+{
+    double min_time = 9e99;
+
+    for (unsigned i = 0; i < AUTOTUNE_REPEAT_COUNT; i++)
+    {
+        LARGE_INTEGER start_time;
+        start_timer(&start_time);
+
+        if (gdb_read_memory(buffer, parameters.start_address, length) != GDB_OK)
+        {
+            return -1.0;
+        }
+
+        double time = time_elapsed(&start_time);
+        if (time < min_time)
+        {
+            min_time = time;
+        }
+    }
+
+    return min_time;
+}
+
+
+/***
+ * @brief Find the saved settings for the GDB server identity and port in the profile.
+ *
+ * @param profile  Profile with the identity and port; the settings are written to it
+ *
+ * @return true - settings found
+ */
+
+static bool load_profile(tune_profile_t* profile)
+{
+    tune_profile_t profiles[AUTOTUNE_MAX_PROFILES];
+    unsigned count = read_profiles(profiles, AUTOTUNE_MAX_PROFILES);
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        if ((profiles[i].identity == profile->identity) && (profiles[i].port == profile->port))
+        {
+            *profile = profiles[i];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/***
+ * @brief Read the saved settings from the profile file. Lines with invalid values are skipped.
+ *
+ * @param profiles   Array for the profiles
+ * @param max_count  Size of the array
+ *
+ * @return Number of profiles read
+ */
+
+static unsigned read_profiles(tune_profile_t* profiles, unsigned max_count)
+{
+    FILE* file;
+    if ((fopen_s(&file, AUTOTUNE_PROFILE_FILE, "r") != 0) || (file == NULL))
+    {
+        return 0;       // No settings saved yet
+    }
+
+    unsigned count = 0;
+    char line[128];
+
+    while ((count < max_count) && (fgets(line, sizeof(line), file) != NULL))
+    {
+        tune_profile_t* p = &profiles[count];
+
+        if ((line[0] != '#')
+            && (sscanf_s(line, "%x %u %u %u", &p->identity, &p->port, &p->message_size, &p->pipeline_depth) == 4)
+            && (p->message_size >= 256U) && (p->message_size <= MAX_MESSAGE_BUFFER_SIZE)
+            && (p->pipeline_depth >= 1U) && (p->pipeline_depth <= MAX_PIPELINE_DEPTH))
+        {
+            count++;
+        }
+    }
+
+    (void)fclose(file);
+    return count;
+}
+
+
+/***
+ * @brief Save the settings to the profile file. The settings for the same GDB server and port
+ *        are replaced. The oldest entry is removed if the file is full.
+ *
+ * @param profile  Settings to be saved
+ */
+
+static void save_profile(const tune_profile_t* profile)
+{
+    tune_profile_t profiles[AUTOTUNE_MAX_PROFILES];
+    unsigned count = read_profiles(profiles, AUTOTUNE_MAX_PROFILES);
+    unsigned index = count;
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        if ((profiles[i].identity == profile->identity) && (profiles[i].port == profile->port))
+        {
+            index = i;
+            break;
+        }
+    }
+
+    if (index >= AUTOTUNE_MAX_PROFILES)
+    {
+        memmove(&profiles[0], &profiles[1], (AUTOTUNE_MAX_PROFILES - 1U) * sizeof(tune_profile_t));
+        index = AUTOTUNE_MAX_PROFILES - 1U;
+    }
+
+    profiles[index] = *profile;
+    if (index >= count)
+    {
+        count = index + 1U;
+    }
+
+    FILE* file;
+    if ((fopen_s(&file, AUTOTUNE_PROFILE_FILE, "w") != 0) || (file == NULL))
+    {
+        log_string("\nCould not write to the file: %s.", AUTOTUNE_PROFILE_FILE);
+        return;
+    }
+
+    fprintf(file, "# GDB server identity, port, max. message size, pipeline depth\n");
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        fprintf(file, "%08X %u %u %u\n", profiles[i].identity, profiles[i].port,
+            profiles[i].message_size, profiles[i].pipeline_depth);
+    }
+
+    (void)fclose(file);
+}
+
+/*==== End of file ====*/
@@ -0,0 +1,17 @@
+/*
+ * Copyright (c) 2024 Branko Premzel.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * @file    autotune.h
+ * @brief   Automatic selection of the memory read packet size and pipeline depth.
+ * @author  B. Premzel
+ */
+
+#pragma once
+
+void autotune_transfer_settings(void);
+
+/*==== End of file ====*/
@@ -0,0 +1,405 @@
+/*
+ * Copyright (c) 2024 Branko Premzel.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * @file    benchmark_suite.cpp
+ * @brief   Non-interactive data transfer benchmark (-benchmark=file argument).
+ * @author  B. Premzel
+ *
+ * The benchmark measures:
+ * - round-trip latency of the smallest memory read (4 bytes),
+ * - complete data transfer cycles (as with a single data transfer) split into phases,
+ * - memory reads of different block sizes,
+ * - memory writes of different block sizes (to the circular buffer).
+ *
+ * The results are written to a CSV file (one line per test) with the percentiles of the
+ * measured times, so that the results of different debug probes, probe firmware and
+ * RTEgdbData versions can be compared automatically. Lines starting with '#' contain
+ * information about the test setup.
+ *
+ * Caution: the circular buffer is cleared and overwritten by the benchmark.
+ */
+
+#include "pch.h"
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include "gdb_lib.h"
+#include "RTEgdbData.h"
+#include "cmd_line.h"
+#include "rtedbg.h"
+#include "logger.h"
+#include "benchmark_suite.h"
+
+
+/*---------------- Local functions ---------------*/
+static void write_report_header(FILE* report);
+static int  measure_latency(FILE* report, double* samples);
+static int  measure_transfer_cycles(FILE* report, double* samples);
+static int  measure_block_transfers(FILE* report, double* samples, bool write);
+static void write_statistics(FILE* report, const char* test, unsigned size, double* samples, unsigned count);
+static double percentile(const double* sorted_samples, unsigned count, double fraction);
+static int  compare_samples(const void* a, const void* b);
+
+static const char* const phase_names[TRANSFER_PHASES] =
+{
+    "cycle_header", "cycle_pause", "cycle_read", "cycle_clear", "cycle_restore"
+};
+
+
+/***
+ * @brief Run all benchmark tests and write the results to the -benchmark=file CSV file.
+ *
+ * @return 0 - no error
+ *         1 - error occurred
+ */
+
+int run_benchmark_suite(void)
+{
+    FILE* report;
+    errno_t rez = fopen_s(&report, parameters.benchmark_file, "w");
+    if ((rez != 0) || (report == NULL))
+    {
+        char error_text[256];
+        (void)strerror_s(error_text, sizeof(error_text), errno);
+        printf("\nCannot create file '%s' - error: %s.\n", parameters.benchmark_file, error_text);
+        return 1;
+    }
+
+    double* samples = (double*)malloc(BENCHMARK_SUITE_COUNT * sizeof(double));
+    if (samples == NULL)
+    {
+        log_string("\nCould not allocate memory buffer.", NULL);
+        (void)fclose(report);
+        return 1;
+    }
+
+    printf("\nRunning the data transfer benchmark - the circular buffer contents will be cleared.");
+    write_report_header(report);
+
+    // The transfer cycles are measured first - they load the g_rtedbg header
+    int result = measure_transfer_cycles(report, samples);
+
+    if (!parameters.log_gdb_communication)
+    {
+        enable_logging(false);      // Disable logging to speed up the data transfer
+    }
+
+    if (result == GDB_OK)
+    {
+        result = measure_latency(report, samples);
+    }
+
+    if (result == GDB_OK)
+    {
+        result = measure_block_transfers(report, samples, false);
+    }
+
+    if (result == GDB_OK)
+    {
+        result = measure_block_transfers(report, samples, true);
+    }
+
+    enable_logging(true);
+    free(samples);
+    (void)fclose(report);
+
+    if (result != GDB_OK)
+    {
+        printf("\nBenchmark terminated prematurely - problem with the data transfer.");
+        return 1;
+    }
+
+    printf("\nBenchmark results written to \"%s\"\n", parameters.benchmark_file);
+    return 0;
+}
+
+
+/***
+ * @brief Write the test setup information and the column names.
+ *
+ * @param report  Report file
+ */
+
+static void write_report_header(FILE* report)
+{
+    char date_text[32] = "";
+    time_t now = time(NULL);
+    struct tm local_time;
+
+    if (localtime_s(&local_time, &now) == 0)
+    {
+        (void)strftime(date_text, sizeof(date_text), "%Y-%m-%d %H:%M:%S", &local_time);
+    }
+
+    fprintf(report, "# RTEgdbData %s benchmark, %s\n", RTEGDBDATA_VERSION, date_text);
+    fprintf(report, "# GDB server identity %08X, port %u, packet size %u, max. message size %u, pipeline depth %u\n",
+        gdb_server_identity(), parameters.gdb_port, gdb_server_packet_size(),
+        parameters.max_message_size, parameters.pipeline_depth);
+    fprintf(report, "test;size;count;min_ms;p50_ms;p99_ms;p99.9_ms;max_ms;avg_ms;p50_speed_kBps\n");
+}
+
+
+/***
+ * @brief Measure the round-trip time of the smallest memory read request.
+ *
+ * @param report   Report file
+ * @param samples  Buffer for the measured times
+ *
+ * @return GDB_OK    - no error
+ *         GDB_ERROR - data could not be read
+ */
+
+static int measure_latency(FILE* report, double* samples)
+{
+    unsigned data;
+    unsigned count;
+    clock_t start_time = clock_ms();
+
+    for (count = 0; count < BENCHMARK_SUITE_COUNT; count++)
+    {
+        LARGE_INTEGER read_start;
+        start_timer(&read_start);
+
+        if (gdb_read_memory((unsigned char*)&data, MESSAGE_FILTER_ADDRESS, 4U) != GDB_OK)
+        {
+            return GDB_ERROR;
+        }
+
+        samples[count] = time_elapsed(&read_start);
+
+        if ((clock_ms() - start_time) > BENCHMARK_SUITE_TEST_TIME_MS)
+        {
+            count++;
+            break;
+        }
+    }
+
+    write_statistics(report, "latency", 4U, samples, count);
+    return GDB_OK;
+}
+
+
+/***
+ * @brief Measure the complete data transfer cycles and the time used by each phase.
+ *
+ * @param report   Report file
+ * @param samples  Buffer for the measured times
+ *
+ * @return GDB_OK    - no error
+ *         GDB_ERROR - data transfer failed
+ */
+
+static int measure_transfer_cycles(FILE* report, double* samples)
+{
+    double* phase_samples = (double*)malloc(BENCHMARK_CYCLE_COUNT * TRANSFER_PHASES * sizeof(double));
+    if (phase_samples == NULL)
+    {
+        log_string("\nCould not allocate memory buffer.", NULL);
+        return GDB_ERROR;
+    }
+
+    unsigned count;
+    clock_t start_time = clock_ms();
+
+    for (count = 0; count < BENCHMARK_CYCLE_COUNT; count++)
+    {
+        double phase_times[TRANSFER_PHASES];
+        LARGE_INTEGER cycle_start;
+        start_timer(&cycle_start);
+
+        if (!parameters.log_gdb_communication)
+        {
+            enable_logging(false);
+        }
+
+        int rez = data_transfer_cycle(phase_times);
+        enable_logging(true);
+
+        if (rez != GDB_OK)
+        {
+            free(phase_samples);
+            return GDB_ERROR;
+        }
+
+        samples[count] = time_elapsed(&cycle_start);
+
+        for (unsigned phase = 0; phase < TRANSFER_PHASES; phase++)
+        {
+            phase_samples[phase * BENCHMARK_CYCLE_COUNT + count] = phase_times[phase];
+        }
+
+        if ((clock_ms() - start_time) > BENCHMARK_SUITE_TEST_TIME_MS)
+        {
+            count++;
+            break;
+        }
+    }
+
+    write_statistics(report, "cycle_total", parameters.size, samples, count);
+
+    for (unsigned phase = 0; phase < TRANSFER_PHASES; phase++)
+    {
+        write_statistics(report, phase_names[phase], parameters.size,
+            &phase_samples[phase * BENCHMARK_CYCLE_COUNT], count);
+    }
+
+    free(phase_samples);
+    return GDB_OK;
+}
+
+
+/***
+ * @brief Measure the memory reads or writes with block sizes from 4 bytes to the
+ *        size of the g_rtedbg structure (reads) or circular buffer (writes).
+ *        The writes fill the circular buffer with the value used to clear it.
+ *
+ * @param report   Report file
+ * @param samples  Buffer for the measured times
+ * @param write    true - measure writes, false - measure reads
+ *
+ * @return GDB_OK    - no error
+ *         GDB_ERROR - data transfer failed
+ */
+
+static int measure_block_transfers(FILE* report, double* samples, bool write)
+{
+    const unsigned address = parameters.start_address + (write ? sizeof(rtedbg_header_t) : 0U);
+    const unsigned max_size = parameters.size - (write ? sizeof(rtedbg_header_t) : 0U);
+
+    unsigned char* buffer = (unsigned char*)malloc(max_size);
+    if (buffer == NULL)
+    {
+        log_string("\nCould not allocate memory buffer.", NULL);
+        return GDB_ERROR;
+    }
+
+    memset(buffer, 0xFF, max_size);
+
+    for (unsigned size = 4U; ; size *= BENCHMARK_SIZE_STEP)
+    {
+        if (size > max_size)
+        {
+            size = max_size;    // The last measurement - complete structure or buffer
+        }
+
+        unsigned count;
+        clock_t start_time = clock_ms();
+
+        for (count = 0; count < BENCHMARK_SUITE_COUNT; count++)
+        {
+            LARGE_INTEGER transfer_start;
+            start_timer(&transfer_start);
+
+            int rez = write ? gdb_write_memory(buffer, address, size) : gdb_read_memory(buffer, address, size);
+            if (rez != GDB_OK)
+            {
+                free(buffer);
+                return GDB_ERROR;
+            }
+
+            samples[count] = time_elapsed(&transfer_start);
+
+            if ((clock_ms() - start_time) > BENCHMARK_SUITE_TEST_TIME_MS)
+            {
+                count++;
+                break;
+            }
+        }
+
+        write_statistics(report, write ? "write" : "read", size, samples, count);
+
+        if (size >= max_size)
+        {
+            break;
+        }
+    }
+
+    free(buffer);
+    return GDB_OK;
+}
+
+
+/***
+ * @brief Sort the measured times and write the statistics to the report and console.
+ *
+ * @param report   Report file
+ * @param test     Test name
+ * @param size     Number of bytes transferred in a single measurement
+ * @param samples  Measured times [ms]
+ * @param count    Number of measurements
+ */
+
+static void write_statistics(FILE* report, const char* test, unsigned size, double* samples, unsigned count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    qsort(samples, count, sizeof(double), compare_samples);
+
+    double sum = 0;
+    for (unsigned i = 0; i < count; i++)
+    {
+        sum += samples[i];
+    }
+
+    double p50 = percentile(samples, count, 0.5);
+    double p99 = percentile(samples, count, 0.99);
+    double p999 = percentile(samples, count, 0.999);
+    double speed = (p50 > 0) ? ((double)size / p50) : 0;
+
+    fprintf(report, "%s;%u;%u;%.3f;%.3f;%.3f;%.3f;%.3f;%.3f;%.1f\n",
+        test, size, count, samples[0], p50, p99, p999, samples[count - 1U], sum / (double)count, speed);
+    (void)fflush(report);
+
+    printf("\n%-14s %8u bytes: p50 %8.3f ms, p99 %8.3f ms, p99.9 %8.3f ms, max %8.3f ms",
+        test, size, p50, p99, p999, samples[count - 1U]);
+}
+
+
+/***
+ * @brief Get the percentile of the sorted measurements (nearest-rank method).
+ *
+ * @param sorted_samples  Sorted measurements
+ * @param count           Number of measurements
+ * @param fraction        Percentile (0.5 = median)
+ *
+ * @return Measured value
+ */
+
+static double percentile(const double* sorted_samples, unsigned count, double fraction)
+{
+    unsigned rank = (unsigned)(fraction * (double)count + 0.999999);
+
+    if (rank < 1U)
+    {
+        rank = 1U;
+    }
+
+    if (rank > count)
+    {
+        rank = count;
+    }
+
+    return sorted_samples[rank - 1U];
+}
+
+
+/***
+ * @brief Compare function for qsort() - ascending order of the measured times.
+ */
+
+static int compare_samples(const void* a, const void* b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/*==== End of file ====*/
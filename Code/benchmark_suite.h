@@ -0,0 +1,17 @@
+/*
+ * Copyright (c) 2024 Branko Premzel.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * @file    benchmark_suite.h
+ * @brief   Non-interactive data transfer benchmark (-benchmark=file argument).
+ * @author  B. Premzel
+ */
+
+#pragma once
+
+int run_benchmark_suite(void);
+
+/*==== End of file ====*/
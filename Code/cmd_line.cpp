@@ -23,6 +23,35 @@
 // Local functions
 static void show_help_and_exit(void);
 static void check_parameters(void);
+static void process_fill_mode(const char* mode);
+
+
+/***
+ * @brief Process the memory fill mode parameter (-fill=off|auto|openocd).
+ *
+ * @param mode Pointer to the mode string
+ */
+
+static void process_fill_mode(const char* mode)
+{
+    if (strcmp(mode, "auto") == 0)
+    {
+        parameters.fill_mode = FILL_AUTO;
+    }
+    else if (strcmp(mode, "off") == 0)
+    {
+        parameters.fill_mode = FILL_OFF;
+    }
+    else if (strcmp(mode, "openocd") == 0)
+    {
+        parameters.fill_mode = FILL_OPENOCD;
+    }
+    else
+    {
+        printf("The '-fill=xxx' parameter must be 'auto', 'off' or 'openocd'.");
+        show_help_and_exit();
+    }
+}
 
 
 /***
@@ -70,6 +99,69 @@ static void check_parameters(void)
         printf("The address parameter must be divisible by 4 (32-bit word aligned).");
         show_help_and_exit();
     }
+
+    if ((parameters.stream_file_name != NULL) && !parameters.persistent_connection)
+    {
+        printf("The -stream=file_name argument can only be used in the persistent mode (-p).");
+        show_help_and_exit();
+    }
+
+    if ((parameters.benchmark_file != NULL) && parameters.persistent_connection)
+    {
+        printf("The -benchmark=file argument can not be used in the persistent mode (-p).");
+        show_help_and_exit();
+    }
+
+    if ((parameters.auto_capture_level != 0) && !parameters.persistent_connection)
+    {
+        printf("The -auto=xx argument can only be used in the persistent mode (-p).");
+        show_help_and_exit();
+    }
+
+    if (parameters.minimal_pause && (parameters.clear_buffer || (parameters.tail_kb != 0) || parameters.crc_change_detection))
+    {
+        printf("The -minpause argument can not be used with the -clear, -tail and -crc arguments.");
+        show_help_and_exit();
+    }
+
+    if (parameters.extract_series && (parameters.series_file_name == NULL))
+    {
+        printf("The -extract=n argument requires the -series=file argument.");
+        show_help_and_exit();
+    }
+
+    if ((parameters.target_count > 0) && (parameters.persistent_connection || parameters.autotune
+        || parameters.async_write || (parameters.benchmark_file != NULL) || (parameters.series_file_name != NULL)))
+    {
+        printf("The -targets argument can only be used for a single data transfer "
+            "(not with the -p, -autotune, -async, -benchmark and -series arguments).");
+        show_help_and_exit();
+    }
+
+    for (unsigned i = 0; i < parameters.target_count; i++)
+    {
+        target_t* target = &parameters.targets[i];
+
+        if (target->ip_address == NULL)
+        {
+            target->ip_address = parameters.ip_address;
+        }
+
+        bool duplicate = (target->gdb_port == parameters.gdb_port)
+            && (strcmp(target->ip_address, parameters.ip_address) == 0);
+
+        for (unsigned j = 0; j < i; j++)
+        {
+            duplicate |= (target->gdb_port == parameters.targets[j].gdb_port)
+                && (strcmp(target->ip_address, parameters.targets[j].ip_address) == 0);
+        }
+
+        if (duplicate)
+        {
+            printf("The GDB server %s:%u is defined more than once.", target->ip_address, target->gdb_port);
+            show_help_and_exit();
+        }
+    }
 }
 
 
@@ -120,7 +212,7 @@ static void process_max_msg_length_value(const char* number)
 
     if (sscanf_s(number, "%u", &n) == 1)
     {
-        if ((n >= 256U) && (n <= TCP_BUFF_LENGTH))
+        if ((n >= 256U) && (n <= MAX_MESSAGE_BUFFER_SIZE))
         {
             parameters.max_message_size = n;
             value_ok = true;
@@ -129,12 +221,259 @@ static void process_max_msg_length_value(const char* number)
 
     if (!value_ok)
     {
-        printf("The '-len=xxx' parameter must be >= 256 and <= %u.", TCP_BUFF_LENGTH);
+        printf("The '-msgsize=xxx' parameter must be >= 256 and <= %u.", MAX_MESSAGE_BUFFER_SIZE);
+        show_help_and_exit();
+    }
+}
+
+
+/***
+ * @brief Process pipeline depth parameter
+ *
+ * This function processes the pipeline depth parameter provided as a string.
+ * It converts the string to an unsigned integer.
+ * If the conversion is successful and the value is within the valid range,
+ * it sets the pipeline depth parameter.
+ * If the conversion fails or the value is out of range, it displays an error message and exits the program.
+ *
+ * @param number Pointer to number string
+ */
+
+static void process_pipeline_depth_value(const char* number)
+{
+    unsigned int n = 0;
+    bool value_ok = false;
+
+    if (sscanf_s(number, "%u", &n) == 1)
+    {
+        if ((n >= 1U) && (n <= MAX_PIPELINE_DEPTH))
+        {
+            parameters.pipeline_depth = n;
+            value_ok = true;
+        }
+    }
+
+    if (!value_ok)
+    {
+        printf("The '-pipeline=xxx' parameter must be >= 1 and <= %u.", MAX_PIPELINE_DEPTH);
+        show_help_and_exit();
+    }
+}
+
+
+/***
+ * @brief Process the number of GDB server connections used for the parallel read
+ *
+ * @param number Pointer to number string
+ */
+
+static void process_connections_value(const char* number)
+{
+    unsigned int n = 0;
+    bool value_ok = false;
+
+    if (sscanf_s(number, "%u", &n) == 1)
+    {
+        if ((n >= 1U) && (n <= MAX_CONNECTIONS))
+        {
+            parameters.connections = n;
+            value_ok = true;
+        }
+    }
+
+    if (!value_ok)
+    {
+        printf("The '-connections=n' parameter must be >= 1 and <= %u.", MAX_CONNECTIONS);
         show_help_and_exit();
     }
 }
 
 
+/***
+ * @brief Process socket receive buffer size parameter
+ *
+ * This function processes the receive buffer size (in kB) provided as a string.
+ * If the value is within the valid range, it sets the socket_rcvbuf_kb parameter.
+ * Otherwise, it displays an error message and exits the program.
+ *
+ * @param number Pointer to number string
+ */
+
+static void process_rcvbuf_value(const char* number)
+{
+    unsigned int n = 0;
+    bool value_ok = false;
+
+    if (sscanf_s(number, "%u", &n) == 1)
+    {
+        if ((n >= MIN_SOCKET_RCVBUF_KB) && (n <= MAX_SOCKET_RCVBUF_KB))
+        {
+            parameters.socket_rcvbuf_kb = n;
+            value_ok = true;
+        }
+    }
+
+    if (!value_ok)
+    {
+        printf("The '-rcvbuf=xxx' parameter must be >= %u and <= %u.", MIN_SOCKET_RCVBUF_KB, MAX_SOCKET_RCVBUF_KB);
+        show_help_and_exit();
+    }
+}
+
+
+/***
+ * @brief Process automatic data transfer parameter
+ *
+ * This function processes the single shot buffer usage (in %) that starts an automatic data transfer.
+ * If the value is within the valid range, it sets the auto_capture_level parameter.
+ * Otherwise, it displays an error message and exits the program.
+ *
+ * @param number Pointer to number string
+ */
+
+static void process_auto_capture_value(const char* number)
+{
+    unsigned int n = 0;
+    bool value_ok = false;
+
+    if (sscanf_s(number, "%u", &n) == 1)
+    {
+        if ((n >= 1U) && (n <= 100U))
+        {
+            parameters.auto_capture_level = n;
+            value_ok = true;
+        }
+    }
+
+    if (!value_ok)
+    {
+        printf("The '-auto=xx' parameter must be >= 1 and <= 100.");
+        show_help_and_exit();
+    }
+}
+
+
+/***
+ * @brief Process tail size parameter
+ *
+ * This function processes the size (in kB) of the most recent data read from the circular buffer.
+ * If the value is within the valid range, it sets the tail_kb parameter.
+ * Otherwise, it displays an error message and exits the program.
+ *
+ * @param number Pointer to number string
+ */
+
+static void process_tail_value(const char* number)
+{
+    unsigned int n = 0;
+    bool value_ok = false;
+
+    if (sscanf_s(number, "%u", &n) == 1)
+    {
+        if ((n >= 1U) && (n <= (MAX_BUFFER_SIZE / 1024U)))
+        {
+            parameters.tail_kb = n;
+            value_ok = true;
+        }
+    }
+
+    if (!value_ok)
+    {
+        printf("The '-tail=xxx' parameter must be >= 1 and <= %u.", MAX_BUFFER_SIZE / 1024U);
+        show_help_and_exit();
+    }
+}
+
+
+/***
+ * @brief Process snapshot extraction parameter
+ *
+ * This function processes the number of the snapshot to be rebuilt from the series file.
+ * The value 'last' selects the last snapshot in the file.
+ * If the value is not correct, it displays an error message and exits the program.
+ *
+ * @param number Pointer to number string
+ */
+
+static void process_extract_value(const char* number)
+{
+    unsigned int n = 0;
+    parameters.extract_series = true;
+
+    if (strcmp(number, "last") == 0)
+    {
+        parameters.extract_snapshot = 0;
+        return;
+    }
+
+    if ((sscanf_s(number, "%u", &n) != 1) || (n < 1U))
+    {
+        printf("The '-extract=n' parameter must be >= 1 or 'last'.");
+        show_help_and_exit();
+    }
+
+    parameters.extract_snapshot = n;
+}
+
+
+/***
+ * @brief Process the list of additional embedded systems
+ *
+ * This function processes the comma separated list of GDB servers in the [ip:]port format.
+ * The IP address defined with the -ip argument is used if the address is not given.
+ * If a value is not correct or there are too many targets, it displays an error message
+ * and exits the program.
+ *
+ * @param list Pointer to the list string
+ */
+
+static void process_targets_value(char* list)
+{
+    char* item = list;
+
+    while (item != NULL)
+    {
+        char* next = strchr(item, ',');
+        if (next != NULL)
+        {
+            *next++ = '\0';
+        }
+
+        if (parameters.target_count >= (MAX_TARGETS - 1U))
+        {
+            printf("A maximum of %u embedded systems can be accessed in parallel.", MAX_TARGETS);
+            show_help_and_exit();
+        }
+
+        target_t* target = &parameters.targets[parameters.target_count];
+        char* port = strchr(item, ':');
+        target->ip_address = NULL;
+
+        if (port != NULL)
+        {
+            *port++ = '\0';
+            target->ip_address = item;
+        }
+        else
+        {
+            port = item;
+        }
+
+        unsigned int n = 0;
+        if ((sscanf_s(port, "%u", &n) != 1) || (n == 0) || (n > 65535U)
+            || ((target->ip_address != NULL) && (*target->ip_address == '\0')))
+        {
+            printf("Incorrect GDB server in the '-targets=[ip:]port,...' parameter: '%s'.", item);
+            show_help_and_exit();
+        }
+
+        target->gdb_port = (unsigned short)n;
+        parameters.target_count++;
+        item = next;
+    }
+}
+
+
 /***
  * @brief Process delay parameter
  *
@@ -232,11 +571,9 @@ static void add_driver_name(const char* driver_name)
 /***
  * @brief Process a single command line parameter
  *
- * This function processes a single command line parameter and updates the
- * corresponding global parameters based on the parameter type. It supports
- * various parameter types such as delay, filter, binary file name, IP address,
- * log file, message size, decode file, start command file, filter names, driver,
- * clear buffer, priority, debug, and persistent connection.
+ * This function processes one command line argument and updates the corresponding
+ * field of the parameters. See the Readme.md file for the list of arguments.
+ * Incorrect values are reported and the program exits.
  *
  * @param  parameter - string with the parameter
  */
@@ -268,6 +605,18 @@ static void process_one_cmd_line_parameter(char * parameter)
     {
         process_max_msg_length_value(&parameter[9]);
     }
+    else if (strncmp(parameter, "-pipeline=", 10) == 0)
+    {
+        process_pipeline_depth_value(&parameter[10]);
+    }
+    else if (strncmp(parameter, "-connections=", 13) == 0)
+    {
+        process_connections_value(&parameter[13]);
+    }
+    else if (strncmp(parameter, "-rcvbuf=", 8) == 0)
+    {
+        process_rcvbuf_value(&parameter[8]);
+    }
     else if (strncmp(parameter, "-decode=", 8) == 0)
     {
         parameters.decode_file = remove_quotation_marks(&parameter[8]);
@@ -280,6 +629,55 @@ static void process_one_cmd_line_parameter(char * parameter)
     {
         parameters.filter_names = remove_quotation_marks(&parameter[14]);
     }
+    else if (strncmp(parameter, "-stream=", 8) == 0)
+    {
+        parameters.stream_file_name = remove_quotation_marks(&parameter[8]);
+    }
+    else if (strncmp(parameter, "-benchmark=", 11) == 0)
+    {
+        parameters.benchmark_file = remove_quotation_marks(&parameter[11]);
+    }
+    else if (strncmp(parameter, "-series=", 8) == 0)
+    {
+        parameters.series_file_name = remove_quotation_marks(&parameter[8]);
+    }
+    else if (strncmp(parameter, "-auto=", 6) == 0)
+    {
+        process_auto_capture_value(&parameter[6]);
+    }
+    else if (strncmp(parameter, "-tail=", 6) == 0)
+    {
+        process_tail_value(&parameter[6]);
+    }
+    else if (strncmp(parameter, "-targets=", 9) == 0)
+    {
+        process_targets_value(&parameter[9]);
+    }
+    else if (strncmp(parameter, "-extract=", 9) == 0)
+    {
+        process_extract_value(&parameter[9]);
+    }
+    else if (strncmp(parameter, "-capture=", 9) == 0)
+    {
+        parameters.capture_file = remove_quotation_marks(&parameter[9]);
+    }
+    else if (strncmp(parameter, "-convert=", 9) == 0)
+    {
+        parameters.convert_file = remove_quotation_marks(&parameter[9]);
+    }
+    else if (strcmp(parameter, "-stats") == 0)
+    {
+        parameters.stats = true;
+    }
+    else if (strncmp(parameter, "-stats=", 7) == 0)
+    {
+        parameters.stats = true;
+        parameters.stats_file = remove_quotation_marks(&parameter[7]);
+    }
+    else if (strcmp(parameter, "-compress") == 0)
+    {
+        parameters.series_compress = true;
+    }
     else if (strncmp(parameter, "-driver=", 8) == 0)
     {
         add_driver_name(remove_quotation_marks(&parameter[8]));
@@ -288,6 +686,41 @@ static void process_one_cmd_line_parameter(char * parameter)
     {
         parameters.clear_buffer = true;
     }
+    else if (strcmp(parameter, "-clear=incremental") == 0)
+    {
+        parameters.clear_buffer = true;
+        parameters.clear_incremental = true;
+    }
+    else if (strncmp(parameter, "-fill=", 6) == 0)
+    {
+        process_fill_mode(&parameter[6]);
+    }
+    else if (strcmp(parameter, "-autotune") == 0)
+    {
+        parameters.autotune = true;
+    }
+    else if (strcmp(parameter, "-autotune=force") == 0)
+    {
+        parameters.autotune = true;
+        parameters.autotune_force = true;
+    }
+    else if (strcmp(parameter, "-crc") == 0)
+    {
+        parameters.crc_change_detection = true;
+    }
+    else if (strcmp(parameter, "-crc=verify") == 0)
+    {
+        parameters.crc_change_detection = true;
+        parameters.crc_verify = true;
+    }
+    else if (strcmp(parameter, "-async") == 0)
+    {
+        parameters.async_write = true;
+    }
+    else if (strcmp(parameter, "-minpause") == 0)
+    {
+        parameters.minimal_pause = true;
+    }
     else if (strcmp(parameter, "-priority") == 0)
     {
         parameters.elevated_priority = true;
@@ -300,6 +733,18 @@ static void process_one_cmd_line_parameter(char * parameter)
     {
         parameters.detach = true;
     }
+    else if (strcmp(parameter, "-hex") == 0)
+    {
+        parameters.hex_transfers = true;
+    }
+    else if (strcmp(parameter, "-fastconnect") == 0)
+    {
+        parameters.fast_connect = true;
+    }
+    else if (strcmp(parameter, "-batch") == 0)
+    {
+        parameters.batch_commands = true;
+    }
     else if (strcmp(parameter, "-p") == 0)
     {
         parameters.persistent_connection = true;
@@ -15,6 +15,21 @@
 #ifndef _COMMAND_LINE_PAR_H
 #define _COMMAND_LINE_PAR_H
 
+// Memory fill method used to clear the circular buffer (-fill argument)
+typedef enum
+{
+    FILL_AUTO = 0,                  // Use the server side fill if the GDB server type is recognized
+    FILL_OFF,                       // Always use memory write packets
+    FILL_OPENOCD                    // Use the OpenOCD 'mww' monitor command
+} fill_mode_t;
+
+// Additional embedded system (GDB server) defined with the -targets argument
+typedef struct
+{
+    const char* ip_address;         // GDB server IP address
+    unsigned short gdb_port;        // GDB server port number
+} target_t;
+
 // Command line parameters structure
 typedef struct
 {
@@ -24,24 +39,52 @@ typedef struct
     bool set_filter;                // true - set the new filter value, false - restore the old value
     unsigned delay;                 // Delay [ms] after the message filter value has been set to zero
     const char* log_file;           // Log file name (logging messages about operation and errors)
+    const char* capture_file;       // File for the binary capture of the GDB server communication (NULL - no capture)
+    const char* convert_file;       // Capture file to be converted to text (NULL - no conversion)
+    bool stats;                     // true - collect the transfer statistics
+    const char* stats_file;         // File for the transfer statistics - CSV or JSON (NULL - displayed only)
     const char* decode_file;        // Name of batch file for data decoding
     const char* bin_file_name;      // Binary file name
     const char* ip_address;         // GDB server IP address (default: "127.0.0.1" => "localhost")
                                     // The port must be defined separately with the -port=xxx parameter
     const char* start_cmd_file;     // File with commands sent to the GDB server after the start
+    bool batch_commands;            // true - send the write commands of the command files without waiting for replies
     const char* filter_names;       // File with filter names
+    const char* stream_file_name;   // File to which the logged data is streamed in the persistent mode
+    const char* benchmark_file;     // CSV file for the benchmark suite results (NULL - no benchmark)
+    const char* series_file_name;   // File to which every snapshot is appended (NULL - no snapshot series)
+    bool series_compress;           // true - compress the pages stored in the snapshot series
+    bool extract_series;            // true - rebuild a snapshot from the series file instead of the data transfer
+    unsigned extract_snapshot;      // Number of the snapshot rebuilt from the series file (0 - last one)
     unsigned short gdb_port;        // GDB server port number
     const char* driver_names[MAX_DRIVERS];  // Names of drivers with elevated priority
     size_t number_of_drivers;       // Number of drivers with elevated priority
     bool elevated_priority;         // true - set higher execution priority for RTEgdbData and servers (if names are given)
     bool clear_buffer;              // true - clear the circular buffer after data transfer to host
+    bool clear_incremental;         // true - clear only the parts of the circular buffer used since the last clear
     bool log_gdb_communication;     // true - log all communication to the log file
     bool persistent_connection;     // true - connect to the GDB server permanently to enable multiple transfers
     bool detach;                    // true - send the detach command to the GDB server before disconnecting from the server. 
     unsigned max_message_size;      // Custom max. GDB message size the server may send
+    bool hex_transfers;             // true - use only the hex encoded memory read/write packets
+    bool fast_connect;              // true - reuse the GDB server capabilities saved at the previous connection
+    unsigned pipeline_depth;        // Number of memory read requests sent without waiting for replies (0/1 = no pipelining)
+    unsigned connections;           // Number of GDB server connections used to read the g_rtedbg structure (0/1 = single)
+    unsigned socket_rcvbuf_kb;      // Socket receive buffer size [kB] (0 - Windows default)
+    fill_mode_t fill_mode;          // Memory fill method used to clear the circular buffer
+    bool crc_change_detection;      // true - read only the parts of the structure changed since the last transfer
+    bool crc_verify;                // true - check the data read with the qCRC request
+    bool autotune;                  // true - select the fastest message size and pipeline depth
+    bool autotune_force;            // true - measure again even if the settings have been saved
+    unsigned auto_capture_level;    // Single shot buffer usage [%] that starts an automatic data transfer (0 - disabled)
+    unsigned tail_kb;               // Read only the last tail_kb kB of data before the buffer index (0 - complete buffer)
+    bool async_write;               // true - write the binary file and start the decoding in a background thread
+    bool minimal_pause;             // true - restore the message filter before the circular buffer is read (post-mortem mode)
+    target_t targets[MAX_TARGETS - 1U]; // Additional embedded systems (GDB servers) defined with the -targets argument
+    unsigned target_count;          // Number of additional embedded systems (0 - single target)
 } parameters_t;
 
-extern parameters_t parameters;
+extern thread_local parameters_t parameters;
 
 void process_command_line_parameters(int argc, char * argv[]);
 
@@ -0,0 +1,495 @@
+/*
+ * Copyright (c) 2024 Branko Premzel.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * @file    data_stream.cpp
+ * @brief   Streaming of the logged data to a file without pausing the data logging.
+ * @author  B. Premzel
+ *
+ * In the persistent mode, the streaming is started and stopped with the 'C' key.
+ * The last_index of the g_rtedbg structure is polled and only the part of the
+ * circular buffer written since the previous poll is read and appended to the
+ * -stream=file_name file. The data up to the index read at the previous poll is
+ * transferred, so that the firmware has enough time to finish writing the messages
+ * for which it has reserved space in the circular buffer.
+ *
+ * The stream file starts with a g_rtedbg header followed by the streamed words.
+ * The header is updated after each appended segment. It describes a single shot
+ * buffer with the size and index equal to the number of streamed words. The file
+ * can therefore be decoded in the same way as a normal data transfer file.
+ */
+
+#include "pch.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include "gdb_lib.h"
+#include "RTEgdbData.h"
+#include "cmd_line.h"
+#include "rtedbg.h"
+#include "logger.h"
+#include "data_stream.h"
+
+
+/*---------------- GLOBAL VARIABLES ------------------*/
+static FILE* stream_file = NULL;            // Stream file (NULL - streaming not active)
+static rtedbg_header_t stream_header;       // g_rtedbg header loaded at the start of streaming
+static unsigned* segment_buffer = NULL;     // Buffer for the data read from the circular buffer
+static unsigned buffer_words;               // Circular buffer size [words]
+static bool buffer_size_power_of_2;         // true - the buffer index is masked with (buffer size - 1)
+static bool single_shot_mode;               // true - the index is not wrapped to the start of the buffer
+static unsigned stream_index;               // Index of the next word to be written to the stream file
+static unsigned seen_index;                 // Buffer index read at the previous poll
+static unsigned words_streamed;             // Number of words written to the stream file
+static unsigned words_lost;                 // Number of words overwritten before they could be read
+static LARGE_INTEGER stream_start_time;
+
+
+/*---------------- Local functions ---------------*/
+static void start_streaming(void);
+static void stop_streaming(void);
+static int  write_logged_data(void);
+static int  read_buffer_index(unsigned* index);
+static int  append_segment(unsigned end_index, unsigned current_index);
+static int  write_stream_header(void);
+static void set_logging_mode(unsigned rte_cfg);
+
+
+/***
+ * @brief Start or stop the streaming to the file defined with the -stream argument.
+ */
+
+void start_stop_streaming(void)
+{
+    if (stream_file != NULL)
+    {
+        stop_streaming();
+    }
+    else
+    {
+        start_streaming();
+    }
+}
+
+
+/***
+ * @brief Check if the streaming is active.
+ *
+ * @return true - data is being streamed to the file
+ */
+
+bool streaming_active(void)
+{
+    return stream_file != NULL;
+}
+
+
+/***
+ * @brief Poll the buffer index and append the data written before the previous poll
+ *        to the stream file. Called periodically in the persistent mode.
+ */
+
+void stream_new_data(void)
+{
+    if (stream_file == NULL)
+    {
+        return;
+    }
+
+    unsigned index;
+    int rez = read_buffer_index(&index);
+
+    if (rez == GDB_OK)
+    {
+        rez = append_segment(seen_index, index);
+        seen_index = index;
+    }
+
+    if (rez != GDB_OK)
+    {
+        printf("\nStreaming error - streaming stopped.");
+        stop_streaming();
+    }
+}
+
+
+/***
+ * @brief Append all data logged up to now to the stream file.
+ *        The function waits before reading the data to enable the firmware
+ *        to finish writing the messages.
+ */
+
+void stream_flush(void)
+{
+    if (stream_file == NULL)
+    {
+        return;
+    }
+
+    if (write_logged_data() != GDB_OK)
+    {
+        printf("\nStreaming error - streaming stopped.");
+        stop_streaming();
+    }
+}
+
+
+/***
+ * @brief Wait until the firmware finishes writing the messages and append
+ *        all data up to the current buffer index to the stream file.
+ *
+ * @return GDB_OK    - no error
+ *         GDB_ERROR - data not read or not written to the file
+ */
+
+static int write_logged_data(void)
+{
+    unsigned index;
+    int rez = read_buffer_index(&index);
+
+    if (rez == GDB_OK)
+    {
+        Sleep((parameters.delay > STREAM_COMPLETION_DELAY) ? parameters.delay : STREAM_COMPLETION_DELAY);
+        rez = append_segment(index, index);
+        seen_index = index;
+    }
+
+    return rez;
+}
+
+
+/***
+ * @brief Continue streaming from the current buffer index. Used after the data
+ *        transfer or a logging restart, which may reset the buffer index, and after
+ *        the logging mode change ('S' and 'P' keys). The header is read again and
+ *        the logging mode is updated. The streaming is stopped if the circular
+ *        buffer size has changed.
+ */
+
+void stream_resync(void)
+{
+    if (stream_file == NULL)
+    {
+        return;
+    }
+
+    rtedbg_header_t header;
+
+    if (!parameters.log_gdb_communication)
+    {
+        enable_logging(false);
+    }
+
+    int rez = gdb_read_memory((unsigned char*)&header, parameters.start_address, sizeof(header));
+    enable_logging(true);
+
+    if (rez != GDB_OK)
+    {
+        log_string("\nStreaming: could not read the g_rtedbg header.", NULL);
+        printf("\nStreaming error - streaming stopped.");
+        stop_streaming();
+        return;
+    }
+
+    if (header.buffer_size != buffer_words)
+    {
+        printf("\nThe circular buffer size has changed - streaming stopped.");
+        stop_streaming();
+        return;
+    }
+
+    set_logging_mode(header.rte_cfg);
+    stream_index = header.last_index;
+    seen_index = header.last_index;
+}
+
+
+/***
+ * @brief Load the g_rtedbg header, create the stream file and start streaming
+ *        from the current buffer index.
+ */
+
+static void start_streaming(void)
+{
+    if (parameters.stream_file_name == NULL)
+    {
+        printf("\nStream file not defined with the -stream=file_name argument.");
+        return;
+    }
+
+    if (gdb_read_memory((unsigned char*)&stream_header, parameters.start_address,
+            sizeof(stream_header)) != GDB_OK)
+    {
+        return;
+    }
+
+    buffer_words = stream_header.buffer_size;
+    if ((buffer_words < 4U) || (buffer_words > (MAX_BUFFER_SIZE / 4U)))
+    {
+        log_data("\nIncorrect circular buffer size in the g_rtedbg header: %llu words.",
+            (long long)buffer_words);
+        return;
+    }
+
+    set_logging_mode(stream_header.rte_cfg);
+
+    segment_buffer = (unsigned*)malloc(buffer_words * 4U);
+    if (segment_buffer == NULL)
+    {
+        log_string("\nCould not allocate memory buffer.", NULL);
+        return;
+    }
+
+    errno_t rez = fopen_s(&stream_file, parameters.stream_file_name, "wb");
+    if ((rez != 0) || (stream_file == NULL))
+    {
+        char err_string[256];
+        (void)strerror_s(err_string, sizeof(err_string), errno);
+        printf("\nCould not create file \"%s\": %s", parameters.stream_file_name, err_string);
+        stream_file = NULL;
+        free(segment_buffer);
+        segment_buffer = NULL;
+        return;
+    }
+
+    stream_index = stream_header.last_index;
+    seen_index = stream_header.last_index;
+    words_streamed = 0;
+    words_lost = 0;
+    start_timer(&stream_start_time);
+
+    if (write_stream_header() != GDB_OK)
+    {
+        stop_streaming();
+        return;
+    }
+
+    printf("\nStreaming to \"%s\" started. Press 'C' to stop.", parameters.stream_file_name);
+}
+
+
+/***
+ * @brief Write the remaining data, close the stream file and report the statistics.
+ */
+
+static void stop_streaming(void)
+{
+    if (stream_file == NULL)
+    {
+        return;
+    }
+
+    (void)write_logged_data();
+    (void)write_stream_header();
+    (void)fclose(stream_file);
+    stream_file = NULL;
+    free(segment_buffer);
+    segment_buffer = NULL;
+
+    double time_ms = time_elapsed(&stream_start_time);
+    printf("\nStreaming stopped: %u kB written in %.1f s (%.1f kB/s)",
+        words_streamed / 256U, time_ms / 1e3, (double)words_streamed * 4. / time_ms);
+
+    if (words_lost > 0)
+    {
+        printf(", %u kB lost - the circular buffer was overwritten before it could be read.",
+            words_lost / 256U);
+    }
+}
+
+
+/***
+ * @brief Read the current circular buffer index.
+ *        Only errors are logged because the index is polled frequently.
+ *
+ * @param index  Pointer to the variable for the index
+ *
+ * @return GDB_OK    - no error
+ *         GDB_ERROR - index not read
+ */
+
+static int read_buffer_index(unsigned* index)
+{
+    if (!parameters.log_gdb_communication)
+    {
+        enable_logging(false);
+    }
+
+    int rez = gdb_read_memory((unsigned char*)index, parameters.start_address, 4U);
+    enable_logging(true);
+
+    if (rez != GDB_OK)
+    {
+        log_string("\nStreaming: could not read the buffer index.", NULL);
+    }
+
+    return rez;
+}
+
+
+/***
+ * @brief Read the circular buffer data between the stream index and the end index
+ *        and append it to the stream file. The wrap-around at the end of the circular
+ *        buffer is handled for buffers with size of power of 2 (free running index)
+ *        and for other buffers (index restarts at zero).
+ *
+ * @param end_index      Buffer index up to which the data should be streamed
+ * @param current_index  Buffer index read last (used to detect the buffer overrun)
+ *
+ * @return GDB_OK    - no error
+ *         GDB_ERROR - data not read or not written to the file
+ */
+
+static int append_segment(unsigned end_index, unsigned current_index)
+{
+    unsigned start = stream_index;
+    unsigned end = end_index;
+    unsigned words;
+    unsigned position;
+
+    if (single_shot_mode)
+    {
+        // The index may exceed the buffer size when the buffer is full
+        if (start > buffer_words)
+        {
+            start = buffer_words;
+        }
+
+        if (end > buffer_words)
+        {
+            end = buffer_words;
+        }
+
+        words = (end >= start) ? (end - start) : 0;
+        position = start;
+    }
+    else if (buffer_size_power_of_2)
+    {
+        words = end - start;
+        position = start & (buffer_words - 1U);
+
+        if ((int)(end - start) < 0)
+        {
+            // The index has been reset (e.g. logging restarted by the firmware)
+            stream_index = end_index;
+            return GDB_OK;
+        }
+
+        if ((current_index - start) > buffer_words)
+        {
+            // The firmware has already overwritten (part of) the data
+            words_lost += words;
+            stream_index = end_index;
+            return GDB_OK;
+        }
+    }
+    else
+    {
+        if ((start >= buffer_words) || (end >= buffer_words))
+        {
+            // Index out of range - skip the data
+            words_lost += (end > start) ? (end - start) : 0;
+            stream_index = end_index;
+            return GDB_OK;
+        }
+
+        words = (end >= start) ? (end - start) : (buffer_words - start + end);
+        position = start;
+    }
+
+    if (words == 0)
+    {
+        stream_index = end_index;
+        return GDB_OK;
+    }
+
+    unsigned first_part = buffer_words - position;
+    if (first_part > words)
+    {
+        first_part = words;
+    }
+
+    if (!parameters.log_gdb_communication)
+    {
+        enable_logging(false);
+    }
+
+    const unsigned buffer_address = parameters.start_address + sizeof(rtedbg_header_t);
+    int rez = gdb_read_memory((unsigned char*)segment_buffer, buffer_address + 4U * position, 4U * first_part);
+
+    if ((rez == GDB_OK) && (words > first_part))
+    {
+        // Wrap-around - the rest of the data is at the start of the circular buffer
+        rez = gdb_read_memory((unsigned char*)&segment_buffer[first_part],
+            buffer_address, 4U * (words - first_part));
+    }
+
+    enable_logging(true);
+
+    if (rez != GDB_OK)
+    {
+        log_string("\nStreaming: could not read the circular buffer.", NULL);
+        return GDB_ERROR;
+    }
+
+    if (fwrite(segment_buffer, 4U, words, stream_file) != words)
+    {
+        log_string("\nCould not write to the file: %s.", parameters.stream_file_name);
+        return GDB_ERROR;
+    }
+
+    words_streamed += words;
+    stream_index = end_index;
+    return write_stream_header();
+}
+
+
+/***
+ * @brief Set the circular buffer index handling according to the RTEdbg configuration word.
+ *
+ * @param rte_cfg  Value of the rte_cfg field of the g_rtedbg header
+ */
+
+static void set_logging_mode(unsigned rte_cfg)
+{
+    buffer_size_power_of_2 = ((rte_cfg >> 31U) & 1U) != 0;
+    single_shot_mode = ((rte_cfg & 1U) != 0) && (((rte_cfg >> 3U) & 1U) != 0);
+}
+
+
+/***
+ * @brief Write the g_rtedbg header to the start of the stream file. The header
+ *        describes a single shot buffer containing all streamed words.
+ *
+ * @return GDB_OK    - no error
+ *         GDB_ERROR - header not written
+ */
+
+static int write_stream_header(void)
+{
+    rtedbg_header_t header = stream_header;
+    header.last_index = words_streamed;
+    header.buffer_size = words_streamed;
+    header.rte_cfg = (header.rte_cfg | 1U | (1U << 3U)) & ~(1U << 31U);
+        // Single shot logging, buffer size is not a power of 2
+
+    if (header.filter == 0)
+    {
+        header.filter = header.filter_copy;
+    }
+
+    if ((fseek(stream_file, 0, SEEK_SET) != 0)
+        || (fwrite(&header, sizeof(header), 1U, stream_file) != 1U)
+        || (fseek(stream_file, 0, SEEK_END) != 0)
+        || (fflush(stream_file) != 0))
+    {
+        log_string("\nCould not write to the file: %s.", parameters.stream_file_name);
+        return GDB_ERROR;
+    }
+
+    return GDB_OK;
+}
+
+/*==== End of file ====*/
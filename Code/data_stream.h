@@ -0,0 +1,21 @@
+/*
+ * Copyright (c) 2024 Branko Premzel.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * @file    data_stream.h
+ * @brief   Streaming of the logged data to a file without pausing the data logging.
+ * @author  B. Premzel
+ */
+
+#pragma once
+
+void start_stop_streaming(void);
+void stream_new_data(void);
+void stream_flush(void);
+void stream_resync(void);
+bool streaming_active(void);
+
+/*==== End of file ====*/
@@ -0,0 +1,403 @@
+/*
+ * Copyright (c) 2024 Branko Premzel.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * @file    file_writer.cpp
+ * @brief   Background thread for writing the snapshots to the binary file (-async argument).
+ * @author  B. Premzel
+ *
+ * The g_rtedbg structure snapshot is copied to the writer buffer and written to the
+ * binary file by a background thread. The message filter can therefore be restored
+ * right after the memory read - the data logging is not paused while the host disk
+ * is busy. The decode batch file is also started by the writer thread after the file
+ * has been written, so the next data transfer can start while the previous snapshot
+ * is still being decoded.
+ *
+ * The snapshots are double buffered. file_writer_submit() copies the snapshot to the
+ * staging buffer without waiting - it is called while the data logging is paused.
+ * file_writer_handover() is called after the message filter has been restored. It waits
+ * until the previous snapshot has been written and decoded (the same binary file is used
+ * for all snapshots) and swaps the staging buffer with the writer buffer.
+ * The snapshot is also appended to the -series file by the writer thread. The file write
+ * time is measured by the writer thread and added to the statistics of the main thread
+ * when the writer thread is idle again.
+ * Errors found by the writer thread are printed to the console (the log file functions
+ * are not thread safe) and reported to the main thread with file_writer_error().
+ */
+
+#include "pch.h"
+#include <stdlib.h>
+#include <string.h>
+#include <process.h>
+#include "gdb_lib.h"
+#include "RTEgdbData.h"
+#include "cmd_line.h"
+#include "logger.h"
+#include "file_writer.h"
+#include "snapshot_series.h"
+#include "transfer_stats.h"
+
+
+/*---------------- GLOBAL VARIABLES ------------------*/
+static HANDLE writer_thread = NULL;         // Writer thread (NULL - not started yet)
+static HANDLE work_event;                   // Auto-reset event - new job for the writer thread
+static HANDLE idle_event;                   // Manual-reset event - no job pending or in progress
+static CRITICAL_SECTION job_lock;           // Protects the job variables below
+static unsigned char* write_buffer = NULL;  // Copy of the snapshot written by the writer thread
+static unsigned write_buffer_size = 0;      // Size of the allocated buffer [bytes]
+static unsigned write_length;               // Number of bytes to write
+static unsigned char* staged_buffer = NULL; // Snapshot submitted but not handed over to the writer thread yet
+static unsigned staged_buffer_size = 0;     // Size of the allocated buffer [bytes]
+static unsigned staged_length = 0;          // Size of the staged snapshot (0 - no snapshot staged)
+static bool staged_report;                  // logging_to_file() of the thread that staged the snapshot
+static bool report_written;                 // true - print the "Data written" message to the console
+static bool write_timed = false;            // true - write_time_ms not added to the statistics yet
+static double write_time_ms;                // Time needed to write the last snapshot [ms]
+static const char* decode_batch_file;       // Batch file started after the file has been written
+static bool write_pending;                  // true - the snapshot must be written to the file
+static bool decode_pending;                 // true - the decode batch file must be started
+static bool stop_requested;                 // true - the writer thread must exit
+static volatile LONG write_failed = 0;      // 1 - the last snapshot could not be written
+static parameters_t writer_parameters;      // Copy of the (thread local) parameters for the writer thread
+
+
+/*---------------- Local functions ---------------*/
+static bool start_writer_thread(void);
+static unsigned __stdcall writer_thread_function(void* arg);
+static void write_snapshot_file(void);
+static void run_decode_batch_file(const char* batch_file);
+static void add_write_time(void);
+
+
+/***
+ * @brief Copy the snapshot to the staging buffer. The function does not wait for the writer
+ *        thread - it can be called while the data logging is paused. The snapshot is written
+ *        after file_writer_handover(). A snapshot that has not been handed over yet is replaced.
+ *
+ * @param data    Snapshot of the g_rtedbg structure
+ * @param length  Snapshot size [bytes]
+ *
+ * @return GDB_OK    - the snapshot will be written by the writer thread
+ *         GDB_ERROR - writer not available (the snapshot must be written by the caller)
+ */
+
+int file_writer_submit(const void* data, unsigned length)
+{
+    if ((writer_thread == NULL) && !start_writer_thread())
+    {
+        return GDB_ERROR;
+    }
+
+    if (length > staged_buffer_size)
+    {
+        unsigned char* new_buffer = (unsigned char*)realloc(staged_buffer, length);
+        if (new_buffer == NULL)
+        {
+            log_string("\nCould not allocate memory for the file writer - writing directly.", NULL);
+            return GDB_ERROR;
+        }
+
+        staged_buffer = new_buffer;
+        staged_buffer_size = length;
+    }
+
+    memcpy(staged_buffer, data, length);
+    staged_length = length;
+    staged_report = logging_to_file();     // The logger state is thread local
+    return GDB_OK;
+}
+
+
+/***
+ * @brief Hand over the staged snapshot to the writer thread. The function waits until the
+ *        previous snapshot has been written and decoded - it must be called after the
+ *        message filter has been restored.
+ */
+
+void file_writer_handover(void)
+{
+    if ((writer_thread == NULL) || (staged_length == 0))
+    {
+        return;
+    }
+
+    (void)WaitForSingleObject(idle_event, INFINITE);
+    add_write_time();
+
+    // The writer thread is idle - swap the staging and writer buffers
+    unsigned char* buffer = write_buffer;
+    unsigned size = write_buffer_size;
+    write_buffer = staged_buffer;
+    write_buffer_size = staged_buffer_size;
+    staged_buffer = buffer;
+    staged_buffer_size = size;
+
+    EnterCriticalSection(&job_lock);
+    write_length = staged_length;
+    report_written = staged_report;
+    write_pending = true;
+    (void)ResetEvent(idle_event);
+    LeaveCriticalSection(&job_lock);
+    staged_length = 0;
+    (void)SetEvent(work_event);
+}
+
+
+/***
+ * @brief Start the decode batch file after the last submitted snapshot has been written.
+ *
+ * @param batch_file  Name of the batch file
+ */
+
+void file_writer_decode(const char* batch_file)
+{
+    if (writer_thread == NULL)
+    {
+        return;         // No snapshot submitted
+    }
+
+    EnterCriticalSection(&job_lock);
+    decode_batch_file = batch_file;
+    decode_pending = true;
+    (void)ResetEvent(idle_event);
+    LeaveCriticalSection(&job_lock);
+    (void)SetEvent(work_event);
+}
+
+
+/***
+ * @brief Check if the writer thread could not write a snapshot since the last call.
+ *
+ * @return true - a snapshot has not been written to the file
+ */
+
+bool file_writer_error(void)
+{
+    return InterlockedExchange(&write_failed, 0) != 0;
+}
+
+
+/***
+ * @brief Wait until all snapshots have been written and decoded and stop the writer thread.
+ *
+ * @return GDB_OK    - no error
+ *         GDB_ERROR - the last snapshot could not be written
+ */
+
+int file_writer_stop(void)
+{
+    if (writer_thread == NULL)
+    {
+        return GDB_OK;
+    }
+
+    file_writer_handover();
+    EnterCriticalSection(&job_lock);
+    stop_requested = true;
+    LeaveCriticalSection(&job_lock);
+    (void)SetEvent(work_event);
+    (void)WaitForSingleObject(writer_thread, INFINITE);
+    add_write_time();
+
+    (void)CloseHandle(writer_thread);
+    (void)CloseHandle(work_event);
+    (void)CloseHandle(idle_event);
+    DeleteCriticalSection(&job_lock);
+    writer_thread = NULL;
+    free(write_buffer);
+    write_buffer = NULL;
+    write_buffer_size = 0;
+    free(staged_buffer);
+    staged_buffer = NULL;
+    staged_buffer_size = 0;
+    staged_length = 0;
+
+    return file_writer_error() ? GDB_ERROR : GDB_OK;
+}
+
+
+/***
+ * @brief Create the events and start the writer thread.
+ *
+ * @return true - writer thread started
+ */
+
+static bool start_writer_thread(void)
+{
+    InitializeCriticalSection(&job_lock);
+    write_pending = false;
+    decode_pending = false;
+    stop_requested = false;
+    work_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+    idle_event = CreateEvent(NULL, TRUE, TRUE, NULL);
+    writer_parameters = parameters;         // File names used by the writer thread
+
+    if ((work_event != NULL) && (idle_event != NULL))
+    {
+        writer_thread = (HANDLE)_beginthreadex(NULL, 0, writer_thread_function, NULL, 0, NULL);
+    }
+
+    if (writer_thread == NULL)
+    {
+        log_string("\nCould not start the file writer thread - writing directly.", NULL);
+
+        if (work_event != NULL)
+        {
+            (void)CloseHandle(work_event);
+        }
+
+        if (idle_event != NULL)
+        {
+            (void)CloseHandle(idle_event);
+        }
+
+        DeleteCriticalSection(&job_lock);
+        return false;
+    }
+
+    return true;
+}
+
+
+/***
+ * @brief Writer thread - write the submitted snapshots and start the decode batch file.
+ *        The pending jobs are finished before the thread exits.
+ *        The thread uses a copy of the parameters of the thread that started it.
+ *
+ * @param arg  Not used
+ *
+ * @return 0
+ */
+
+static unsigned __stdcall writer_thread_function(void* arg)
+{
+    (void)arg;
+    parameters = writer_parameters;
+
+    for (;;)
+    {
+        (void)WaitForSingleObject(work_event, INFINITE);
+
+        EnterCriticalSection(&job_lock);
+        bool write = write_pending;
+        bool decode = decode_pending;
+        bool stop = stop_requested;
+        const char* batch_file = decode_batch_file;
+        write_pending = false;
+        decode_pending = false;
+        LeaveCriticalSection(&job_lock);
+
+        if (write)
+        {
+            write_snapshot_file();
+        }
+
+        if (decode)
+        {
+            run_decode_batch_file(batch_file);
+        }
+
+        EnterCriticalSection(&job_lock);
+        if (!write_pending && !decode_pending)
+        {
+            (void)SetEvent(idle_event);
+        }
+        else
+        {
+            (void)SetEvent(work_event);     // A job was added meanwhile
+        }
+        LeaveCriticalSection(&job_lock);
+
+        if (stop)
+        {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+
+/***
+ * @brief Write the snapshot from the writer buffer to the binary file.
+ */
+
+static void write_snapshot_file(void)
+{
+    LARGE_INTEGER start_time;
+    start_timer(&start_time);
+    FILE* bin_file;
+    errno_t rez = fopen_s(&bin_file, parameters.bin_file_name, "wb");
+
+    if ((rez != 0) || (bin_file == NULL))
+    {
+        char err_string[256];
+        (void)strerror_s(err_string, sizeof(err_string), errno);
+        printf("\nCould not create file \"%s\": %s", parameters.bin_file_name, err_string);
+        (void)InterlockedExchange(&write_failed, 1);
+        return;
+    }
+
+    size_t written = fwrite(write_buffer, 1U, write_length, bin_file);
+
+    if ((fclose(bin_file) != 0) || (written != write_length))
+    {
+        char error_text[256];
+        (void)_strerror_s(error_text, sizeof(error_text), NULL);
+        printf("\nCould not write to the file: %s. Error: %s", parameters.bin_file_name, error_text);
+        (void)InterlockedExchange(&write_failed, 1);
+        return;
+    }
+
+    write_time_ms = time_elapsed(&start_time);
+    write_timed = true;
+
+    if (report_written)
+    {
+        printf("\nData written to \"%s\"\n", parameters.bin_file_name);
+    }
+
+    (void)series_append_snapshot(write_buffer, write_length);   // Errors are printed by the function
+}
+
+
+/***
+ * @brief Start the decode batch file and wait until it finishes.
+ *
+ * @param batch_file  Name of the batch file
+ */
+
+static void run_decode_batch_file(const char* batch_file)
+{
+    printf("\nStarting the batch file: %s", batch_file);
+    int rez = system(batch_file);
+
+    if (rez != 0)
+    {
+        printf("\nThe '%s' batch file could not be started!", batch_file);
+    }
+    else
+    {
+        printf("\n");
+    }
+}
+
+
+/***
+ * @brief Add the time of the last snapshot write to the statistics of the calling thread.
+ *        Must be called when the writer thread is idle or has exited.
+ */
+
+static void add_write_time(void)
+{
+    if (write_timed)
+    {
+        stats_add_time(SPAN_FILE_WRITE, write_time_ms);
+        write_timed = false;
+    }
+}
+
+/*==== End of file ====*/
@@ -0,0 +1,21 @@
+/*
+ * Copyright (c) 2024 Branko Premzel.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * @file    file_writer.h
+ * @brief   Background thread for writing the snapshots to the binary file (-async argument).
+ * @author  B. Premzel
+ */
+
+#pragma once
+
+int  file_writer_submit(const void* data, unsigned length);
+void file_writer_handover(void);
+void file_writer_decode(const char* batch_file);
+bool file_writer_error(void);
+int  file_writer_stop(void);
+
+/*==== End of file ====*/
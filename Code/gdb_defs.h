@@ -22,11 +22,30 @@
                                         // The send() function blocks only if no buffer space is available
                                         // within the transport system to hold the data to be transmitted.
 #define ERROR_DATA_TIMEOUT      50      // Max. time in ms to wait for a message following the 'O' type error message
+#define SOCKET_FLUSH_TIMEOUT     2      // Max. time in ms to wait for the remaining data when the socket is flushed
+#define CRC_TIMEOUT           5000      // Max. time in ms to wait for the reply to the qCRC request
+#define MONITOR_CMD_TIMEOUT   5000      // Max. time in ms to wait for the reply to a monitor command (e.g. memory fill)
+#define MAX_MONITOR_CMD_LENGTH 200      // Max. length of a monitor command sent with the 'qRcmd' packet
 
 #define DEFAULT_MESSAGE_SIZE  4096      // Default max. send message size (sent to the GDB server) if there is
                                         // no 'PacketSize' field in the capability data
 
-#define TCP_BUFF_LENGTH      65535      // The maximum TCP packet size including header
+#define TCP_BUFF_LENGTH      65535      // Initial size of the message buffers
+#define MAX_MESSAGE_BUFFER_SIZE (16U * 1024U * 1024U)
+                                        // Max. size of the message buffers - the buffers are enlarged
+                                        // if the GDB server supports packets larger than TCP_BUFF_LENGTH
+
+#define MAX_PIPELINE_DEPTH      16      // Max. number of memory read requests sent to the GDB server
+                                        // before the reply to the first one is received
+#define BATCH_PIPELINE_DEPTH     8      // Number of command file write commands sent before the first reply
+                                        // is received in the batch mode (if the -pipeline argument is not used)
+#define MAX_BATCH_FILE_SIZE (1024L * 1024L) // Max. size of a command file executed in the batch mode
+
+#define MIN_SOCKET_RCVBUF_KB     8      // Min. socket receive buffer size [kB] (-rcvbuf argument)
+#define MAX_SOCKET_RCVBUF_KB  8192      // Max. socket receive buffer size [kB]
+
+#define SERVER_CACHE_FILE "RTEgdbData_servers.txt"  // File with the GDB server capabilities (-fastconnect)
+#define SERVER_CACHE_MAX_ENTRIES 64U    // Max. number of GDB servers in the file
 
 
 /*----------------------------------------------------
@@ -42,12 +61,13 @@ enum error_codes {
     ERR_SOCKET,                     // Winsock error
     ERR_BAD_MSG_FORMAT,             // Bad message format
     ERR_BAD_MSG_CHECKSUM,           // Bad message checksum
-    ERR_RUN_LENGTH_ENCODING_NOT_IMPLEMENTED,
+    ERR_BAD_RUN_LENGTH_ENCODING,    // Bad run-length encoded data received
     ERR_CONNECTION_CLOSED,          // Socket has been closed
     ERR_BAD_INPUT_DATA,             // Bad function parameter
     ERR_MSG_NOT_SENT_COMPLETELY,    // The send() function could not send the complete message
     ERR_BAD_RESPONSE,               // Unknown/bad response from GDB
-    ERR_GDB_REPORTED_ERROR          // GDB server returned error message '$Exx#xx' or '$E.errtext#xx'
+    ERR_GDB_REPORTED_ERROR,         // GDB server returned error message '$Exx#xx' or '$E.errtext#xx'
+    ERR_OUT_OF_MEMORY               // Could not allocate the message buffers
 };
 
 #endif  //__GDB_DEFS_H
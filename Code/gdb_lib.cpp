@@ -27,6 +27,7 @@
  * - GDB Remote Serial Protocol: https://www.embecosm.com/appnotes/ean4/embecosm-howto-rsp-server-ean4-issue-2.pdf
  * - Winsock FAQ:                https://tangentsoft.net/wskfaq/general.html
  * - Winsock 2 API:              https://learn.microsoft.com/en-us/windows/win32/api/winsock2/nf-winsock2-send
+ * - WSAPoll:                    https://learn.microsoft.com/en-us/windows/win32/api/winsock2/nf-winsock2-wsapoll
  */
 
 #include "pch.h"
@@ -34,42 +35,141 @@
 #include <stdint.h>
 #include <string.h>
 #include <time.h>
+#include <mstcpip.h>
 #include "gdb_lib.h"
 #include "logger.h"
 #include "cmd_line.h"
 #include "RTEgdbData.h"
+#include "transfer_stats.h"
+#include "hex_codec.h"
+#include "rsp_frame.h"
 
 
  /*---------------- GLOBAL VARIABLES ------------------*/
-unsigned last_gdb_error;                        // Last GDB error reported
-char message_buffer[TCP_BUFF_LENGTH];           // Buffer for TCP message send/receive
+thread_local unsigned last_gdb_error;           // Last GDB error reported (by the session of the calling thread)
+thread_local clock_t app_start_time;            // Time of connection to GDB server
+static SRWLOCK gdb_lib_lock = SRWLOCK_INIT;     // Protects the Winsock initialization and the server cache file
+static bool winsock_initialized = false;        // true - WSAStartup() done (Winsock stays initialized until exit)
+static INIT_ONCE tables_init_once = INIT_ONCE_STATIC_INIT; // The shared tables are prepared once for all threads
+static unsigned crc_table[256];                 // Table for the gdb_crc32() calculation
 
-static SOCKET gdb_socket = INVALID_SOCKET;
-static unsigned data_received;                  // Number of bytes received in the buffer
-static bool ack_mode_enabled = false;           // If true, send message acknowledgments
-static unsigned max_memo_read_packet_size;      // Maximum read_memory_packet() size
-static unsigned max_memo_write_packet_size;     // Maximum write_memory_packet() size
-static unsigned max_gdb_send_message_size;      // Maximum size of message that can be sent to the GDB server
-static unsigned max_gdb_recv_message_size;      // Maximum size of message that can be received from the GDB server
-clock_t app_start_time;                         // Time of connection to GDB server
+
+// Capabilities of a GDB server found after the connection. They are reused when the connection
+// is restored and saved to the SERVER_CACHE_FILE with the -fastconnect argument.
+typedef struct
+{
+    char ip_address[40];            // GDB server IP address
+    unsigned port;                  // GDB server port number
+    unsigned identity;              // CRC of the capability data (0 - not valid)
+    unsigned binary_read;           // 0 - 'x' packet not supported, 1 - supported, 2 - supported with the 'b' prefix
+    unsigned binary_write;          // 1 - 'X' packet supported
+    unsigned fast_connect;          // 1 - capability and no-ACK mode requests can be sent back to back
+} server_capabilities_t;
 
 
 /*---------------- Local functions ---------------*/
-static int get_hex_digit(const char * ptr);
 static int gdb_get_message(size_t timeout);
-static int read_memory_packet(unsigned char* buffer, unsigned int address, unsigned int length);
+static BOOL CALLBACK init_shared_tables(PINIT_ONCE init_once, PVOID parameter, PVOID* context);
+static int receive_frame(size_t timeout, rsp_frame_t* frame);
+static int wait_for_data(long timeout);
+static void set_socket_options(void);
+static unsigned find_message_end(unsigned scan_start);
+static int send_read_request(unsigned int address, unsigned int length, bool binary);
+static int receive_read_reply(unsigned char* buffer, unsigned int length, bool binary, unsigned* bytes_read);
+static bool binary_read_error_reported(unsigned length);
+static int unescape_binary_data(const char* src, unsigned src_len,
+    unsigned char* dst, unsigned max_len, unsigned* decoded);
+static void probe_binary_read_support(void);
+static void discard_outstanding_replies(unsigned count);
+static void discard_pending_data(void);
 static int write_memory_packet(const unsigned char* buffer, unsigned address, unsigned length);
+static int write_binary_memory_packet(const unsigned char* buffer, unsigned address, unsigned length);
+static unsigned binary_write_packet_size(const unsigned char* buffer, unsigned length);
+static int check_write_reply(void);
+static void probe_binary_write_support(void);
 static int gdb_send_command(const char * command);
+static int format_packet(char* buffer, size_t size, const char* command);
+static int open_connection(unsigned short gdb_port);
+static int pipelined_negotiation(void);
+static bool skip_pending_ack(void);
+static bool get_known_capabilities(server_capabilities_t* known, unsigned short gdb_port);
+static void apply_known_capabilities(const server_capabilities_t* known);
+static void store_capabilities(const server_capabilities_t* known, bool known_found);
+static bool load_cached_capabilities(server_capabilities_t* entry);
+static void save_cached_capabilities(const server_capabilities_t* entry);
+static unsigned read_server_cache(server_capabilities_t* entries, unsigned max_count);
 static void gdb_send_ack(void);
 static void gdb_check_ack(void);
 static void calculate_max_message_sizes(void);
+static int resize_message_buffers(unsigned size);
 static void print_O_type_message(void);
 static void print_remaining_messages(void);
 static int gdb_send(const char* msg, int length);
 static bool gdb_error_reported(void);
 static void internal_command(const char* cmd_text);
+static void execute_command_lines(FILE* commands);
+static void execute_command_batch(FILE* commands);
+static char* read_command_file(FILE* commands, unsigned* line_count);
+static bool pipelined_command(const char* command);
+static int execute_pipelined_commands(const char* const* commands, unsigned count);
 static const char* get_core_content(char* message);
 static int parse_capability_data(const char* recvbuf);
+static void select_fill_backend(const char* recvbuf);
+static int server_side_fill(unsigned address, unsigned length, unsigned value);
+static int write_fill_pattern(unsigned address, unsigned length, unsigned value);
+static int openocd_fill(unsigned address, unsigned length, unsigned value);
+static bool fill_server_identified(void);
+static int monitor_command(const char* command, char* output, unsigned output_size);
+
+
+/*---------------- Memory fill backends ----------*/
+// Memory fill on the GDB server side (used to clear the circular buffer)
+typedef struct
+{
+    fill_mode_t mode;                                       // Value of the -fill argument
+    const char* name;                                       // Name of the GDB server type
+    int (*fill)(unsigned address, unsigned length, unsigned value); // Fill memory with a 32-bit value
+    const char* version_text;                               // Part of the 'monitor version' output (-fill=auto)
+} fill_backend_t;
+
+static const fill_backend_t fill_backends[] =
+{
+    { FILL_OPENOCD, "OpenOCD", openocd_fill, "Open On-Chip Debugger" },
+};
+
+
+/*---------------- GDB server session ------------*/
+// State of the connection to a GDB server. Each thread has its own session, so that
+// several GDB servers (targets) can be accessed in parallel from different threads.
+typedef struct
+{
+    SOCKET gdb_socket;                          // Socket connected to the GDB server
+    char* message_buffer;                       // Buffer for TCP message send/receive
+    unsigned data_received;                     // Number of bytes received in the buffer
+    unsigned message_buffer_size;               // Size of the message_buffer and pending_data buffers
+    char* pending_data;                         // Data received after the end of the last message
+    unsigned data_pending;                      // Number of bytes in the pending_data buffer
+    bool ack_mode_enabled;                      // If true, send message acknowledgments
+    unsigned max_memo_read_packet_size;         // Maximum hex encoded memory read packet size
+    unsigned max_memo_binary_read_packet_size;  // Maximum binary memory read packet size
+    bool binary_read_supported;                 // true - the GDB server supports the 'x' packet
+    bool binary_read_prefix;                    // true - binary data in the 'x' reply starts with 'b'
+    unsigned max_memo_write_packet_size;        // Maximum write_memory_packet() size
+    unsigned max_memo_binary_write_packet_size; // Maximum size of escaped data in the binary write packet
+    bool binary_write_supported;                // true - the GDB server supports the 'X' packet
+    unsigned max_gdb_send_message_size;         // Maximum size of message that can be sent to the GDB server
+    unsigned max_gdb_recv_message_size;         // Maximum size of message that can be received from the GDB server
+    unsigned server_identity;                   // CRC of the capability data - identifies the GDB server type and version
+    const fill_backend_t* fill_backend;         // Selected fill backend, NULL - use memory writes
+    bool fill_backend_verified;                 // true - the fill command has been verified
+    server_capabilities_t capabilities;         // Capabilities found at the last connection
+} gdb_session_t;
+
+static thread_local gdb_session_t session =
+{
+    INVALID_SOCKET, NULL, 0, 0, NULL, 0, false, 0, 0, false, false, 0, 0, false, 0, 0, 0, NULL, false,
+    { "", 0, 0, 0, 0, 0 }
+};
 
 
 /***
@@ -85,34 +185,105 @@ int gdb_connect(unsigned short gdb_port)
 {
     last_gdb_error = 0;
     app_start_time = clock_ms();
-    int res = gdb_connect_socket(gdb_port);
+
+    if (resize_message_buffers(TCP_BUFF_LENGTH) != GDB_OK)
+    {
+        return GDB_ERROR;
+    }
+
+    server_capabilities_t known;
+    bool known_found = get_known_capabilities(&known, gdb_port);
+
+    int res = open_connection(gdb_port);
     if (res != GDB_OK)
     {
-        gdb_socket_cleanup();
         return GDB_ERROR;
     }
 
-    ack_mode_enabled = true;
+    bool fast_connect = known_found && parameters.fast_connect && (known.fast_connect != 0);
 
-    // Check for initial acknowledgment from GDB server
-    res = recv(gdb_socket, message_buffer, sizeof(message_buffer), 0);
+    if (fast_connect && (pipelined_negotiation() != GDB_OK))
+    {
+        // Some GDB servers may not accept a request before the previous reply has been acknowledged
+        log_string("\nFast connect not successful - connecting again.", NULL);
+        fast_connect = false;
+        known.fast_connect = 0;
+        gdb_socket_cleanup();
+        last_gdb_error = 0;
+
+        if (open_connection(gdb_port) != GDB_OK)
+        {
+            return GDB_ERROR;
+        }
+    }
 
-    if (res > 0)    // Data received
+    if (!fast_connect)
     {
-        log_communication("Recv", message_buffer, res);
-        gdb_flush_socket();
+        res = gdb_check_server_capabilities();
+
+        if (res != GDB_OK)
+        {
+            gdb_socket_cleanup();
+            return GDB_ERROR;
+        }
+
+        res = gdb_request_no_ack_mode();
+
+        if (res != GDB_OK)
+        {
+            return res;
+        }
+    }
+
+    if (known_found && (known.identity == session.server_identity) && !parameters.hex_transfers)
+    {
+        apply_known_capabilities(&known);   // The same GDB server - the probes are not repeated
     }
+    else
+    {
+        probe_binary_read_support();
+        probe_binary_write_support();
+    }
+
+    store_capabilities(&known, known_found);
+    return GDB_OK;
+}
 
-    res = gdb_check_server_capabilities();
 
-    if (res != GDB_OK)
+/***
+ * @brief Connect the socket and discard the data sent by the GDB server after the connection
+ *        (e.g. the initial acknowledgment).
+ *
+ * @param gdb_port  GDB port number
+ *
+ * @return GDB_OK    - Connection successful
+ *         GDB_ERROR - Could not connect to the GDB server
+ */
+
+static int open_connection(unsigned short gdb_port)
+{
+    if (gdb_connect_socket(gdb_port) != GDB_OK)
     {
         gdb_socket_cleanup();
-        _fcloseall();
         return GDB_ERROR;
     }
 
-    return gdb_request_no_ack_mode();
+    session.ack_mode_enabled = true;
+    session.data_pending = 0;
+
+    // Check for initial acknowledgment from GDB server
+    if (wait_for_data(SOCKET_FLUSH_TIMEOUT) > 0)
+    {
+        int res = recv(session.gdb_socket, session.message_buffer, (int)session.message_buffer_size, 0);
+
+        if (res > 0)    // Data received
+        {
+            log_communication("Recv", session.message_buffer, res);
+            gdb_flush_socket();
+        }
+    }
+
+    return GDB_OK;
 }
 
 
@@ -135,8 +306,17 @@ int gdb_connect_socket(unsigned short gdb_port)
     start_timer(&StartingTime);
     log_string("Connecting to the GDB server: ", NULL);
 
-    // Initialize Winsock
-    res = WSAStartup(MAKEWORD(2, 2), &wsaData);
+    // Initialize Winsock - only once, it stays initialized for the reconnections and other sessions
+    AcquireSRWLockExclusive(&gdb_lib_lock);
+    res = NO_ERROR;
+
+    if (!winsock_initialized)
+    {
+        res = WSAStartup(MAKEWORD(2, 2), &wsaData);
+        winsock_initialized = (res == NO_ERROR);
+    }
+
+    ReleaseSRWLockExclusive(&gdb_lib_lock);
 
     if (res != NO_ERROR)
     {
@@ -147,12 +327,11 @@ int gdb_connect_socket(unsigned short gdb_port)
     // Create a SOCKET for connecting to server
     // SOCK_STREAM => calling recv will return as much data as is currently
     // available up to the size of the buffer specified
-    gdb_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    session.gdb_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
 
-    if (gdb_socket == INVALID_SOCKET)
+    if (session.gdb_socket == INVALID_SOCKET)
     {
         log_wsock_error("cannot create socket.\n");
-        (void)WSACleanup();
         return GDB_ERROR;
     }
 
@@ -164,8 +343,10 @@ int gdb_connect_socket(unsigned short gdb_port)
     // TODO: Replace inet_addr() with inet_pton() to support IPv4 and IPv6 addresses
     //       and make other necessary changes to make it work.
 
+    set_socket_options();
+
     // Connect to server
-    res = connect(gdb_socket, (SOCKADDR*)&clientService, sizeof(clientService));
+    res = connect(session.gdb_socket, (SOCKADDR*)&clientService, sizeof(clientService));
 
     if (res == SOCKET_ERROR)
     {
@@ -174,19 +355,80 @@ int gdb_connect_socket(unsigned short gdb_port)
         return GDB_ERROR;
     }
 
-    // Set receive timeout value for the gdb_socket.
-    DWORD timeout = 1;            // Minimal value to enable some kind of polling
-    (void)setsockopt(gdb_socket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
-
-    // Set send timeout value for the gdb_socket.
-    timeout = DEFAULT_SEND_TIMEOUT;
-    (void)setsockopt(gdb_socket, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
+    // Set send timeout value for the GDB socket.
+    // The receive functions do not use a socket timeout - they wait with wait_for_data().
+    DWORD timeout = DEFAULT_SEND_TIMEOUT;
+    (void)setsockopt(session.gdb_socket, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
 
     log_timing("OK (%.1f ms)", &StartingTime);
     return GDB_OK;
 }
 
 
+/***
+ * @brief Set the socket options that must be set before the connection is established.
+ *        Errors are not fatal - the default socket settings are used in such case.
+ */
+
+static void set_socket_options(void)
+{
+    // Disable the Nagle algorithm - the short requests are sent immediately
+    // and are not delayed until the previous data is acknowledged.
+    BOOL no_delay = TRUE;
+    (void)setsockopt(session.gdb_socket, IPPROTO_TCP, TCP_NODELAY, (const char*)&no_delay, sizeof(no_delay));
+
+    if (parameters.socket_rcvbuf_kb > 0)
+    {
+        int rcvbuf_size = (int)(parameters.socket_rcvbuf_kb * 1024U);
+        if (setsockopt(session.gdb_socket, SOL_SOCKET, SO_RCVBUF, (const char*)&rcvbuf_size, sizeof(rcvbuf_size))
+            == SOCKET_ERROR)
+        {
+            log_wsock_error("could not set the receive buffer size - ");
+        }
+    }
+
+    if (strncmp(parameters.ip_address, "127.", 4) == 0)
+    {
+        // The loopback fast path is used only if the GDB server enables it also.
+        // The request is ignored by Windows versions that do not support it.
+        int enabled = 1;
+        DWORD bytes_returned = 0;
+        (void)WSAIoctl(session.gdb_socket, SIO_LOOPBACK_FAST_PATH, &enabled, sizeof(enabled),
+            NULL, 0, &bytes_returned, NULL, NULL);
+    }
+}
+
+
+/***
+ * @brief Wait until data can be received from the GDB server or the timeout expires.
+ *        A closed connection is also reported as readable - recv() returns zero in such case.
+ * 
+ * @param timeout  Max. waiting time in ms (0 - check only, do not wait)
+ * 
+ * @return  1 - data can be received
+ *          0 - timeout
+ *         -1 - socket error
+ */
+
+static int wait_for_data(long timeout)
+{
+    WSAPOLLFD poll_fd;
+    poll_fd.fd = session.gdb_socket;
+    poll_fd.events = POLLRDNORM;
+    poll_fd.revents = 0;
+
+    int res = WSAPoll(&poll_fd, 1, (timeout > 0) ? (int)timeout : 0);
+
+    if (res == SOCKET_ERROR)
+    {
+        log_wsock_error(" - GDB Winsock poll error");
+        return -1;
+    }
+
+    return (res > 0) ? 1 : 0;
+}
+
+
 /***
  * @brief Send data to the GDB server using the TCP/IP protocol.
  *        Display error message if the data can not be sent.
@@ -207,7 +449,12 @@ static int gdb_send(const char* msg, int length)
         return GDB_ERROR;
     }
 
-    int res = send(gdb_socket, msg, length, 0);
+    LARGE_INTEGER span_start;
+    stats_span_start(&span_start);
+    int res = send(session.gdb_socket, msg, length, 0);
+    stats_span_end(SPAN_SEND, &span_start);
+    stats_count(COUNT_PACKETS_SENT, 1U);
+    stats_count(COUNT_BYTES_SENT, (unsigned)length);
     log_communication("Send", msg, length);
 
     if (res == SOCKET_ERROR)
@@ -247,40 +494,40 @@ static int gdb_send(const char* msg, int length)
 
 static bool gdb_error_reported(void)
 {
-    if (message_buffer[0] != '$')
+    if (session.message_buffer[0] != '$')
     {
         last_gdb_error = ERR_BAD_MSG_FORMAT;
-        log_string(" - bad message format - '$' not found: %.50s. ", message_buffer);
+        log_string(" - bad message format - '$' not found: %.50s. ", session.message_buffer);
         return true;
     }
 
-    if (message_buffer[1] != 'E')
+    if (session.message_buffer[1] != 'E')
     {
         return false;
     }
 
     last_gdb_error = ERR_GDB_REPORTED_ERROR;
 
-    if (message_buffer[4] == '#')
+    if (session.message_buffer[4] == '#')
     {
-        int res = sscanf_s(&message_buffer[2], "%x", &last_gdb_error);
+        int res = sscanf_s(&session.message_buffer[2], "%x", &last_gdb_error);
 
         if (res == 1)
         {
-            log_string(" - GDB server reported error %.3s. ", &message_buffer[1]);
+            log_string(" - GDB server reported error %.3s. ", &session.message_buffer[1]);
         }
         else
         {
-            log_string(" - bad response (%.50s). ", message_buffer);
+            log_string(" - bad response (%.50s). ", session.message_buffer);
         }
     }
-    else if ((message_buffer[1] == 'E') && (message_buffer[2] == '.'))
+    else if ((session.message_buffer[1] == 'E') && (session.message_buffer[2] == '.'))
     {
-        log_string(" - GDB error: %s", &message_buffer[3]);
+        log_string(" - GDB error: %s", &session.message_buffer[3]);
     }
     else
     {
-        log_string(" - Unknown error: %.50s ", message_buffer);
+        log_string(" - Unknown error: %.50s ", session.message_buffer);
     }
 
     return true;
@@ -288,111 +535,224 @@ static bool gdb_error_reported(void)
 
 
 /***
- * @brief Read memory packet from the embedded system memory.
- *        Maximal packet size depends on the GDB server type.
+ * @brief Send the memory read request to the GDB server - 'x' packet for binary
+ *        or 'm' packet for hex encoded data.
+ *        The reply is received separately with receive_read_reply().
  * 
- * @param buffer  Buffer to which the data should be written
  * @param address Address of data in the embedded system
  * @param length  Length of memory block [bytes]
+ * @param binary  true - binary data requested ('x' packet)
  * 
  * @return GDB_OK    - no error
- *         GDB_ERROR - could not read memory
+ *         GDB_ERROR - request could not be sent
  */
 
-static int read_memory_packet(unsigned char* buffer, unsigned int address, unsigned int length)
+static int send_read_request(unsigned int address, unsigned int length, bool binary)
 {
-    if (((length * 2 + 4) > TCP_BUFF_LENGTH) || (length == 0))
+    if (((length * (binary ? 1U : 2U) + 4) > session.message_buffer_size) || (length == 0))
     {
         last_gdb_error = ERR_BAD_INPUT_DATA;
         return GDB_ERROR;
     }
 
     // Prepare GDB command
-    sprintf_s(message_buffer, sizeof(message_buffer), "$m%08x,%02x", address, length);
+    char request[32];
+    sprintf_s(request, sizeof(request), "$%c%08x,%02x", binary ? 'x' : 'm', address, length);
     unsigned char sum = 0;
-    size_t buf_len = strlen(message_buffer);
+    size_t buf_len = strlen(request);
 
     // Calculate checksum
     for (size_t n = 1; n < buf_len; n++)
     {
-        sum += message_buffer[n];
+        sum += request[n];
     }
-    sprintf_s(&message_buffer[buf_len], 5, "#%02x", sum);       // Add checksum
+    sprintf_s(&request[buf_len], sizeof(request) - buf_len, "#%02x", sum);       // Add checksum
 
-    buf_len = strlen(message_buffer);
-    int res = gdb_send(message_buffer, (int)buf_len); // Send GDB command
-    if (res != GDB_OK)
+    buf_len = strlen(request);
+    return gdb_send(request, (int)buf_len); // Send GDB command
+}
+
+
+/***
+ * @brief Check if the reply to a binary memory read request is an error message.
+ *        Binary data without the 'b' prefix may also start with the 'E' character.
+ *        Such a reply is an error message only if it has the "Exx" format and
+ *        the data length does not match.
+ * 
+ * @param length  Length of memory block requested [bytes]
+ * 
+ * @return true  - error reported or bad message format
+ *         false - binary data received
+ */
+
+static bool binary_read_error_reported(unsigned length)
+{
+    if ((session.message_buffer[0] != '$') || !session.binary_read_prefix)
     {
-        return GDB_ERROR;
+        if ((session.message_buffer[0] == '$') && (session.message_buffer[1] == 'E')
+            && (session.data_received == 7U) && (length != 3U))
+        {
+            return gdb_error_reported();
+        }
+
+        return (session.message_buffer[0] != '$') ? gdb_error_reported() : false;
     }
 
-    res = gdb_get_message(0);               // Response (if OK) = "+$....hex_bytes...#xx"
-    if (res != GDB_OK)
+    if (session.message_buffer[1] == 'b')
     {
-        return GDB_ERROR;
+        return false;
     }
 
-    if (gdb_error_reported())
+    if (session.message_buffer[1] == 'E')
     {
-        return GDB_ERROR;
+        return gdb_error_reported();
     }
 
-    if (strchr(message_buffer, '*') != NULL)
+    log_string(" - bad response (%.50s). ", session.message_buffer);
+    last_gdb_error = ERR_BAD_RESPONSE;
+    return true;
+}
+
+
+/***
+ * @brief Decode the escaped binary data. The escape character '}' is followed by
+ *        the original byte XORed with 0x20.
+ * 
+ * @param src       Binary data received from the GDB server
+ * @param src_len   Number of received bytes
+ * @param dst       Buffer for the decoded data
+ * @param max_len   Size of the buffer for the decoded data
+ * @param decoded   Number of decoded bytes
+ * 
+ * @return GDB_OK    - no error
+ *         GDB_ERROR - more data received than requested or bad escape sequence
+ */
+
+static int unescape_binary_data(const char* src, unsigned src_len,
+    unsigned char* dst, unsigned max_len, unsigned* decoded)
+{
+    unsigned n = 0;
+
+    for (unsigned i = 0; i < src_len; i++)
     {
-        log_string("\nError run length encoding not implemented. ", NULL);
-        last_gdb_error = ERR_RUN_LENGTH_ENCODING_NOT_IMPLEMENTED;
-        return GDB_ERROR;
+        unsigned char data = (unsigned char)src[i];
+
+        if (data == '}')
+        {
+            if (++i >= src_len)
+            {
+                return GDB_ERROR;
+            }
+
+            data = (unsigned char)(src[i] ^ 0x20);
+        }
+
+        if (n >= max_len)
+        {
+            return GDB_ERROR;
+        }
+
+        dst[n++] = data;
     }
 
-    // Verify checksum
-    sum = 0;
-    unsigned int i;
+    *decoded = n;
+    return GDB_OK;
+}
+
+
+/***
+ * @brief Receive the reply to a memory read request and copy the data to the buffer.
+ *        The GDB server may return less data than requested.
+ *        The data is decoded to the buffer while the reply is being received. The buffer
+ *        contents are therefore not valid if the function returns an error.
+ * 
+ * @param buffer      Buffer to which the data should be written
+ * @param length      Length of memory block requested [bytes]
+ * @param binary      true - binary data requested ('x' packet)
+ * @param bytes_read  Number of bytes received
+ * 
+ * @return GDB_OK    - no error
+ *         GDB_ERROR - could not read memory
+ */
+
+static int receive_read_reply(unsigned char* buffer, unsigned int length, bool binary, unsigned* bytes_read)
+{
+    *bytes_read = 0;
+    rsp_frame_t frame;
+    rsp_frame_init(&frame, buffer, length, binary, session.binary_read_prefix);
 
-    for (i = 0; i < (length * 2); i++)
+    int res = receive_frame(0, &frame);         // Response (if OK) = "$....data...#xx"
+    if (res != GDB_OK)
     {
-        sum += message_buffer[i + 1];
+        return GDB_ERROR;
     }
 
-    if (message_buffer[i + 1] != '#')
+    if (binary ? binary_read_error_reported(length) : gdb_error_reported())
     {
-        log_string(" - bad message format - '#' not found: %.50s. ", &message_buffer[i+1]);
-        last_gdb_error = ERR_BAD_MSG_FORMAT;    // Checksum not found
         return GDB_ERROR;
     }
 
-    res = get_hex_digit(&message_buffer[i + 2]);
-
-    if ((res < 0) || (sum != res))
+    if (!frame.checksum_ok)
     {
         log_string(" - bad message checksum. ", NULL);
         last_gdb_error = ERR_BAD_MSG_CHECKSUM;
         return GDB_ERROR;
     }
 
-    // Convert the hex data to binary and copy it to the 'buffer'
-    for (i = 0; i < length; i++)
+    switch (frame.error)
     {
-        int temp = get_hex_digit(&message_buffer[2 * i + 1]);
+        case FRAME_OK:
+            break;
 
-        if (temp >= 0)
-        {
-            buffer[i] = (unsigned char)temp;
-        }
-        else
-        {
-            log_string(" - bad message format. ", NULL);
+        case FRAME_BAD_RUN_LENGTH_ENCODING:
+            log_string(" - bad run-length encoding. ", NULL);
+            last_gdb_error = ERR_BAD_RUN_LENGTH_ENCODING;
+            return GDB_ERROR;
+
+        default:
+            log_string(binary ? " - bad binary data format. " : " - bad message format. ", NULL);
             last_gdb_error = ERR_BAD_MSG_FORMAT;
             return GDB_ERROR;
+    }
+
+    *bytes_read = frame.decoded;
+    return GDB_OK;
+}
+
+
+/***
+ * @brief Receive and discard replies to requests that have already been sent.
+ *        Used after an error in the pipelined read to resynchronize with the GDB server.
+ * 
+ * @param count  Number of replies still expected from the GDB server
+ */
+
+static void discard_outstanding_replies(unsigned count)
+{
+    unsigned error = last_gdb_error;    // Keep the error that terminated the transfer
+
+    while (count-- > 0)
+    {
+        if (gdb_get_message(0) != GDB_OK)
+        {
+            break;
         }
     }
 
-    return GDB_OK;      // Received the requested number of data
+    discard_pending_data();
+    gdb_flush_socket();
+    last_gdb_error = error;
 }
 
 
 /***
  * @brief Read memory block from the embedded system memory.
  *        Maximum size depends on the maximum memory read packet size.
+ *        Binary read requests are used if the GDB server supports them.
+ *        Up to parameters.pipeline_depth read requests are sent to the GDB server before
+ *        the first reply is received if the no-ACK mode is active. The replies arrive
+ *        in the same order as the requests were sent. If the GDB server returns less
+ *        data than requested, the rest is requested again.
  *
  * @param buffer  Pointer to the buffer where the read data will be stored
  * @param address Starting address in the embedded system memory to read from
@@ -403,6 +763,26 @@ static int read_memory_packet(unsigned char* buffer, unsigned int address, unsig
  */
 
 int gdb_read_memory(unsigned char* buffer, unsigned int address, unsigned int length)
+{
+    return gdb_read_memory_pipelined(buffer, address, length, parameters.pipeline_depth);
+}
+
+
+/***
+ * @brief Read memory block from the embedded system memory with the defined pipeline depth
+ *        instead of the -pipeline argument value (e.g. for a reference measurement).
+ *
+ * @param buffer          Pointer to the buffer where the read data will be stored
+ * @param address         Starting address in the embedded system memory to read from
+ * @param length          Number of bytes to read
+ * @param pipeline_depth  Max. number of read requests sent before the first reply is received
+ *
+ * @return GDB_OK    - Operation successful
+ *         GDB_ERROR - Error occurred (check last_gdb_error for details)
+ */
+
+int gdb_read_memory_pipelined(unsigned char* buffer, unsigned int address, unsigned int length,
+        unsigned pipeline_depth)
 {
     last_gdb_error = 0;
 
@@ -412,34 +792,117 @@ int gdb_read_memory(unsigned char* buffer, unsigned int address, unsigned int le
         return GDB_ERROR;
     }
 
+    unsigned data_requested = 0;
     unsigned data_read = 0;
-    int res;
+    unsigned outstanding = 0;                   // Number of requests without reply
+    unsigned packet_offsets[MAX_PIPELINE_DEPTH];// Offsets of outstanding requests (circular queue)
+    unsigned packet_sizes[MAX_PIPELINE_DEPTH];  // Sizes of outstanding requests (circular queue)
+    unsigned first_packet = 0;                  // Queue index of the oldest outstanding request
+    unsigned retry_offset = 0;                  // Start of the data missing from a short reply
+    unsigned retry_size = 0;                    // Size of the data missing from a short reply
+    int res = GDB_OK;
     LARGE_INTEGER StartingTime;
 
+    const bool binary = session.binary_read_supported;
+    const unsigned max_packet_size =
+        binary ? session.max_memo_binary_read_packet_size : session.max_memo_read_packet_size;
+
+    if (session.ack_mode_enabled || (pipeline_depth < 1U))
+    {
+        pipeline_depth = 1U;    // Replies must be acknowledged one by one
+    }
+    else if (pipeline_depth > MAX_PIPELINE_DEPTH)
+    {
+        pipeline_depth = MAX_PIPELINE_DEPTH;
+    }
+
     log_data("\nReading %llu bytes ", (long long)length);
     log_data("from address 0x%08llX ", (long long)address);
     start_timer(&StartingTime);
 
     do
     {
-        unsigned packet_size = length - data_read;
+        // Keep up to 'pipeline_depth' requests in flight
+        while ((outstanding < pipeline_depth) && ((data_requested < length) || (retry_size > 0)))
+        {
+            unsigned packet_offset;
+            unsigned packet_size;
+
+            if (retry_size > 0)
+            {
+                packet_offset = retry_offset;
+                packet_size = retry_size;
+                retry_size = 0;
+            }
+            else
+            {
+                packet_offset = data_requested;
+                packet_size = length - data_requested;
+
+                if (packet_size > max_packet_size)
+                {
+                    packet_size = max_packet_size;
+                }
+
+                data_requested += packet_size;
+            }
+
+            res = send_read_request(address + packet_offset, packet_size, binary);
+
+            if (res != GDB_OK)
+            {
+                break;
+            }
+
+            unsigned index = (first_packet + outstanding) % MAX_PIPELINE_DEPTH;
+            packet_offsets[index] = packet_offset;
+            packet_sizes[index] = packet_size;
+            outstanding++;
+        }
 
-        if (packet_size > max_memo_read_packet_size)
+        if (res != GDB_OK)
         {
-            packet_size = max_memo_read_packet_size;
+            break;
         }
 
-        res = read_memory_packet(buffer + data_read, address + data_read, packet_size);
+        // Receive the reply to the oldest request
+        unsigned packet_offset = packet_offsets[first_packet];
+        unsigned packet_size = packet_sizes[first_packet];
+        unsigned bytes_read;
+        res = receive_read_reply(buffer + packet_offset, packet_size, binary, &bytes_read);
+        outstanding--;
 
         if (res != GDB_OK)
         {
             break;
         }
 
-        data_read += packet_size;
+        if (bytes_read == 0)
+        {
+            log_string(" - no data received. ", NULL);
+            last_gdb_error = ERR_BAD_RESPONSE;
+            res = GDB_ERROR;
+            break;
+        }
+
+        if (bytes_read < packet_size)
+        {
+            // Request the rest of the data with the next request
+            retry_offset = packet_offset + bytes_read;
+            retry_size = packet_size - bytes_read;
+            stats_count(COUNT_RETRIES, 1U);
+        }
+
+        first_packet = (first_packet + 1U) % MAX_PIPELINE_DEPTH;
+        data_read += bytes_read;
     }
     while (data_read < length);
 
+    if ((res != GDB_OK) && (outstanding > 0))
+    {
+        discard_outstanding_replies(outstanding);
+    }
+
     log_timing(" (%.1f ms)", &StartingTime);
 
     return res;
@@ -449,6 +912,7 @@ int gdb_read_memory(unsigned char* buffer, unsigned int address, unsigned int le
 /***
  * @brief Write the contents of a memory block to the memory in the embedded CPU.
  *        Maximum size depends on the maximum memory write packet size.
+ *        Binary write requests are used if the GDB server supports them.
  * 
  * @param buffer  Pointer to the data that should be written to the specified address
  * @param address Starting address in the embedded system's memory to write to
@@ -480,12 +944,20 @@ int gdb_write_memory(const unsigned char* buffer, unsigned address, unsigned len
     {
         unsigned packet_size = length - data_written;
 
-        if (packet_size > max_memo_write_packet_size)
+        if (session.binary_write_supported)
         {
-            packet_size = max_memo_write_packet_size;
+            packet_size = binary_write_packet_size(buffer + data_written, packet_size);
+            res = write_binary_memory_packet(buffer + data_written, address + data_written, packet_size);
         }
+        else
+        {
+            if (packet_size > session.max_memo_write_packet_size)
+            {
+                packet_size = session.max_memo_write_packet_size;
+            }
 
-        res = write_memory_packet(buffer + data_written, address + data_written, packet_size);
+            res = write_memory_packet(buffer + data_written, address + data_written, packet_size);
+        }
 
         if (res != GDB_OK)
         {
@@ -503,58 +975,564 @@ int gdb_write_memory(const unsigned char* buffer, unsigned address, unsigned len
 
 
 /***
- * @brief Write the contents of a memory packet to the memory in the embedded CPU.
- *        Maximal packet size depends on the GDB server type.
+ * @brief Fill a block of the embedded system memory with a 32-bit value.
+ *        The fill command of the GDB server is used if a fill backend has been selected
+ *        for the GDB server. Memory write packets are used if the fill command is not
+ *        available or does not work (the backend is not used again in that case).
  * 
- * @param buffer  Pointer to the data that should be written to the specified address
- * @param address Address of data in the embedded system
- * @param length  Length of memory block in bytes
+ * @param address Starting address in the embedded system's memory (word aligned)
+ * @param length  Number of bytes to fill (divisible by 4)
+ * @param value   Value written to each 32-bit word
  *
  * @return GDB_OK    - Operation successful
- *         GDB_ERROR - Data not written (check last_gdb_error for details)
+ *         GDB_ERROR - Error occurred (check last_gdb_error for details)
  */
 
-static int write_memory_packet(const unsigned char * buffer, unsigned address, unsigned length)
+int gdb_fill_memory(unsigned address, unsigned length, unsigned value)
 {
-    if (((length * 2 + 16 + 4) > TCP_BUFF_LENGTH) || (length == 0))
+    if ((length == 0) || ((length & 3U) != 0) || ((address & 3U) != 0))
     {
         last_gdb_error = ERR_BAD_INPUT_DATA;
         return GDB_ERROR;
     }
 
-    sprintf_s(message_buffer, sizeof(message_buffer), "$M%08X,%04X:", address, length);
-    char * position = &message_buffer[16];
-
-    for (unsigned i = 0; i < length; i++)
+    if ((session.fill_backend != NULL) && !session.fill_backend_verified
+        && (parameters.fill_mode == FILL_AUTO) && !fill_server_identified())
     {
-        sprintf_s(position, (size_t)(&message_buffer[TCP_BUFF_LENGTH] - position),
-            "%02X", *buffer++);
-        position += 2;
+        log_string("\nThe GDB server is not %s - using memory writes. ", session.fill_backend->name);
+        session.fill_backend = NULL;
+        last_gdb_error = 0;
+        gdb_flush_socket();
     }
 
-    const unsigned data_size = 15 + 2 * length;
-    unsigned char sum = 0;
-    position = &message_buffer[1];
-
-    for (unsigned i = 0; i < data_size; i++)
+    if (session.fill_backend != NULL)
     {
-        sum += *position++;
-    }
+        if (server_side_fill(address, length, value) == GDB_OK)
+        {
+            return GDB_OK;
+        }
+
+        log_string("\nMemory fill with the %s command failed - using memory writes. ", session.fill_backend->name);
+        session.fill_backend = NULL;
+        last_gdb_error = 0;
+        gdb_flush_socket();
+    }
+
+    return write_fill_pattern(address, length, value);
+}
+
+
+/***
+ * @brief Fill the memory with the selected backend and check the first and last word. 
+ *        A word with a different value is written before the first fill so that the
+ *        verification also detects a fill command that is accepted but does nothing.
+ * 
+ * @param address Starting address in the embedded system's memory
+ * @param length  Number of bytes to fill
+ * @param value   Value written to each 32-bit word
+ *
+ * @return GDB_OK    - memory filled
+ *         GDB_ERROR - fill command failed or the memory contents are not correct
+ */
+
+static int server_side_fill(unsigned address, unsigned length, unsigned value)
+{
+    const unsigned last_word_address = address + length - 4U;
+
+    if (!session.fill_backend_verified)
+    {
+        unsigned marker = ~value;
+        if (gdb_write_memory((const unsigned char*)&marker, last_word_address, 4U) != GDB_OK)
+        {
+            return GDB_ERROR;
+        }
+    }
+
+    if (session.fill_backend->fill(address, length, value) != GDB_OK)
+    {
+        return GDB_ERROR;
+    }
+
+    unsigned first_word = ~value;
+    unsigned last_word = ~value;
+
+    if ((gdb_read_memory((unsigned char*)&first_word, address, 4U) != GDB_OK)
+        || (gdb_read_memory((unsigned char*)&last_word, last_word_address, 4U) != GDB_OK))
+    {
+        return GDB_ERROR;
+    }
+
+    if ((first_word != value) || (last_word != value))
+    {
+        log_string(" - memory fill verification failed. ", NULL);
+        last_gdb_error = ERR_BAD_RESPONSE;
+        return GDB_ERROR;
+    }
+
+    session.fill_backend_verified = true;
+    return GDB_OK;
+}
+
+
+/***
+ * @brief Check with the 'monitor version' command that the GDB server type detected from
+ *        the capability data (-fill=auto) is really the one of the selected fill backend.
+ *        Other GDB servers (e.g. pyOCD or Black Magic Probe) report the same capabilities.
+ *        The check is done only before the first fill of the session - the fill backend
+ *        is verified or removed by the first fill.
+ *
+ * @return true - the version text of the fill backend found in the command output
+ */
+
+static bool fill_server_identified(void)
+{
+    char output[256];
+
+    if (monitor_command("version", output, sizeof(output)) != GDB_OK)
+    {
+        return false;
+    }
+
+    return strstr(output, session.fill_backend->version_text) != NULL;
+}
+
+
+/***
+ * @brief Fill the memory with a 32-bit value using memory write packets.
+ * 
+ * @param address Starting address in the embedded system's memory
+ * @param length  Number of bytes to fill
+ * @param value   Value written to each 32-bit word
+ *
+ * @return GDB_OK    - Operation successful
+ *         GDB_ERROR - Error occurred
+ */
+
+static int write_fill_pattern(unsigned address, unsigned length, unsigned value)
+{
+    unsigned* pattern = (unsigned*)malloc(length);
+    if (pattern == NULL)
+    {
+        log_string("\nCould not allocate memory buffer.", NULL);
+        last_gdb_error = ERR_BAD_INPUT_DATA;
+        return GDB_ERROR;
+    }
+
+    for (unsigned i = 0; i < length / 4U; i++)
+    {
+        pattern[i] = value;
+    }
+
+    int res = gdb_write_memory((const unsigned char*)pattern, address, length);
+    free(pattern);
+    return res;
+}
+
+
+/***
+ * @brief Fill the memory with the OpenOCD 'mww address value count' command.
+ * 
+ * @param address Starting address in the embedded system's memory
+ * @param length  Number of bytes to fill
+ * @param value   Value written to each 32-bit word
+ *
+ * @return GDB_OK    - command executed
+ *         GDB_ERROR - command failed
+ */
+
+static int openocd_fill(unsigned address, unsigned length, unsigned value)
+{
+    char command[64];
+    sprintf_s(command, sizeof(command), "mww 0x%08X 0x%08X %u", address, value, length / 4U);
+    return gdb_monitor_command(command);
+}
+
+
+/***
+ * @brief Send a monitor command to the GDB server with the 'qRcmd' packet.
+ *        The command text is hex encoded. The console output of the command
+ *        ('O' type messages) is written to the log file.
+ * 
+ * @param command  Monitor command text (e.g. "reset halt")
+ * 
+ * @return GDB_OK    - command executed
+ *         GDB_ERROR - command could not be executed or is not supported
+ */
+
+int gdb_monitor_command(const char * command)
+{
+    return monitor_command(command, NULL, 0);
+}
+
+
+/***
+ * @brief Send a monitor command to the GDB server and collect its console output.
+ * 
+ * @param command      Monitor command text
+ * @param output       Buffer for the console output of the command (NULL - not needed)
+ * @param output_size  Size of the output buffer
+ * 
+ * @return GDB_OK    - command executed
+ *         GDB_ERROR - command could not be executed or is not supported
+ */
+
+static int monitor_command(const char* command, char* output, unsigned output_size)
+{
+    last_gdb_error = 0;
+
+    if (output != NULL)
+    {
+        *output = '\0';
+    }
+
+    log_string("\n   monitor \"%s\": ", command);
+    LARGE_INTEGER StartingTime;
+    start_timer(&StartingTime);
+
+    size_t len = strlen(command);
+    if (len > MAX_MONITOR_CMD_LENGTH)
+    {
+        log_data(" monitor command too long (%llu) ", (long long)len);
+        last_gdb_error = ERR_BAD_INPUT_DATA;
+        return GDB_ERROR;
+    }
+
+    char request[sizeof("qRcmd,") + 2U * MAX_MONITOR_CMD_LENGTH];
+    memcpy(request, "qRcmd,", sizeof("qRcmd,") - 1U);
+    char* hex_text = &request[sizeof("qRcmd,") - 1U];
+    (void)bin_to_hex((const unsigned char*)command, hex_text, (unsigned)len);
+    hex_text[2U * len] = '\0';
+
+    if (gdb_send_command(request) != GDB_OK)
+    {
+        return GDB_ERROR;
+    }
+
+    for (;;)
+    {
+        if (gdb_get_message(MONITOR_CMD_TIMEOUT) != GDB_OK)
+        {
+            return GDB_ERROR;
+        }
+
+        if (strncmp(session.message_buffer, "$OK#", 4) == 0)
+        {
+            break;
+        }
+
+        if (gdb_error_reported())
+        {
+            return GDB_ERROR;
+        }
+
+        if ((strncmp(session.message_buffer, "$O", 2) == 0) && (session.message_buffer[2] != '#'))
+        {
+            print_O_type_message();     // Console output of the command
+
+            if (output != NULL)
+            {
+                // The decoded text replaces the hex string after "$O"
+                (void)strncat_s(output, output_size, &session.message_buffer[2], _TRUNCATE);
+            }
+            continue;
+        }
+
+        const char* text = get_core_content(session.message_buffer);
+        log_string("\"%s\"", *text == '\0' ? "unsupported command" : text);
+        last_gdb_error = ERR_BAD_RESPONSE;
+        return GDB_ERROR;
+    }
+
+    log_timing("OK (%.1f ms)", &StartingTime);
+    return GDB_OK;
+}
+
+
+/***
+ * @brief Let the GDB server calculate the CRC of a memory block ('qCRC' packet).
+ *        The reply is "Cxxxxxxxx" where xxxxxxxx is the CRC. The CRC is calculated
+ *        in the same way as with gdb_crc32().
+ * 
+ * @param address Starting address in the embedded system's memory
+ * @param length  Number of bytes
+ * @param crc     Pointer to the variable for the CRC value
+ *
+ * @return GDB_OK    - CRC received
+ *         GDB_ERROR - qCRC not supported or communication error
+ */
+
+int gdb_memory_crc(unsigned address, unsigned length, unsigned * crc)
+{
+    last_gdb_error = 0;
+    char command[40];
+    sprintf_s(command, sizeof(command), "qCRC:%x,%x", address, length);
+
+    if (gdb_send_command(command) != GDB_OK)
+    {
+        return GDB_ERROR;
+    }
+
+    if (gdb_get_message(CRC_TIMEOUT) != GDB_OK)
+    {
+        return GDB_ERROR;
+    }
+
+    if (gdb_error_reported())
+    {
+        return GDB_ERROR;
+    }
+
+    if ((session.message_buffer[1] != 'C') || (sscanf_s(&session.message_buffer[2], "%8x", crc) != 1))
+    {
+        const char* text = get_core_content(session.message_buffer);
+        log_string(" - qCRC reply: \"%s\". ", *text == '\0' ? "unsupported command" : text);
+        last_gdb_error = ERR_BAD_RESPONSE;
+        return GDB_ERROR;
+    }
+
+    return GDB_OK;
+}
+
+
+/***
+ * @brief Calculate the CRC of a data block in the same way as the GDB server
+ *        does for the 'qCRC' packet (CRC-32, polynomial 0x04C11DB7, initial value
+ *        0xFFFFFFFF, not reflected, no final XOR).
+ * 
+ * @param data    Pointer to the data
+ * @param length  Number of bytes
+ *
+ * @return CRC value
+ */
+
+unsigned gdb_crc32(const unsigned char * data, unsigned length)
+{
+    unsigned crc = 0xFFFFFFFFU;
+
+    for (unsigned i = 0; i < length; i++)
+    {
+        crc = (crc << 8U) ^ crc_table[((crc >> 24U) ^ data[i]) & 0xFFU];
+    }
+
+    return crc;
+}
+
+
+/***
+ * @brief Prepare the tables shared by all GDB sessions (hex codec kernels and the CRC table).
+ *        Must be called before any data transfer thread is started - from main() or
+ *        rtegdb_connect(). Concurrent calls wait until the tables are ready.
+ */
+
+void gdb_lib_init(void)
+{
+    (void)InitOnceExecuteOnce(&tables_init_once, init_shared_tables, NULL, NULL);
+}
+
+
+/***
+ * @brief Prepare the shared tables - executed only once (see gdb_lib_init()).
+ *
+ * @param init_once  Not used
+ * @param parameter  Not used
+ * @param context    Not used
+ *
+ * @return TRUE - initialization done
+ */
+
+static BOOL CALLBACK init_shared_tables(PINIT_ONCE init_once, PVOID parameter, PVOID* context)
+{
+    (void)init_once;
+    (void)parameter;
+    (void)context;
+    hex_codec_init();
+
+    for (unsigned i = 0; i < 256U; i++)
+    {
+        unsigned c = i << 24U;
+
+        for (unsigned bit = 0; bit < 8U; bit++)
+        {
+            c = (c & 0x80000000U) ? ((c << 1U) ^ 0x04C11DB7U) : (c << 1U);
+        }
+
+        crc_table[i] = c;
+    }
+
+    return TRUE;
+}
+
+
+/***
+ * @brief Check if a byte must be escaped in the binary data sent to the GDB server.
+ * 
+ * @param data  Data byte
+ * 
+ * @return true if the byte must be escaped
+ */
+
+static inline bool binary_escape_needed(unsigned char data)
+{
+    return (data == '$') || (data == '#') || (data == '}') || (data == '*');
+}
+
+
+/***
+ * @brief Calculate how many bytes fit into a binary memory write packet.
+ *        Escaped bytes take two characters in the packet. The number of bytes is
+ *        made divisible by 4 if possible because some debug probes transfer data
+ *        more slowly when it is not.
+ * 
+ * @param buffer  Pointer to the data that should be written
+ * @param length  Number of bytes still to be written
+ * 
+ * @return Number of bytes for the next packet
+ */
+
+static unsigned binary_write_packet_size(const unsigned char* buffer, unsigned length)
+{
+    unsigned encoded_size = 0;
+    unsigned i;
+
+    for (i = 0; i < length; i++)
+    {
+        unsigned size = binary_escape_needed(buffer[i]) ? 2U : 1U;
+
+        if ((encoded_size + size) > session.max_memo_binary_write_packet_size)
+        {
+            break;
+        }
+
+        encoded_size += size;
+    }
+
+    if ((i < length) && (i > 4U))
+    {
+        i &= ~3U;
+    }
+
+    return i;
+}
+
+
+/***
+ * @brief Write the contents of a memory packet to the memory in the embedded CPU
+ *        using the binary 'X' packet.
+ *        Maximal packet size depends on the GDB server type.
+ * 
+ * @param buffer  Pointer to the data that should be written to the specified address
+ * @param address Address of data in the embedded system
+ * @param length  Length of memory block in bytes (see binary_write_packet_size())
+ *
+ * @return GDB_OK    - Operation successful
+ *         GDB_ERROR - Data not written (check last_gdb_error for details)
+ */
+
+static int write_binary_memory_packet(const unsigned char* buffer, unsigned address, unsigned length)
+{
+    if (((length + 20 + 4) > session.message_buffer_size) || (length == 0))
+    {
+        last_gdb_error = ERR_BAD_INPUT_DATA;
+        return GDB_ERROR;
+    }
+
+    int header_size = sprintf_s(session.message_buffer, session.message_buffer_size, "$X%08X,%04X:", address, length);
+    char* position = &session.message_buffer[header_size];
+    unsigned char sum = 0;
+
+    for (int i = 1; i < header_size; i++)
+    {
+        sum += session.message_buffer[i];
+    }
 
-    sprintf_s(position, (size_t)(&message_buffer[TCP_BUFF_LENGTH] - position), "#%02X", sum);
+    for (unsigned i = 0; i < length; i++)
+    {
+        unsigned char data = *buffer++;
+
+        if (binary_escape_needed(data))
+        {
+            *position++ = '}';
+            sum += '}';
+            data ^= 0x20U;
+        }
+
+        *position++ = (char)data;
+        sum += data;
+
+        if ((position + 4) >= &session.message_buffer[session.message_buffer_size])
+        {
+            last_gdb_error = ERR_BAD_INPUT_DATA;
+            return GDB_ERROR;
+        }
+    }
+
+    sprintf_s(position, (size_t)(&session.message_buffer[session.message_buffer_size] - position), "#%02X", sum);
+
+    unsigned msg_len = (unsigned)(position + 3 - session.message_buffer);
+    if (gdb_send(session.message_buffer, msg_len) != GDB_OK)
+    {
+        return GDB_ERROR;
+    }
+
+    return check_write_reply();
+}
+
+
+/***
+ * @brief Write the contents of a memory packet to the memory in the embedded CPU.
+ *        Maximal packet size depends on the GDB server type.
+ * 
+ * @param buffer  Pointer to the data that should be written to the specified address
+ * @param address Address of data in the embedded system
+ * @param length  Length of memory block in bytes
+ *
+ * @return GDB_OK    - Operation successful
+ *         GDB_ERROR - Data not written (check last_gdb_error for details)
+ */
+
+static int write_memory_packet(const unsigned char * buffer, unsigned address, unsigned length)
+{
+    if (((length * 2 + 20 + 4) > session.message_buffer_size) || (length == 0))
+    {
+        last_gdb_error = ERR_BAD_INPUT_DATA;
+        return GDB_ERROR;
+    }
+
+    // The header length depends on the number of length digits
+    int header_size = sprintf_s(session.message_buffer, session.message_buffer_size, "$M%08X,%04X:", address, length);
+
+    // Encode the data and calculate the checksum in a single pass
+    unsigned char sum = calculate_checksum(&session.message_buffer[1], (unsigned)header_size - 1U);
+    sum += bin_to_hex(buffer, &session.message_buffer[header_size], length);
+    char * position = &session.message_buffer[header_size + 2 * length];
 
-    unsigned msg_len = (unsigned)(position + 3 - message_buffer);
-    if (gdb_send(message_buffer, msg_len) != GDB_OK)
+    sprintf_s(position, (size_t)(&session.message_buffer[session.message_buffer_size] - position), "#%02X", sum);
+
+    unsigned msg_len = (unsigned)(position + 3 - session.message_buffer);
+    if (gdb_send(session.message_buffer, msg_len) != GDB_OK)
     {
         return GDB_ERROR;
     }
 
+    return check_write_reply();
+}
+
+
+/***
+ * @brief Receive and check the reply to the memory write request.
+ *
+ * @return GDB_OK    - Data written
+ *         GDB_ERROR - Data not written (check last_gdb_error for details)
+ */
+
+static int check_write_reply(void)
+{
     if (gdb_get_message(0) != GDB_OK)
     {
         return GDB_ERROR;
     }
 
-    if (strncmp(message_buffer, "$OK#", 4) == 0)
+    if (strncmp(session.message_buffer, "$OK#", 4) == 0)
     {
         return GDB_OK;
     }
@@ -564,14 +1542,39 @@ static int write_memory_packet(const unsigned char * buffer, unsigned address, u
         return GDB_ERROR;
     }
 
-    log_string(" - bad response: %s. ", message_buffer);
+    log_string(" - bad response: %s. ", session.message_buffer);
     last_gdb_error = ERR_BAD_RESPONSE;
     return GDB_ERROR;
 }
 
 
 /***
- * @brief Receive a message from the GDB server
+ * @brief Find the end of the message in the message_buffer.
+ *        The message ends two characters (checksum) after the '#' character.
+ * 
+ * @param scan_start  Index from which the search for the '#' character continues
+ * 
+ * @return Length of the complete message or 0 if the message is not complete yet
+ */
+
+static unsigned find_message_end(unsigned scan_start)
+{
+    for (unsigned i = scan_start; (i + 2U) < session.data_received; i++)
+    {
+        if (session.message_buffer[i] == '#')
+        {
+            return i + 3U;
+        }
+    }
+
+    return 0;
+}
+
+
+/***
+ * @brief Receive a message from the GDB server.
+ *        Data received after the end of the message (e.g. the reply to the next
+ *        pipelined request) is saved and used by the next call of this function.
  * 
  * @param timeout  Max. waiting time for a message [ms]
  * 
@@ -581,21 +1584,110 @@ static int write_memory_packet(const unsigned char * buffer, unsigned address, u
 
 static int gdb_get_message(size_t timeout)
 {
-    clock_t start_time = clock_ms();
-    data_received = 0;
+    return receive_frame(timeout, NULL);
+}
+
+
+/***
+ * @brief Receive a message from the GDB server and optionally decode it while it is
+ *        being received. Each received part of the message is passed to the frame decoder,
+ *        which also finds the end of the message. The complete raw message remains
+ *        in the message_buffer (e.g. for the error reply check).
+ * 
+ * @param timeout  Max. waiting time for a message [ms]
+ * @param frame    Frame decoder (NULL - the message is not decoded)
+ * 
+ * @return GDB_OK    - no error
+ *         GDB_ERROR - message not received
+ */
+
+static int receive_frame(size_t timeout, rsp_frame_t* frame)
+{
+    session.data_received = 0;
 
     if (timeout == 0)
     {
         timeout = RECV_TIMEOUT;
     }
 
-    char * msg_ptr = message_buffer;
+    const long deadline = clock_ms() + (long)timeout;
+
+    char * msg_ptr = session.message_buffer;
     *msg_ptr = 0;
-    const unsigned max_len = sizeof(message_buffer);
+    const unsigned max_len = session.message_buffer_size;
+    unsigned scan_start = 1U;   // Skip the starting '$'
+    unsigned decoded_end = 0;   // Number of received bytes processed by the frame decoder
+    LARGE_INTEGER span_start;
+
+    if (session.data_pending > 0)
+    {
+        // Start with the data received after the end of the previous message
+        memcpy(session.message_buffer, session.pending_data, session.data_pending);
+        session.data_received = session.data_pending;
+        msg_ptr += session.data_pending;
+        session.data_pending = 0;
+    }
 
     for(;;)
     {
-        int res = recv(gdb_socket, msg_ptr, max_len - data_received, 0);
+        unsigned message_end;
+
+        if (frame != NULL)
+        {
+            stats_span_start(&span_start);
+            decoded_end += rsp_frame_decode(frame, &session.message_buffer[decoded_end], session.data_received - decoded_end);
+            stats_span_end(SPAN_DECODE, &span_start);
+            message_end = (frame->state == FRAME_DONE) ? decoded_end : 0;
+        }
+        else
+        {
+            // Check message - shortest regular message is '$#xx'
+            message_end = find_message_end(scan_start);
+        }
+
+        if (message_end > 0)
+        {
+            session.data_pending = session.data_received - message_end;
+            if (session.data_pending > 0)
+            {
+                memcpy(session.pending_data, &session.message_buffer[message_end], session.data_pending);
+            }
+
+            session.data_received = message_end;
+            stats_count(COUNT_PACKETS_RECEIVED, 1U);
+            gdb_send_ack();
+            session.message_buffer[session.data_received] = 0;  // Terminate the string
+            return GDB_OK;
+        }
+
+        if (session.data_received > 3U)
+        {
+            scan_start = session.data_received - 2U;    // The checksum characters may not have been received yet
+        }
+
+        // Wait for the data without polling - the wait ends as soon as data arrives
+        stats_span_start(&span_start);
+        int ready = wait_for_data(deadline - clock_ms());
+        stats_span_end(SPAN_WAIT, &span_start);
+
+        if (ready < 0)
+        {
+            last_gdb_error = ERR_SOCKET;
+            return GDB_ERROR;
+        }
+
+        if (ready == 0)
+        {
+            log_string(" - time out error. ", NULL);
+            session.message_buffer[session.data_received] = 0;  // Terminate the string
+            last_gdb_error = ERR_RCV_TIMEOUT;
+            stats_count(COUNT_TIMEOUTS, 1U);
+            return GDB_ERROR;
+        }
+
+        stats_span_start(&span_start);
+        int res = recv(session.gdb_socket, msg_ptr, max_len - session.data_received - 1U, 0);
+        stats_span_end(SPAN_RECV, &span_start);
 
         if (res == 0)
         {
@@ -608,211 +1700,345 @@ static int gdb_get_message(size_t timeout)
 
         if (res < 0)        // Error reported?
         {
-            int sock_err = GetLastError();
-            if (sock_err != WSAETIMEDOUT)
-            {
-                last_gdb_error = ERR_SOCKET;
-                return GDB_ERROR;
-            }
-
-            if ((clock_ms() - start_time) > timeout)
-            {
-                log_string(" - time out error. ", NULL);
-                message_buffer[data_received] = 0;  // Terminate the string
-                last_gdb_error = ERR_RCV_TIMEOUT;
-                return GDB_ERROR;
-            }
-
-            continue;
+            log_wsock_error(" - GDB Winsock receive error");
+            last_gdb_error = ERR_SOCKET;
+            return GDB_ERROR;
         }
 
         log_communication("Recv", msg_ptr, res);
+        stats_count(COUNT_BYTES_RECEIVED, (unsigned)res);
         msg_ptr += res;
-        data_received += res;
+        session.data_received += res;
 
-        if (data_received >= (sizeof(message_buffer) - 1U))
+        if (session.data_received >= (session.message_buffer_size - 1U))
         {
-            log_data(" - buffer index overflow: %u", (long long)data_received);
+            log_data(" - buffer index overflow: %u", (long long)session.data_received);
             return GDB_ERROR;
         }
+    }
+}
 
-        // Check message - shortest regular message is '$#xx'
-        if ((data_received >= 4U) && (message_buffer[data_received - 3U] == '#'))
-        {
-            gdb_send_ack();
-            message_buffer[data_received] = 0;  // Terminate the string
-            return GDB_OK;
-        }
+
+/***
+ * @brief Discard the data received after the end of the last message.
+ */
+
+static void discard_pending_data(void)
+{
+    if (session.data_pending > 0)
+    {
+        log_communication("Discarded", session.pending_data, (int)session.data_pending);
+        session.data_pending = 0;
     }
 }
 
 
 /***
- * @brief Convert two hexadecimal characters to their binary representation
+ * @brief Send a command to the GDB server
  * 
- * @param ptr Pointer to the hexadecimal string (must contain at least two characters)
+ * @param command  Command string to send to the GDB server
  * 
- * @return int The binary value if successful (0-255), or -1 if an error occurred
+ * @return GDB_OK on success, GDB_ERROR on failure
+ */
+
+static int gdb_send_command(const char * command)
+{
+    char sendbuff[1024U];
+    int length = format_packet(sendbuff, sizeof(sendbuff), command);
+
+    if (length < 0)
+    {
+        return GDB_ERROR;
+    }
+
+    return gdb_send(sendbuff, length);
+}
+
+
+/***
+ * @brief Format the command as a GDB packet ($command#checksum).
+ *
+ * @param buffer   Buffer for the packet
+ * @param size     Size of the buffer
+ * @param command  Command string
+ *
+ * @return Packet length, -1 if the command is too long
  */
 
-static int get_hex_digit(const char * ptr)
+static int format_packet(char* buffer, size_t size, const char* command)
 {
-    if (ptr == NULL)
+    size_t len = strlen(command);
+
+    if ((len + 4U) >= size)
     {
+        log_data(" GDB command too long (%llu) ", (long long)len);
+        last_gdb_error = ERR_BAD_INPUT_DATA;
         return -1;
     }
 
-    int dec_val = 0;
+    // Calculate checksum (sum of all bytes modulo 256)
+    unsigned char checksum = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        checksum += (unsigned char)command[i];
+    }
+
+    // Format the command with $ prefix, command, # separator, and 2-digit hex checksum
+    sprintf_s(buffer, size, "$%s#%02X", command, checksum);
+
+    // Length + 4 for $, #, and two checksum digits
+    return (int)(len + 4U);
+}
+
+
+/***
+ * @brief Check the GDB debug server capability information and
+ *        set the global statuses and variables accordingly.
+ * 
+ * @param recvbuf  Pointer to string with capability information
+ *
+ * @return GDB_OK on success, GDB_ERROR if NoAckMode is not supported
+ */
+
+static int parse_capability_data(const char * recvbuf)
+{
+    // Check if GDB server supports the QStartNoAckMode
+    if (strstr(recvbuf, "QStartNoAckMode+") == NULL)
+    {
+        log_string("Error: ", "GDB server does not support 'QStartNoAckMode+' mode.");
+        return GDB_ERROR;
+    }
+
+    // Check if the GDB server reported support for binary memory reads ('x' packet with 'b' prefix)
+    session.binary_read_supported = false;
+    session.binary_read_prefix = false;
 
-    for (int i = 0; i < 2; i++)
+    if ((strstr(recvbuf, "binary-upload+") != NULL) && !parameters.hex_transfers)
     {
-        dec_val *= 16;
+        session.binary_read_supported = true;
+        session.binary_read_prefix = true;
+    }
 
-        if ((*ptr >= '0') && (*ptr <= '9'))
-        {
-            dec_val += *ptr - '0';
-        }
-        else if ((*ptr >= 'A') && (*ptr <= 'F'))
-        {
-            dec_val += *ptr - 'A' + 10;
-        }
-        else if ((*ptr >= 'a') && (*ptr <= 'f'))
+    // Determine max. message size that can be received by the GDB server
+    session.max_gdb_send_message_size = DEFAULT_MESSAGE_SIZE;
+    const char * text_position = strstr(recvbuf, "PacketSize=");
+
+    if (text_position != NULL)
+    {
+        text_position += sizeof("PacketSize=") - 1;
+        int res = sscanf_s(text_position, "%x", &session.max_gdb_send_message_size);
+
+        if (res == 1)
         {
-            dec_val += *ptr - 'a' + 10;
+            log_data("max. message size %u", (long long)session.max_gdb_send_message_size);
         }
         else
         {
-            return -1;
+            log_data(
+                "\nCannot determine maximal GDB message packet size - using default: %u.\n",
+                DEFAULT_MESSAGE_SIZE);
+            session.max_gdb_send_message_size = DEFAULT_MESSAGE_SIZE;
         }
-
-        ptr++;
     }
-    return dec_val;
+    else
+    {
+        log_data("\nPacketSize field not found - using default message size: %u.\n",
+            DEFAULT_MESSAGE_SIZE);
+        session.max_gdb_send_message_size = DEFAULT_MESSAGE_SIZE;
+    }
+
+    session.server_identity = gdb_crc32((const unsigned char*)recvbuf, (unsigned)strlen(recvbuf));
+    select_fill_backend(recvbuf);
+    calculate_max_message_sizes();      // May reallocate the message buffer (recvbuf)
+
+    return GDB_OK;
 }
 
 
 /***
- * @brief Send a command to the GDB server
- * 
- * @param command  Command string to send to the GDB server
+ * @brief Select the memory fill backend according to the -fill argument.
+ *        In the auto mode, the GDB server type is detected from the capability data.
+ *        OpenOCD reports the memory map and thread list support - the server type is
+ *        confirmed before the first fill (see fill_server_identified()). J-Link and ST-LINK
+ *        GDB servers do not have a monitor command for filling a memory block.
  * 
- * @return GDB_OK on success, GDB_ERROR on failure
+ * @param recvbuf  Capability data received from the GDB server
  */
 
-static int gdb_send_command(const char * command)
+static void select_fill_backend(const char* recvbuf)
 {
-    char sendbuff[1024U];
-    size_t len = strlen(command);
+    fill_mode_t mode = parameters.fill_mode;
+    session.fill_backend = NULL;
+    session.fill_backend_verified = false;
 
-    if (len >= (sizeof(sendbuff) - 4))
+    if ((mode == FILL_AUTO)
+        && (strstr(recvbuf, "qXfer:memory-map:read+") != NULL)
+        && (strstr(recvbuf, "qXfer:threads:read+") != NULL))
     {
-        log_data(" GDB command too long (%llu) ", (long long)len);
-        last_gdb_error = ERR_BAD_INPUT_DATA;
-        return GDB_ERROR;
+        mode = FILL_OPENOCD;
+    }
+
+    for (size_t i = 0; i < sizeof(fill_backends) / sizeof(fill_backends[0]); i++)
+    {
+        if (fill_backends[i].mode == mode)
+        {
+            session.fill_backend = &fill_backends[i];
+            log_string(", memory fill: %s", session.fill_backend->name);
+            break;
+        }
+    }
+}
+
+
+/***
+ * @brief Calculate max. message sizes for the communication with the GDB server.
+ */
+
+static void calculate_max_message_sizes(void)
+{
+    if (session.max_gdb_send_message_size > MAX_MESSAGE_BUFFER_SIZE)
+    {
+        session.max_gdb_send_message_size = MAX_MESSAGE_BUFFER_SIZE;
+    }
+
+    session.max_gdb_recv_message_size = session.max_gdb_send_message_size;
+
+    if (parameters.max_message_size != 0)
+    {
+        // User defined receive buffer size
+        session.max_gdb_recv_message_size = parameters.max_message_size;
+        if (session.max_gdb_recv_message_size > MAX_MESSAGE_BUFFER_SIZE)
+        {
+            session.max_gdb_recv_message_size = MAX_MESSAGE_BUFFER_SIZE;
+        }
+    }
+
+    // The message buffers must hold the largest message sent and the largest reply.
+    // A binary read reply can be up to twice as long as the data if all bytes are escaped.
+    unsigned required_size = 2U * session.max_gdb_recv_message_size + 8U;
+    if (required_size < (session.max_gdb_send_message_size + 1U))
+    {
+        required_size = session.max_gdb_send_message_size + 1U;
+    }
+
+    if (resize_message_buffers(required_size) != GDB_OK)
+    {
+        // Use the smaller packets that fit into the present buffers
+        last_gdb_error = 0;
+        if (session.max_gdb_send_message_size > (session.message_buffer_size - 1U))
+        {
+            session.max_gdb_send_message_size = session.message_buffer_size - 1U;
+        }
+
+        if (session.max_gdb_recv_message_size > ((session.message_buffer_size - 8U) / 2U))
+        {
+            session.max_gdb_recv_message_size = (session.message_buffer_size - 8U) / 2U;
+        }
     }
 
-    // Calculate checksum (sum of all bytes modulo 256)
-    unsigned char checksum = 0;
-    for (size_t i = 0; i < len; i++)
+    /* Calculate the maximal read and write memory size (bytes).
+     * Size is made divisible by 4 because some debug probes transfer data more
+     * slowly when it is not.
+     */
+    session.max_memo_read_packet_size = ((session.max_gdb_recv_message_size - 4) / 8) * 4;
+        // Read packet: '$' at the start and checksum '#xx' at the end (no zero at end of string)
+
+    session.max_memo_binary_read_packet_size = ((session.max_gdb_recv_message_size - 5) / 4) * 4;
+        // Binary read packet: '$b' at the start and checksum '#xx' at the end.
+        // The GDB server returns less data if the escaped data does not fit into a packet.
+
+    if (session.max_memo_binary_read_packet_size > (((session.message_buffer_size - 6) / 8) * 4))
     {
-        checksum += (unsigned char)command[i];
+        // All bytes may be escaped - the reply must fit into the message buffer
+        session.max_memo_binary_read_packet_size = ((session.message_buffer_size - 6) / 8) * 4;
     }
 
-    // Format the command with $ prefix, command, # separator, and 2-digit hex checksum
-    sprintf_s(sendbuff, sizeof(sendbuff), "$%s#%02X", command, checksum);
+    session.max_memo_write_packet_size = ((session.max_gdb_send_message_size - 20 - 4) / 8) * 4;
+        // Write packet: '$Mxxxxxxxx,xxxxxxxx:' at the start + '#xx' & zero at the end of string
 
-    // Send the formatted command (length + 4 for $, #, and two checksum digits)
-    return gdb_send(sendbuff, (int)(len + 4));
+    session.max_memo_binary_write_packet_size = session.max_gdb_send_message_size - 20 - 4;
+        // Binary write packet: '$Xxxxxxxxx,xxxxxxxx:' at the start + '#xx' & zero at the end.
+        // The number of data bytes in a packet depends on the number of escaped bytes.
 }
 
 
 /***
- * @brief Check the GDB debug server capability information and
- *        set the global statuses and variables accordingly.
+ * @brief Allocate the message buffers or enlarge them. The buffers are never made smaller.
+ *        The data already in the buffers (e.g. pending data) is preserved.
  * 
- * @param recvbuf  Pointer to string with capability information
- *
- * @return GDB_OK on success, GDB_ERROR if NoAckMode is not supported
+ * @param size  Required buffer size [bytes]
+ * 
+ * @return GDB_OK    - buffers allocated
+ *         GDB_ERROR - not enough memory (the present buffers remain valid)
  */
 
-static int parse_capability_data(const char * recvbuf)
+static int resize_message_buffers(unsigned size)
 {
-    // Check if GDB server supports the QStartNoAckMode
-    if (strstr(recvbuf, "QStartNoAckMode+") == NULL)
+    if (size <= session.message_buffer_size)
     {
-        log_string("Error: ", "GDB server does not support 'QStartNoAckMode+' mode.");
-        return GDB_ERROR;
+        return GDB_OK;
     }
 
-    // Determine max. message size that can be received by the GDB server
-    max_gdb_send_message_size = DEFAULT_MESSAGE_SIZE;
-    const char * text_position = strstr(recvbuf, "PacketSize=");
-
-    if (text_position != NULL)
+    char* new_buffer = (char*)realloc(session.message_buffer, size);
+    if (new_buffer == NULL)
     {
-        text_position += sizeof("PacketSize=") - 1;
-        int res = sscanf_s(text_position, "%x", &max_gdb_send_message_size);
-
-        if (res == 1)
-        {
-            log_data("max. message size %u", (long long)max_gdb_send_message_size);
-        }
-        else
-        {
-            log_data(
-                "\nCannot determine maximal GDB message packet size - using default: %u.\n",
-                DEFAULT_MESSAGE_SIZE);
-            max_gdb_send_message_size = DEFAULT_MESSAGE_SIZE;
-        }
+        log_data("\nCould not allocate the message buffer (%llu bytes).", (long long)size);
+        last_gdb_error = ERR_OUT_OF_MEMORY;
+        return GDB_ERROR;
     }
-    else
+    session.message_buffer = new_buffer;
+
+    new_buffer = (char*)realloc(session.pending_data, size);
+    if (new_buffer == NULL)
     {
-        log_data("\nPacketSize field not found - using default message size: %u.\n",
-            DEFAULT_MESSAGE_SIZE);
-        max_gdb_send_message_size = DEFAULT_MESSAGE_SIZE;
+        log_data("\nCould not allocate the message buffer (%llu bytes).", (long long)size);
+        last_gdb_error = ERR_OUT_OF_MEMORY;
+        return GDB_ERROR;
     }
+    session.pending_data = new_buffer;
 
-    calculate_max_message_sizes();
-
+    session.message_buffer_size = size;
     return GDB_OK;
 }
 
 
 /***
- * @brief Calculate max. message sizes for the communication with the GDB server.
+ * @brief Change the max. message size received from the GDB server (as with the -msgsize
+ *        argument) and recalculate the memory read and write packet sizes.
+ * 
+ * @param size  Max. message size (0 - use the size reported by the GDB server)
  */
 
-static void calculate_max_message_sizes(void)
+void gdb_set_max_message_size(unsigned size)
 {
-    if (max_gdb_send_message_size > TCP_BUFF_LENGTH)
-    {
-        max_gdb_send_message_size = TCP_BUFF_LENGTH;
-    }
+    parameters.max_message_size = size;
+    calculate_max_message_sizes();
+}
 
-    max_gdb_recv_message_size = max_gdb_send_message_size;
 
-    if (parameters.max_message_size != 0)
-    {
-        // User defined receive buffer size
-        max_gdb_recv_message_size = parameters.max_message_size;
-        if (max_gdb_recv_message_size > TCP_BUFF_LENGTH)
-        {
-            max_gdb_recv_message_size = TCP_BUFF_LENGTH;
-        }
-    }
+/***
+ * @brief Get the max. message size reported by the GDB server (PacketSize in the
+ *        qSupported reply, or the default size if not reported).
+ * 
+ * @return Max. message size [bytes]
+ */
 
-    /* Calculate the maximal read and write memory size (bytes).
-     * Note: The present library implementation can not handle TCP messages with
-     * a length over 65535 bytes -> max. possible read_memory size = (65535 - 4) / 2.
-     * 
-     * Size is made divisible by 4 because some debug probes transfer data more
-     * slowly when it is not.
-     */
-    max_memo_read_packet_size = ((max_gdb_recv_message_size - 4) / 8) * 4;
-        // Read packet: '$' at the start and checksum '#xx' at the end (no zero at end of string)
+unsigned gdb_server_packet_size(void)
+{
+    return session.max_gdb_send_message_size;
+}
+
+
+/***
+ * @brief Get the value identifying the GDB server. It is calculated from the capability
+ *        data, which depends on the GDB server type and version.
+ * 
+ * @return GDB server identity (CRC of the qSupported reply)
+ */
 
-    max_memo_write_packet_size = ((max_gdb_send_message_size - 16 - 4) / 8) * 4;
-        // Write packet: '$Mxxxxxxxx,xxxx:' at the start + '#xx' & zero at the end of string
+unsigned gdb_server_identity(void)
+{
+    return session.server_identity;
 }
 
 
@@ -844,7 +2070,7 @@ int gdb_check_server_capabilities(void)
         return GDB_ERROR;
     }
 
-    res = parse_capability_data(message_buffer);
+    res = parse_capability_data(session.message_buffer);
     if (res == GDB_OK)
     {
         log_timing(" (%.1f ms)", &StartingTime);
@@ -854,6 +2080,89 @@ int gdb_check_server_capabilities(void)
 }
 
 
+/***
+ * @brief Check if the GDB server supports binary memory reads ('x' packet) if the support
+ *        was not reported in the capability data. Servers that do not support the packet
+ *        return an empty reply. A few bytes of the g_rtedbg structure header are read
+ *        to determine whether the binary data has the 'b' prefix or not.
+ */
+
+static void probe_binary_read_support(void)
+{
+    if (session.binary_read_supported || parameters.hex_transfers)
+    {
+        return;
+    }
+
+    log_string("\nChecking for binary memory read support: ", NULL);
+
+    char command[32];
+    sprintf_s(command, sizeof(command), "x%08x,4", parameters.start_address);
+
+    if ((gdb_send_command(command) != GDB_OK) || (gdb_get_message(0) != GDB_OK)
+        || (session.message_buffer[0] != '$'))
+    {
+        gdb_flush_socket();
+        log_string("not supported. ", NULL);
+        last_gdb_error = 0;
+        return;
+    }
+
+    unsigned char data[8];
+    unsigned decoded = 0;
+
+    if (unescape_binary_data(&session.message_buffer[1], session.data_received - 4U, data, sizeof(data), &decoded) == GDB_OK)
+    {
+        if ((decoded == 5U) && (session.message_buffer[1] == 'b'))
+        {
+            session.binary_read_supported = true;
+            session.binary_read_prefix = true;
+        }
+        else if (decoded == 4U)
+        {
+            session.binary_read_supported = true;
+        }
+    }
+
+    log_string(session.binary_read_supported ? "supported. " : "not supported. ", NULL);
+}
+
+
+/***
+ * @brief Check if the GDB server supports binary memory writes ('X' packet).
+ *        A zero length write is used as a probe (as GDB does). The server responds
+ *        with "OK" if the packet is supported and with an empty reply if not.
+ */
+
+static void probe_binary_write_support(void)
+{
+    session.binary_write_supported = false;
+
+    if (parameters.hex_transfers)
+    {
+        return;
+    }
+
+    log_string("\nChecking for binary memory write support: ", NULL);
+
+    char command[32];
+    sprintf_s(command, sizeof(command), "X%08x,0:", parameters.start_address);
+
+    if ((gdb_send_command(command) == GDB_OK) && (gdb_get_message(0) == GDB_OK)
+        && (strncmp(session.message_buffer, "$OK#", 4) == 0))
+    {
+        session.binary_write_supported = true;
+    }
+    else
+    {
+        gdb_flush_socket();
+        last_gdb_error = 0;
+    }
+
+    log_string(session.binary_write_supported ? "supported. " : "not supported. ", NULL);
+}
+
+
 /***
  * @brief Send the "D" (detach) command to the GDB server.
  *        No error check if the GDB server responded properly. We'll disconnect anyway.
@@ -992,61 +2301,301 @@ int gdb_send_commands_from_file(const char* cmd_file)
     {
         char err_string[256];
         (void)strerror_s(err_string, sizeof(err_string), errno);
-        log_string("\nCould not open command file - error: %s \n", err_string);
+        log_string("\nCould not open command file - error: %s \n", err_string);
+
+        if (logging_to_file())
+        {
+            printf("\nCould not open command file - error: %s \n", err_string);
+        }
+        
+        return 1;
+    }
+
+    if (parameters.batch_commands)
+    {
+        execute_command_batch(commands);
+    }
+    else
+    {
+        execute_command_lines(commands);
+    }
+
+    (void)fclose(commands);
+    printf("\n");
+
+    return 0;
+}
+
+
+/***
+ * @brief Execute the commands from the command file line by line.
+ *        Execution stops at the first command not executed successfully.
+ *
+ * @param commands  Command file
+ */
+
+static void execute_command_lines(FILE* commands)
+{
+    for (;;)
+    {
+        char cmd_text[512];
+        char * rez = fgets(cmd_text, sizeof(cmd_text), commands);
+        if (rez == NULL)
+        {
+            if (!feof(commands))
+            {
+                (void)strerror_s(cmd_text, sizeof(cmd_text), errno);
+                log_string(": can't read from file - error: %s\n", cmd_text);
+
+                if (logging_to_file())
+                {
+                    printf(": can't read from file - error: %s\n", cmd_text);
+                }
+            }
+            break;
+        }
+
+        rez = strchr(cmd_text, '\n');
+        if (rez != NULL)
+        {
+            *rez = '\0';        // Strip the newline at the end of line
+        }
+
+        if (strlen(cmd_text) > 0)
+        {
+            if (*cmd_text == '#')
+            {
+                internal_command(cmd_text);
+            }
+            else
+            {
+                if (gdb_execute_command(cmd_text) != GDB_OK)
+                {
+                    break;
+                }
+            }
+        }
+    }
+}
+
+
+/***
+ * @brief Execute the commands from the command file in the batch mode (-batch argument).
+ *        The file is read at once. Consecutive memory and register write commands are sent
+ *        to the GDB server without waiting for the reply to the previous command.
+ *        The internal (#) commands and all other GDB commands are executed one by one -
+ *        in the same order as in the file. Execution stops at the first command not
+ *        executed successfully.
+ *
+ * @param commands  Command file
+ */
+
+static void execute_command_batch(FILE* commands)
+{
+    unsigned line_count = 0;
+    char* text = read_command_file(commands, &line_count);
+
+    if (text == NULL)
+    {
+        return;
+    }
+
+    const char** lines = (const char**)malloc(((size_t)line_count + 1U) * sizeof(char*));
+    if (lines == NULL)
+    {
+        log_string("\nCould not allocate memory buffer.", NULL);
+        free(text);
+        return;
+    }
+
+    // Split the text into non-empty lines
+    unsigned count = 0;
+    char* context = NULL;
+
+    for (char* line = strtok_s(text, "\r\n", &context); line != NULL; line = strtok_s(NULL, "\r\n", &context))
+    {
+        lines[count++] = line;
+    }
+
+    for (unsigned i = 0; i < count; )
+    {
+        if (*lines[i] == '#')
+        {
+            internal_command(lines[i]);
+            i++;
+            continue;
+        }
+
+        unsigned n = 0;     // Number of consecutive commands that can be pipelined
+        while (((i + n) < count) && pipelined_command(lines[i + n]))
+        {
+            n++;
+        }
+
+        if (n < 2U)
+        {
+            if (gdb_execute_command(lines[i]) != GDB_OK)
+            {
+                break;
+            }
+
+            i++;
+            continue;
+        }
+
+        if (execute_pipelined_commands(&lines[i], n) != GDB_OK)
+        {
+            break;
+        }
+
+        i += n;
+    }
+
+    free(lines);
+    free(text);
+}
+
+
+/***
+ * @brief Read the complete command file.
+ *
+ * @param commands    Command file
+ * @param line_count  Max. number of lines in the file
+ *
+ * @return Zero terminated file contents, NULL - file could not be read
+ */
+
+static char* read_command_file(FILE* commands, unsigned* line_count)
+{
+    if (fseek(commands, 0, SEEK_END) != 0)
+    {
+        return NULL;
+    }
+
+    long file_size = ftell(commands);
+    rewind(commands);
+
+    if ((file_size < 0) || (file_size > MAX_BATCH_FILE_SIZE))
+    {
+        log_string("\nThe command file is too large for the batch mode.", NULL);
+        return NULL;
+    }
+
+    char* text = (char*)malloc((size_t)file_size + 1U);
+    if (text == NULL)
+    {
+        log_string("\nCould not allocate memory buffer.", NULL);
+        return NULL;
+    }
+
+    size_t length = fread(text, 1, (size_t)file_size, commands);
+    if (ferror(commands))
+    {
+        char err_string[256];
+        (void)strerror_s(err_string, sizeof(err_string), errno);
+        log_string(": can't read from file - error: %s\n", err_string);
+        free(text);
+        return NULL;
+    }
 
-        if (logging_to_file())
+    text[length] = '\0';
+
+    *line_count = 1U;
+    for (size_t i = 0; i < length; i++)
+    {
+        if ((text[i] == '\n') || (text[i] == '\r'))
         {
-            printf("\nCould not open command file - error: %s \n", err_string);
+            (*line_count)++;
         }
-        
-        return 1;
     }
 
-    for (;;)
+    return text;
+}
+
+
+/***
+ * @brief Check if the command can be sent without waiting for the reply to the previous one.
+ *        Only the memory and register writes are pipelined - the reply to them must be "OK".
+ *        Commands such as reset, continue or monitor commands are executed one by one
+ *        because their output must be checked or they change the state of the target.
+ *
+ * @param command  GDB command string
+ *
+ * @return true - the command can be pipelined
+ */
+
+static bool pipelined_command(const char* command)
+{
+    return (command[0] == 'M') || (command[0] == 'X') || (command[0] == 'P');
+}
+
+
+/***
+ * @brief Send the commands to the GDB server without waiting for the reply to the previous one.
+ *        Up to parameters.pipeline_depth (or BATCH_PIPELINE_DEPTH if not set) commands are
+ *        outstanding at a time. The replies arrive in the same order as the commands were sent.
+ *
+ * @param commands  GDB command strings
+ * @param count     Number of commands
+ *
+ * @return GDB_OK    - all commands executed
+ *         GDB_ERROR - a command could not be executed
+ */
+
+static int execute_pipelined_commands(const char* const* commands, unsigned count)
+{
+    last_gdb_error = 0;
+    LARGE_INTEGER StartingTime;
+    start_timer(&StartingTime);
+    log_data("\n   %llu commands sent in the batch mode:", (long long)count);
+
+    unsigned depth = (parameters.pipeline_depth > 1U) ? parameters.pipeline_depth : BATCH_PIPELINE_DEPTH;
+    if (session.ack_mode_enabled)
     {
-        char cmd_text[512];
-        char * rez = fgets(cmd_text, sizeof(cmd_text), commands);
-        if (rez == NULL)
+        depth = 1U;    // The requests can only be pipelined in the no-ACK mode
+    }
+
+    unsigned sent = 0;
+
+    for (unsigned received = 0; received < count; received++)
+    {
+        while ((sent < count) && ((sent - received) < depth))
         {
-            if (!feof(commands))
+            if (gdb_send_command(commands[sent]) != GDB_OK)
             {
-                (void)strerror_s(cmd_text, sizeof(cmd_text), errno);
-                log_string(": can't read from file - error: %s\n", cmd_text);
-
-                if (logging_to_file())
-                {
-                    printf(": can't read from file - error: %s\n", cmd_text);
-                }
+                discard_outstanding_replies(sent - received);
+                return GDB_ERROR;
             }
-            break;
+
+            sent++;
         }
 
-        rez = strchr(cmd_text, '\n');
-        if (rez != NULL)
+        log_string("\n   \"%s\": ", commands[received]);
+
+        if (gdb_get_message(0) != GDB_OK)
         {
-            *rez = '\0';        // Strip the newline at the end of line
+            discard_outstanding_replies(sent - received - 1U);
+            return GDB_ERROR;
         }
 
-        if (strlen(cmd_text) > 0)
+        if (gdb_error_reported() || (strncmp(session.message_buffer, "$OK#", 4) != 0))
         {
-            if (*cmd_text == '#')
-            {
-                internal_command(cmd_text);
-            }
-            else
+            if (last_gdb_error == 0)
             {
-                if (gdb_execute_command(cmd_text) != GDB_OK)
-                {
-                    break;
-                }
+                const char* text = get_core_content(session.message_buffer);
+                log_string("\"%s\"", *text == '\0' ? "unsupported command" : text);
+                last_gdb_error = ERR_BAD_INPUT_DATA;
             }
+
+            discard_outstanding_replies(sent - received - 1U);
+            return GDB_ERROR;
         }
-    }
 
-    (void)fclose(commands);
-    printf("\n");
+        log_string("OK", NULL);
+    }
 
-    return 0;
+    log_timing("\n   Batch executed in %.1f ms", &StartingTime);
+    return GDB_OK;
 }
 
 
@@ -1057,9 +2606,9 @@ int gdb_send_commands_from_file(const char* cmd_file)
 
 static void print_O_type_message(void)
 {
-    char* hex_string = message_buffer;
+    char* hex_string = session.message_buffer;
 
-    if (strncmp(message_buffer, "$O", 2) == 0)
+    if (strncmp(session.message_buffer, "$O", 2) == 0)
     {
         hex_string += 2;
     }
@@ -1168,9 +2717,9 @@ int gdb_execute_command(const char * command)
 
     // Receives "$OK#" if OK, "$Oxx... - error message", or some other response
     // 'xx...' is hex encoding of ASCII data, to be written as the program's console output.
-    if (strncmp(message_buffer, "$O", 2) == 0)
+    if (strncmp(session.message_buffer, "$O", 2) == 0)
     {
-        if (message_buffer[2] != 'K')
+        if (session.message_buffer[2] != 'K')
         {
             int res;
             do
@@ -1195,7 +2744,7 @@ int gdb_execute_command(const char * command)
     }
     else
     {
-        const char* text = get_core_content(message_buffer);
+        const char* text = get_core_content(session.message_buffer);
         log_string("\"%s\"", *text == '\0' ? "unsupported command" : text);
         gdb_flush_socket();
         return GDB_ERROR;
@@ -1216,9 +2765,16 @@ void gdb_flush_socket(void)
     char recvbuf[256];
     int res;
 
+    discard_pending_data();
+
     do
     {
-        res = recv(gdb_socket, recvbuf, sizeof(recvbuf), 0);
+        if (wait_for_data(SOCKET_FLUSH_TIMEOUT) <= 0)
+        {
+            break;      // No more data received
+        }
+
+        res = recv(session.gdb_socket, recvbuf, sizeof(recvbuf), 0);
         if (res > 0)
         {
             log_communication("Recv", recvbuf, res);
@@ -1237,7 +2793,7 @@ void gdb_flush_socket(void)
 
 int gdb_request_no_ack_mode(void)
 {
-    ack_mode_enabled = true;
+    session.ack_mode_enabled = true;
 
     if (gdb_send_command("QStartNoAckMode") != GDB_OK)
     {
@@ -1251,14 +2807,14 @@ int gdb_request_no_ack_mode(void)
         return GDB_ERROR;
     }
 
-    if (strncmp(message_buffer, "$OK#", 4) != 0)
+    if (strncmp(session.message_buffer, "$OK#", 4) != 0)
     {
-        log_string("NoACK mode not supported by the GDB server - received: %s. ", message_buffer);
+        log_string("NoACK mode not supported by the GDB server - received: %s. ", session.message_buffer);
         return GDB_ERROR;
     }
     else
     {
-        ack_mode_enabled = false;
+        session.ack_mode_enabled = false;
         gdb_flush_socket();
     }
 
@@ -1266,6 +2822,280 @@ int gdb_request_no_ack_mode(void)
 }
 
 
+/***
+ * @brief Send the capability and no ACK mode requests back to back (fast connect) so that
+ *        only one round trip is needed. Some GDB servers do not read the next request
+ *        before the reply has been acknowledged - the sequential negotiation must be
+ *        used in such case.
+ *
+ * @return GDB_OK    - capabilities retrieved and no ACK mode enabled
+ *         GDB_ERROR - the GDB server did not respond as expected
+ */
+
+static int pipelined_negotiation(void)
+{
+    LARGE_INTEGER StartingTime;
+    start_timer(&StartingTime);
+    log_string("\nRetrieving GDB server capabilities (fast connect): ", NULL);
+
+    char packets[64];
+    int length = format_packet(packets, sizeof(packets), "qSupported");
+
+    if ((length < 0)
+        || (format_packet(&packets[length], sizeof(packets) - (size_t)length, "QStartNoAckMode") < 0)
+        || (gdb_send(packets, (int)strlen(packets)) != GDB_OK))
+    {
+        return GDB_ERROR;
+    }
+
+    gdb_check_ack();
+
+    if ((gdb_get_message(LONG_RECV_TIMEOUT) != GDB_OK)
+        || (parse_capability_data(session.message_buffer) != GDB_OK))
+    {
+        return GDB_ERROR;
+    }
+
+    if (!skip_pending_ack())
+    {
+        gdb_check_ack();
+    }
+
+    if ((gdb_get_message(0) != GDB_OK) || (strncmp(session.message_buffer, "$OK#", 4) != 0))
+    {
+        return GDB_ERROR;
+    }
+
+    session.ack_mode_enabled = false;
+    gdb_flush_socket();
+    log_timing(" (%.1f ms)", &StartingTime);
+    return GDB_OK;
+}
+
+
+/***
+ * @brief Remove the '+' acknowledge character received together with the previous message.
+ *
+ * @return true - acknowledge found and removed
+ */
+
+static bool skip_pending_ack(void)
+{
+    if ((session.data_pending == 0) || (session.pending_data[0] != '+'))
+    {
+        return false;
+    }
+
+    session.data_pending--;
+    memmove(session.pending_data, &session.pending_data[1], session.data_pending);
+    return true;
+}
+
+
+/***
+ * @brief Get the capabilities found at the previous connection to the same GDB server -
+ *        from the session (connection restored) or from the SERVER_CACHE_FILE (-fastconnect).
+ *
+ * @param known     Known capabilities
+ * @param gdb_port  GDB port number
+ *
+ * @return true - capabilities found
+ */
+
+static bool get_known_capabilities(server_capabilities_t* known, unsigned short gdb_port)
+{
+    memset(known, 0, sizeof(server_capabilities_t));
+    strncpy_s(known->ip_address, sizeof(known->ip_address), parameters.ip_address, _TRUNCATE);
+    known->port = gdb_port;
+
+    const server_capabilities_t* last = &session.capabilities;
+
+    if ((last->identity != 0) && (last->port == known->port) && (strcmp(last->ip_address, known->ip_address) == 0))
+    {
+        *known = *last;
+        return true;
+    }
+
+    if (!parameters.fast_connect)
+    {
+        return false;
+    }
+
+    return load_cached_capabilities(known);
+}
+
+
+/***
+ * @brief Use the binary memory read and write support found at the previous connection.
+ *
+ * @param known  Known capabilities of the GDB server
+ */
+
+static void apply_known_capabilities(const server_capabilities_t* known)
+{
+    session.binary_read_supported = (known->binary_read != 0);
+    session.binary_read_prefix = (known->binary_read == 2U);
+    session.binary_write_supported = (known->binary_write != 0);
+
+    log_string("\nBinary memory read/write support as at the previous connection: ", NULL);
+    log_string(session.binary_read_supported ? "read " : "", NULL);
+    log_string(session.binary_write_supported ? "write " : "", NULL);
+}
+
+
+/***
+ * @brief Save the capabilities for the next connection to the GDB server. They are written
+ *        to the SERVER_CACHE_FILE (-fastconnect) if they differ from the saved ones.
+ *
+ * @param known        Capabilities found at the previous connection
+ * @param known_found  true - the known capabilities are valid
+ */
+
+static void store_capabilities(const server_capabilities_t* known, bool known_found)
+{
+    server_capabilities_t* entry = &session.capabilities;
+    memset(entry, 0, sizeof(server_capabilities_t));
+    strncpy_s(entry->ip_address, sizeof(entry->ip_address), known->ip_address, _TRUNCATE);
+    entry->port = known->port;
+    entry->identity = session.server_identity;
+    entry->binary_read = session.binary_read_supported ? (session.binary_read_prefix ? 2U : 1U) : 0;
+    entry->binary_write = session.binary_write_supported ? 1U : 0;
+    entry->fast_connect = known_found ? known->fast_connect : 1U;
+
+    if (parameters.fast_connect && !parameters.hex_transfers
+        && (!known_found || (memcmp(known, entry, sizeof(server_capabilities_t)) != 0)))
+    {
+        save_cached_capabilities(entry);
+    }
+}
+
+
+/***
+ * @brief Find the capabilities of the GDB server with the IP address and port in the cache file.
+ *
+ * @param entry  Entry with the IP address and port; the saved capabilities are written to it
+ *
+ * @return true - capabilities found
+ */
+
+static bool load_cached_capabilities(server_capabilities_t* entry)
+{
+    server_capabilities_t entries[SERVER_CACHE_MAX_ENTRIES];
+
+    AcquireSRWLockShared(&gdb_lib_lock);
+    unsigned count = read_server_cache(entries, SERVER_CACHE_MAX_ENTRIES);
+    ReleaseSRWLockShared(&gdb_lib_lock);
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        if ((entries[i].port == entry->port) && (strcmp(entries[i].ip_address, entry->ip_address) == 0))
+        {
+            *entry = entries[i];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/***
+ * @brief Read the saved capabilities from the cache file. Lines with invalid values are skipped.
+ *
+ * @param entries    Array for the entries
+ * @param max_count  Size of the array
+ *
+ * @return Number of entries read
+ */
+
+static unsigned read_server_cache(server_capabilities_t* entries, unsigned max_count)
+{
+    FILE* file;
+    if ((fopen_s(&file, SERVER_CACHE_FILE, "r") != 0) || (file == NULL))
+    {
+        return 0;       // Nothing saved yet
+    }
+
+    unsigned count = 0;
+    char line[128];
+
+    while ((count < max_count) && (fgets(line, sizeof(line), file) != NULL))
+    {
+        server_capabilities_t* p = &entries[count];
+        memset(p, 0, sizeof(server_capabilities_t));
+
+        if ((line[0] != '#')
+            && (sscanf_s(line, "%39s %u %x %u %u %u", p->ip_address, (unsigned)sizeof(p->ip_address),
+                &p->port, &p->identity, &p->binary_read, &p->binary_write, &p->fast_connect) == 6)
+            && (p->identity != 0) && (p->binary_read <= 2U) && (p->binary_write <= 1U) && (p->fast_connect <= 1U))
+        {
+            count++;
+        }
+    }
+
+    (void)fclose(file);
+    return count;
+}
+
+
+/***
+ * @brief Save the capabilities to the cache file. The entry for the same IP address and port
+ *        is replaced. The oldest entry is removed if the file is full.
+ *        The file is shared by all sessions (threads) - it is written under the lock.
+ *
+ * @param entry  Capabilities to be saved
+ */
+
+static void save_cached_capabilities(const server_capabilities_t* entry)
+{
+    server_capabilities_t entries[SERVER_CACHE_MAX_ENTRIES];
+
+    AcquireSRWLockExclusive(&gdb_lib_lock);
+    unsigned count = read_server_cache(entries, SERVER_CACHE_MAX_ENTRIES);
+    unsigned index = count;
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        if ((entries[i].port == entry->port) && (strcmp(entries[i].ip_address, entry->ip_address) == 0))
+        {
+            index = i;
+            break;
+        }
+    }
+
+    if (index >= SERVER_CACHE_MAX_ENTRIES)
+    {
+        memmove(&entries[0], &entries[1], (SERVER_CACHE_MAX_ENTRIES - 1U) * sizeof(server_capabilities_t));
+        index = SERVER_CACHE_MAX_ENTRIES - 1U;
+    }
+
+    entries[index] = *entry;
+    if (index >= count)
+    {
+        count = index + 1U;
+    }
+
+    FILE* file;
+    if ((fopen_s(&file, SERVER_CACHE_FILE, "w") != 0) || (file == NULL))
+    {
+        ReleaseSRWLockExclusive(&gdb_lib_lock);
+        log_string("\nCould not write to the file: %s.", SERVER_CACHE_FILE);
+        return;
+    }
+
+    fprintf(file, "# IP address, port, GDB server identity, binary read (2 - with 'b' prefix), binary write, fast connect\n");
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        fprintf(file, "%s %u %08X %u %u %u\n", entries[i].ip_address, entries[i].port, entries[i].identity,
+            entries[i].binary_read, entries[i].binary_write, entries[i].fast_connect);
+    }
+
+    (void)fclose(file);
+    ReleaseSRWLockExclusive(&gdb_lib_lock);
+}
+
+
 /***
  * @brief  Send acknowledge if necessary for the previously received data.
  *         Do not send it if the "QStartNoAckMode" was enabled.
@@ -1273,7 +3103,7 @@ int gdb_request_no_ack_mode(void)
 
 static void gdb_send_ack(void)
 {
-    if (ack_mode_enabled)
+    if (session.ack_mode_enabled)
     {
         (void)gdb_send("+", 1);
     }
@@ -1288,12 +3118,23 @@ static void gdb_send_ack(void)
 
 static void gdb_check_ack(void)
 {
-    clock_t start_time = clock_ms();   // Record the start time
+    const long deadline = clock_ms() + LONG_RECV_TIMEOUT;
 
-    while ((clock_ms() - start_time) < LONG_RECV_TIMEOUT) // Loop until timeout
+    for (;;)
     {
-        message_buffer[0] = 0;      // Clear the message buffer
-        int res = recv(gdb_socket, message_buffer, 1, 0); // Receive a single character
+        int ready = wait_for_data(deadline - clock_ms());
+        if (ready == 0)
+        {
+            break;                  // Timeout
+        }
+
+        if (ready < 0)
+        {
+            return;                 // Socket error (already logged)
+        }
+
+        session.message_buffer[0] = 0;      // Clear the message buffer
+        int res = recv(session.gdb_socket, session.message_buffer, 1, 0); // Receive a single character
 
         switch (res)
         {
@@ -1302,26 +3143,18 @@ static void gdb_check_ack(void)
                 return;
 
             case 1: // Character received
-                if (message_buffer[0] == '+') // Check if it's an ACK
+                if (session.message_buffer[0] == '+') // Check if it's an ACK
                 {
                     return; // Successful ACK received
                 }
-                log_communication("Recv", message_buffer, res); // Log the received data
-                log_string("\nBad ACK received: %s", message_buffer); // Log the bad ACK
+                log_communication("Recv", session.message_buffer, res); // Log the received data
+                log_string("\nBad ACK received: %s", session.message_buffer); // Log the bad ACK
                 gdb_flush_socket(); // Flush any remaining data in the socket buffer
                 break;
 
             case SOCKET_ERROR: // Socket error
-            {
-                int sock_err = GetLastError();
-                if (sock_err != WSAETIMEDOUT)
-                {
-                    log_wsock_error("\nSocket error while waiting for ACK");
-                    return;
-                }
-                // If it's a timeout, continue the loop
-                break;
-            }
+                log_wsock_error("\nSocket error while waiting for ACK");
+                return;
 
             default:
                 log_wsock_error("Unexpected error");
@@ -1330,6 +3163,7 @@ static void gdb_check_ack(void)
     }
 
     log_string("\nACK timeout: No acknowledgement received within the specified timeout.", NULL);
+    stats_count(COUNT_TIMEOUTS, 1U);
 }
 
 
@@ -1342,13 +3176,26 @@ void gdb_handle_unexpected_messages(void)
 {
     int res = 0;
 
+    if (session.data_pending > 0)
+    {
+        session.pending_data[session.data_pending] = 0;
+        log_string("\nUnexpected message: %s", session.pending_data);
+        session.data_pending = 0;
+    }
+
     do
     {
-        res = recv(gdb_socket, message_buffer, TCP_BUFF_LENGTH, 0);
+        if (wait_for_data(0) <= 0)
+        {
+            break;      // No data received
+        }
+
+        res = recv(session.gdb_socket, session.message_buffer, (int)session.message_buffer_size - 1, 0);
         if (res > 0)
         {
             // Log an unexpected GDB message
-            log_string("\nUnexpected message: %s", message_buffer);
+            session.message_buffer[res] = 0;
+            log_string("\nUnexpected message: %s", session.message_buffer);
         }
     }
     while (res > 0);    // Repeat until all data received
@@ -1356,14 +3203,37 @@ void gdb_handle_unexpected_messages(void)
 
 
 /***
- * @brief  Close and cleanup the socket used for communication with the GDB server.
+ * @brief  Close the socket used for communication with the GDB server.
  */
 
 void gdb_socket_cleanup(void)
 {
     log_string("\n", NULL);
-    (void)closesocket(gdb_socket);  // Close the socket
-    (void)WSACleanup();             // Cleanup the Winsock library
+
+    if (session.gdb_socket != INVALID_SOCKET)
+    {
+        (void)closesocket(session.gdb_socket);  // Close the socket
+        session.gdb_socket = INVALID_SOCKET;
+    }
+
+    // Winsock is not cleaned up - the next connection can be established faster
+}
+
+
+/***
+ * @brief  Free the message buffers of the calling thread's GDB server session.
+ *         Must be called after gdb_socket_cleanup() by threads that end before the program exits.
+ */
+
+void gdb_session_release(void)
+{
+    free(session.message_buffer);
+    free(session.pending_data);
+    session.message_buffer = NULL;
+    session.pending_data = NULL;
+    session.message_buffer_size = 0;
+    session.data_received = 0;
+    session.data_pending = 0;
 }
 
 /*==== End of file ====*/
@@ -17,23 +17,33 @@
 #include <time.h>
 #include "gdb_defs.h"
 
-extern char message_buffer[];
-extern unsigned last_gdb_error;
-extern clock_t app_start_time;
+extern thread_local unsigned last_gdb_error;
+extern thread_local clock_t app_start_time;
 
 #define GDB_ERROR   1
 #define GDB_OK      0
 
+void gdb_lib_init(void);
 int  gdb_connect(unsigned short gdb_port);
 int  gdb_connect_socket(unsigned short gdb_port);
 int  gdb_read_memory(unsigned char * buffer, unsigned int address, unsigned int length);
+int  gdb_read_memory_pipelined(unsigned char * buffer, unsigned int address, unsigned int length,
+        unsigned pipeline_depth);
 int  gdb_write_memory(const unsigned char * buffer, unsigned address, unsigned length);
+int  gdb_fill_memory(unsigned address, unsigned length, unsigned value);
+int  gdb_monitor_command(const char * command);
+int  gdb_memory_crc(unsigned address, unsigned length, unsigned * crc);
+unsigned gdb_crc32(const unsigned char * data, unsigned length);
 int  gdb_check_server_capabilities(void);
+void gdb_set_max_message_size(unsigned size);
+unsigned gdb_server_packet_size(void);
+unsigned gdb_server_identity(void);
 void gdb_detach(void);
 int  gdb_execute_command(const char * command);
 void gdb_flush_socket(void);
 int gdb_request_no_ack_mode(void);
 void gdb_socket_cleanup(void);
+void gdb_session_release(void);
 void gdb_handle_unexpected_messages(void);
 int gdb_send_commands_from_file(const char * cmd_file);
 
@@ -0,0 +1,710 @@
+/*
+ * Copyright (c) 2024 Branko Premzel.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * @file    hex_codec.cpp
+ * @brief   Hex encoding / decoding and checksum functions for the GDB messages.
+ * @author  B. Premzel
+ *
+ * The memory read replies of the GDB server are decoded and the memory write
+ * packets are encoded with these functions. The SSE2 or AVX2 version of the hex
+ * decoder, encoder and checksum calculation is used if the CPU supports it.
+ * The scalar (table based) version is used otherwise.
+ * The CPU capabilities are checked at the first call of the functions.
+ */
+
+#include "pch.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "hex_codec.h"
+#include "logger.h"
+
+#if defined(_M_X64) || defined(_M_IX86)
+#define HEX_CODEC_SIMD 1
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#define HEX_CODEC_SIMD 0
+#endif
+
+#define HEX_BENCHMARK_SIZE      (1024U * 1024U)    // Size of decoded data for the benchmark [bytes]
+#define HEX_BENCHMARK_REPEAT    20U                // Number of repetitions of the benchmark
+
+typedef bool (*hex_decoder_t)(const char * src, unsigned char * dst, unsigned length);
+typedef unsigned char (*checksum_function_t)(const char * data, unsigned length);
+typedef unsigned char (*hex_encoder_t)(const unsigned char * src, char * dst, unsigned length);
+
+
+/*---------------- GLOBAL VARIABLES ------------------*/
+static hex_decoder_t hex_decoder = NULL;            // Selected hex decoder
+static checksum_function_t checksum_function = NULL;// Selected checksum calculation
+static hex_encoder_t hex_encoder = NULL;            // Selected hex encoder
+static const char * kernel_name = "scalar";         // Name of the selected decoder
+static const char * encoder_name = "scalar";        // Name of the selected encoder
+static unsigned char hex_values[256];               // Value of hex characters (0xFF = not a hex character)
+static const char hex_digits[] = "0123456789ABCDEF";// Characters for the hex encoding
+static INIT_ONCE kernels_init_once = INIT_ONCE_STATIC_INIT; // The kernels are selected once for all threads
+
+
+/*---------------- Local functions ---------------*/
+static BOOL CALLBACK select_kernels(PINIT_ONCE init_once, PVOID parameter, PVOID* context);
+static bool hex_to_bin_scalar(const char * src, unsigned char * dst, unsigned length);
+static unsigned char checksum_scalar(const char * data, unsigned length);
+static unsigned char bin_to_hex_scalar(const unsigned char * src, char * dst, unsigned length);
+#if HEX_CODEC_SIMD
+static bool avx2_supported(void);
+static bool hex_to_bin_sse2(const char * src, unsigned char * dst, unsigned length);
+static bool hex_to_bin_avx2(const char * src, unsigned char * dst, unsigned length);
+static unsigned char checksum_sse2(const char * data, unsigned length);
+static unsigned char checksum_avx2(const char * data, unsigned length);
+static unsigned char bin_to_hex_sse2(const unsigned char * src, char * dst, unsigned length);
+#endif
+
+
+/***
+ * @brief Convert two hexadecimal characters to their binary representation
+ *
+ * @param ptr Pointer to the hexadecimal string (must contain at least two characters)
+ *
+ * @return int The binary value if successful (0-255), or -1 if an error occurred
+ */
+
+int get_hex_digit(const char * ptr)
+{
+    if (ptr == NULL)
+    {
+        return -1;
+    }
+
+    int dec_val = 0;
+
+    for (int i = 0; i < 2; i++)
+    {
+        dec_val *= 16;
+
+        if ((*ptr >= '0') && (*ptr <= '9'))
+        {
+            dec_val += *ptr - '0';
+        }
+        else if ((*ptr >= 'A') && (*ptr <= 'F'))
+        {
+            dec_val += *ptr - 'A' + 10;
+        }
+        else if ((*ptr >= 'a') && (*ptr <= 'f'))
+        {
+            dec_val += *ptr - 'a' + 10;
+        }
+        else
+        {
+            return -1;
+        }
+
+        ptr++;
+    }
+    return dec_val;
+}
+
+
+/***
+ * @brief Select the hex decoder, encoder and checksum kernels and prepare the hex character
+ *        table. Must be called before the first use of the hex functions - it is called
+ *        by gdb_lib_init() before the data transfer threads are started. Further calls
+ *        (e.g. from several library threads) wait until the tables are ready.
+ */
+
+void hex_codec_init(void)
+{
+    (void)InitOnceExecuteOnce(&kernels_init_once, select_kernels, NULL, NULL);
+}
+
+
+/***
+ * @brief Convert a hex encoded string to binary data.
+ *        Upper and lower case hex characters are accepted.
+ *
+ * @param src     Hex encoded string (2 x length characters)
+ * @param dst     Buffer for the binary data
+ * @param length  Number of bytes to decode
+ *
+ * @return true  - data decoded
+ *         false - a character that is not a hex digit was found
+ */
+
+bool hex_to_bin(const char * src, unsigned char * dst, unsigned length)
+{
+    return hex_decoder(src, dst, length);
+}
+
+
+/***
+ * @brief Calculate the GDB message checksum (sum of all characters modulo 256).
+ *
+ * @param data    Pointer to the message data
+ * @param length  Number of characters
+ *
+ * @return Checksum value
+ */
+
+unsigned char calculate_checksum(const char * data, unsigned length)
+{
+    return checksum_function(data, length);
+}
+
+
+/***
+ * @brief Convert binary data to upper case hex characters and calculate the checksum
+ *        of the characters in the same pass.
+ *
+ * @param src     Binary data
+ * @param dst     Buffer for the hex characters (at least 2 x length characters)
+ * @param length  Number of bytes to encode
+ *
+ * @return Checksum of the hex characters written to the dst buffer
+ */
+
+unsigned char bin_to_hex(const unsigned char * src, char * dst, unsigned length)
+{
+    return hex_encoder(src, dst, length);
+}
+
+
+/***
+ * @brief Select the fastest version of the hex decoder and checksum calculation
+ *        supported by the CPU and prepare the hex character table.
+ *        Executed only once - see hex_codec_init().
+ *
+ * @param init_once  Not used
+ * @param parameter  Not used
+ * @param context    Not used
+ *
+ * @return TRUE - initialization done
+ */
+
+static BOOL CALLBACK select_kernels(PINIT_ONCE init_once, PVOID parameter, PVOID* context)
+{
+    (void)init_once;
+    (void)parameter;
+    (void)context;
+    memset(hex_values, 0xFF, sizeof(hex_values));
+
+    for (unsigned i = 0; i < 10U; i++)
+    {
+        hex_values['0' + i] = (unsigned char)i;
+    }
+
+    for (unsigned i = 0; i < 6U; i++)
+    {
+        hex_values['A' + i] = (unsigned char)(10U + i);
+        hex_values['a' + i] = (unsigned char)(10U + i);
+    }
+
+    hex_decoder = hex_to_bin_scalar;
+    checksum_function = checksum_scalar;
+    hex_encoder = bin_to_hex_scalar;
+    kernel_name = "scalar";
+    encoder_name = "scalar";
+
+#if HEX_CODEC_SIMD
+    int cpu_info[4];
+    __cpuid(cpu_info, 1);
+
+    if ((cpu_info[3] & (1 << 26)) != 0)     // SSE2
+    {
+        hex_decoder = hex_to_bin_sse2;
+        checksum_function = checksum_sse2;
+        hex_encoder = bin_to_hex_sse2;
+        kernel_name = "SSE2";
+        encoder_name = "SSE2";
+    }
+
+    if (avx2_supported())
+    {
+        hex_decoder = hex_to_bin_avx2;
+        checksum_function = checksum_avx2;
+        kernel_name = "AVX2";
+    }
+#endif
+
+    return TRUE;
+}
+
+
+/***
+ * @brief Table based (scalar) hex decoder.
+ *
+ * @param src     Hex encoded string (2 x length characters)
+ * @param dst     Buffer for the binary data
+ * @param length  Number of bytes to decode
+ *
+ * @return true  - data decoded
+ *         false - a character that is not a hex digit was found
+ */
+
+static bool hex_to_bin_scalar(const char * src, unsigned char * dst, unsigned length)
+{
+    const unsigned char * hex = (const unsigned char *)src;
+
+    for (unsigned i = 0; i < length; i++)
+    {
+        unsigned char high = hex_values[hex[0]];
+        unsigned char low = hex_values[hex[1]];
+
+        if ((high | low) > 0x0FU)
+        {
+            return false;
+        }
+
+        *dst++ = (unsigned char)((high << 4U) | low);
+        hex += 2;
+    }
+
+    return true;
+}
+
+
+/***
+ * @brief Calculate the GDB message checksum - scalar version.
+ *
+ * @param data    Pointer to the message data
+ * @param length  Number of characters
+ *
+ * @return Checksum value
+ */
+
+static unsigned char checksum_scalar(const char * data, unsigned length)
+{
+    unsigned char sum = 0;
+
+    for (unsigned i = 0; i < length; i++)
+    {
+        sum += (unsigned char)data[i];
+    }
+
+    return sum;
+}
+
+
+/***
+ * @brief Table based (scalar) hex encoder.
+ *
+ * @param src     Binary data
+ * @param dst     Buffer for the hex characters (at least 2 x length characters)
+ * @param length  Number of bytes to encode
+ *
+ * @return Checksum of the hex characters
+ */
+
+static unsigned char bin_to_hex_scalar(const unsigned char * src, char * dst, unsigned length)
+{
+    unsigned char sum = 0;
+
+    for (unsigned i = 0; i < length; i++)
+    {
+        const char high = hex_digits[src[i] >> 4U];
+        const char low = hex_digits[src[i] & 0x0FU];
+        *dst++ = high;
+        *dst++ = low;
+        sum += (unsigned char)(high + low);
+    }
+
+    return sum;
+}
+
+
+#if HEX_CODEC_SIMD
+
+/***
+ * @brief Check if the CPU and operating system support the AVX2 instructions.
+ *
+ * @return true if AVX2 can be used
+ */
+
+static bool avx2_supported(void)
+{
+    int cpu_info[4];
+    __cpuid(cpu_info, 0);
+
+    if (cpu_info[0] < 7)
+    {
+        return false;
+    }
+
+    __cpuid(cpu_info, 1);
+    const bool osxsave = (cpu_info[2] & (1 << 27)) != 0;
+    const bool avx = (cpu_info[2] & (1 << 28)) != 0;
+
+    if (!osxsave || !avx)
+    {
+        return false;
+    }
+
+    // The operating system must save the XMM and YMM registers
+    if ((_xgetbv(0) & 6U) != 6U)
+    {
+        return false;
+    }
+
+    __cpuidex(cpu_info, 7, 0);
+    return (cpu_info[1] & (1 << 5)) != 0;
+}
+
+
+/***
+ * @brief Convert 16 hex characters to nibble values (one nibble per byte).
+ *
+ * @param chars  16 hex characters
+ * @param valid  Set to a mask with 0xFF for each valid hex character
+ *
+ * @return Nibble values
+ */
+
+static inline __m128i hex_chars_to_nibbles_sse2(__m128i chars, __m128i * valid)
+{
+    const __m128i lower = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+    const __m128i is_digit = _mm_and_si128(
+        _mm_cmpgt_epi8(chars, _mm_set1_epi8('0' - 1)),
+        _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), chars));
+    const __m128i is_letter = _mm_and_si128(
+        _mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+        _mm_cmpgt_epi8(_mm_set1_epi8('f' + 1), lower));
+
+    const __m128i digit_value = _mm_and_si128(is_digit, _mm_sub_epi8(chars, _mm_set1_epi8('0')));
+    const __m128i letter_value = _mm_and_si128(is_letter, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10)));
+
+    *valid = _mm_or_si128(is_digit, is_letter);
+    return _mm_or_si128(digit_value, letter_value);
+}
+
+
+/***
+ * @brief SSE2 hex decoder - 16 characters are decoded in one step.
+ *
+ * @param src     Hex encoded string (2 x length characters)
+ * @param dst     Buffer for the binary data
+ * @param length  Number of bytes to decode
+ *
+ * @return true  - data decoded
+ *         false - a character that is not a hex digit was found
+ */
+
+static bool hex_to_bin_sse2(const char * src, unsigned char * dst, unsigned length)
+{
+    const __m128i low_byte_mask = _mm_set1_epi16(0x00FF);
+    unsigned i = 0;
+
+    for (; (i + 8U) <= length; i += 8U)
+    {
+        __m128i valid;
+        const __m128i chars = _mm_loadu_si128((const __m128i *)(src + 2U * i));
+        const __m128i nibbles = hex_chars_to_nibbles_sse2(chars, &valid);
+
+        if (_mm_movemask_epi8(valid) != 0xFFFF)
+        {
+            return false;
+        }
+
+        // The first character of a pair is in the low byte of a 16-bit word
+        const __m128i high = _mm_slli_epi16(_mm_and_si128(nibbles, low_byte_mask), 4);
+        const __m128i low = _mm_srli_epi16(nibbles, 8);
+        const __m128i bytes = _mm_packus_epi16(_mm_or_si128(high, low), _mm_setzero_si128());
+        _mm_storel_epi64((__m128i *)(dst + i), bytes);
+    }
+
+    return hex_to_bin_scalar(src + 2U * i, dst + i, length - i);
+}
+
+
+/***
+ * @brief AVX2 hex decoder - 32 characters are decoded in one step.
+ *
+ * @param src     Hex encoded string (2 x length characters)
+ * @param dst     Buffer for the binary data
+ * @param length  Number of bytes to decode
+ *
+ * @return true  - data decoded
+ *         false - a character that is not a hex digit was found
+ */
+
+static bool hex_to_bin_avx2(const char * src, unsigned char * dst, unsigned length)
+{
+    const __m256i low_byte_mask = _mm256_set1_epi16(0x00FF);
+    const __m256i lower_case = _mm256_set1_epi8(0x20);
+    unsigned i = 0;
+
+    for (; (i + 16U) <= length; i += 16U)
+    {
+        const __m256i chars = _mm256_loadu_si256((const __m256i *)(src + 2U * i));
+        const __m256i lower = _mm256_or_si256(chars, lower_case);
+        const __m256i is_digit = _mm256_and_si256(
+            _mm256_cmpgt_epi8(chars, _mm256_set1_epi8('0' - 1)),
+            _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), chars));
+        const __m256i is_letter = _mm256_and_si256(
+            _mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+            _mm256_cmpgt_epi8(_mm256_set1_epi8('f' + 1), lower));
+
+        if (_mm256_movemask_epi8(_mm256_or_si256(is_digit, is_letter)) != -1)
+        {
+            return false;
+        }
+
+        const __m256i nibbles = _mm256_or_si256(
+            _mm256_and_si256(is_digit, _mm256_sub_epi8(chars, _mm256_set1_epi8('0'))),
+            _mm256_and_si256(is_letter, _mm256_sub_epi8(lower, _mm256_set1_epi8('a' - 10))));
+
+        const __m256i high = _mm256_slli_epi16(_mm256_and_si256(nibbles, low_byte_mask), 4);
+        const __m256i low = _mm256_srli_epi16(nibbles, 8);
+        const __m256i packed = _mm256_packus_epi16(_mm256_or_si256(high, low), _mm256_setzero_si256());
+
+        // The packing works within 128-bit lanes - move the second result next to the first one
+        const __m256i bytes = _mm256_permute4x64_epi64(packed, 0x08);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm256_castsi256_si128(bytes));
+    }
+
+    return hex_to_bin_sse2(src + 2U * i, dst + i, length - i);
+}
+
+
+/***
+ * @brief Calculate the GDB message checksum - SSE2 version.
+ *
+ * @param data    Pointer to the message data
+ * @param length  Number of characters
+ *
+ * @return Checksum value
+ */
+
+static unsigned char checksum_sse2(const char * data, unsigned length)
+{
+    __m128i sum = _mm_setzero_si128();
+    unsigned i = 0;
+
+    for (; (i + 16U) <= length; i += 16U)
+    {
+        const __m128i chars = _mm_loadu_si128((const __m128i *)(data + i));
+        sum = _mm_add_epi64(sum, _mm_sad_epu8(chars, _mm_setzero_si128()));
+    }
+
+    unsigned total = (unsigned)_mm_cvtsi128_si32(sum)
+        + (unsigned)_mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+
+    return (unsigned char)(total + checksum_scalar(data + i, length - i));
+}
+
+
+/***
+ * @brief Calculate the GDB message checksum - AVX2 version.
+ *
+ * @param data    Pointer to the message data
+ * @param length  Number of characters
+ *
+ * @return Checksum value
+ */
+
+static unsigned char checksum_avx2(const char * data, unsigned length)
+{
+    __m256i sum = _mm256_setzero_si256();
+    unsigned i = 0;
+
+    for (; (i + 32U) <= length; i += 32U)
+    {
+        const __m256i chars = _mm256_loadu_si256((const __m256i *)(data + i));
+        sum = _mm256_add_epi64(sum, _mm256_sad_epu8(chars, _mm256_setzero_si256()));
+    }
+
+    const __m128i sum128 = _mm_add_epi64(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    unsigned total = (unsigned)_mm_cvtsi128_si32(sum128)
+        + (unsigned)_mm_cvtsi128_si32(_mm_srli_si128(sum128, 8));
+
+    return (unsigned char)(total + checksum_sse2(data + i, length - i));
+}
+
+
+/***
+ * @brief Convert 16 nibble values (one per byte) to upper case hex characters.
+ *
+ * @param nibbles  Nibble values (0 ... 15)
+ *
+ * @return Hex characters
+ */
+
+static inline __m128i nibbles_to_hex_chars_sse2(__m128i nibbles)
+{
+    const __m128i letter = _mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9));
+    const __m128i chars = _mm_add_epi8(nibbles, _mm_set1_epi8('0'));
+    return _mm_add_epi8(chars, _mm_and_si128(letter, _mm_set1_epi8('A' - '9' - 1)));
+}
+
+
+/***
+ * @brief SSE2 hex encoder - 16 bytes are encoded in one step.
+ *        The checksum is accumulated from the encoded characters.
+ *
+ * @param src     Binary data
+ * @param dst     Buffer for the hex characters (at least 2 x length characters)
+ * @param length  Number of bytes to encode
+ *
+ * @return Checksum of the hex characters
+ */
+
+static unsigned char bin_to_hex_sse2(const unsigned char * src, char * dst, unsigned length)
+{
+    const __m128i nibble_mask = _mm_set1_epi8(0x0F);
+    __m128i sum = _mm_setzero_si128();
+    unsigned i = 0;
+
+    for (; (i + 16U) <= length; i += 16U)
+    {
+        const __m128i bytes = _mm_loadu_si128((const __m128i *)(src + i));
+        const __m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), nibble_mask);
+        const __m128i low = _mm_and_si128(bytes, nibble_mask);
+
+        // The high nibble is the first character of a pair
+        const __m128i chars_0 = nibbles_to_hex_chars_sse2(_mm_unpacklo_epi8(high, low));
+        const __m128i chars_1 = nibbles_to_hex_chars_sse2(_mm_unpackhi_epi8(high, low));
+        _mm_storeu_si128((__m128i *)(dst + 2U * i), chars_0);
+        _mm_storeu_si128((__m128i *)(dst + 2U * i + 16U), chars_1);
+
+        sum = _mm_add_epi64(sum, _mm_sad_epu8(chars_0, _mm_setzero_si128()));
+        sum = _mm_add_epi64(sum, _mm_sad_epu8(chars_1, _mm_setzero_si128()));
+    }
+
+    unsigned total = (unsigned)_mm_cvtsi128_si32(sum)
+        + (unsigned)_mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+
+    return (unsigned char)(total + bin_to_hex_scalar(src + i, dst + 2U * i, length - i));
+}
+
+#endif  // HEX_CODEC_SIMD
+
+
+/***
+ * @brief Compare the speed of the hex decoder and checksum calculation with the
+ *        character-by-character decoding with get_hex_digit(). Random upper and
+ *        lower case hex data is used. The hex encoder is compared with the
+ *        encoding with sprintf_s(). The results are printed to the console.
+ */
+
+void benchmark_hex_decoding(void)
+{
+    const unsigned hex_length = 2U * HEX_BENCHMARK_SIZE;
+    char * hex_data = (char *)malloc(hex_length);
+    unsigned char * reference = (unsigned char *)malloc(HEX_BENCHMARK_SIZE);
+    unsigned char * decoded = (unsigned char *)malloc(HEX_BENCHMARK_SIZE);
+    char * encoded = (char *)malloc(hex_length + 1U);
+
+    if ((hex_data == NULL) || (reference == NULL) || (decoded == NULL) || (encoded == NULL))
+    {
+        printf("\nCould not allocate memory for the benchmark.");
+        free(hex_data);
+        free(reference);
+        free(decoded);
+        free(encoded);
+        return;
+    }
+
+    static const char hex_chars[] = "0123456789abcdefABCDEF";
+    srand(1234U);
+
+    for (unsigned i = 0; i < hex_length; i++)
+    {
+        hex_data[i] = hex_chars[rand() % (sizeof(hex_chars) - 1U)];
+    }
+
+    printf("\n\nHex decoding benchmark (%u kB of data, %s decoder):", HEX_BENCHMARK_SIZE / 1024U, kernel_name);
+
+    // Reference - decoding with get_hex_digit() and scalar checksum calculation
+    LARGE_INTEGER start_time;
+    start_timer(&start_time);
+    unsigned char reference_sum = 0;
+
+    for (unsigned n = 0; n < HEX_BENCHMARK_REPEAT; n++)
+    {
+        for (unsigned i = 0; i < hex_length; i++)
+        {
+            reference_sum += (unsigned char)hex_data[i];
+        }
+
+        for (unsigned i = 0; i < HEX_BENCHMARK_SIZE; i++)
+        {
+            reference[i] = (unsigned char)get_hex_digit(&hex_data[2U * i]);
+        }
+    }
+
+    double reference_time = time_elapsed(&start_time);
+
+    // Selected decoder and checksum calculation
+    start_timer(&start_time);
+    unsigned char sum = 0;
+    bool decoded_ok = true;
+
+    for (unsigned n = 0; n < HEX_BENCHMARK_REPEAT; n++)
+    {
+        sum += calculate_checksum(hex_data, hex_length);
+        decoded_ok &= hex_to_bin(hex_data, decoded, HEX_BENCHMARK_SIZE);
+    }
+
+    double decoder_time = time_elapsed(&start_time);
+    const double data_size_mb = (double)HEX_BENCHMARK_SIZE * HEX_BENCHMARK_REPEAT / (1024. * 1024.);
+
+    printf("\n   get_hex_digit(): %.1f ms (%.1f MB/s)", reference_time, data_size_mb / reference_time * 1e3);
+    printf("\n   %s decoder: %.1f ms (%.1f MB/s), %.1f times faster",
+        kernel_name, decoder_time, data_size_mb / decoder_time * 1e3, reference_time / decoder_time);
+
+    if (!decoded_ok || (sum != reference_sum)
+        || (memcmp(reference, decoded, HEX_BENCHMARK_SIZE) != 0))
+    {
+        printf("\n   Error: the results of the decoders are not the same!");
+    }
+
+    // Reference - encoding with sprintf_s() and a separate checksum calculation
+    printf("\nHex encoding benchmark (%u kB of data, %s encoder):", HEX_BENCHMARK_SIZE / 1024U, encoder_name);
+    start_timer(&start_time);
+    reference_sum = 0;
+
+    for (unsigned n = 0; n < HEX_BENCHMARK_REPEAT; n++)
+    {
+        for (unsigned i = 0; i < HEX_BENCHMARK_SIZE; i++)
+        {
+            sprintf_s(&encoded[2U * i], hex_length + 1U - 2U * i, "%02X", reference[i]);
+        }
+
+        for (unsigned i = 0; i < hex_length; i++)
+        {
+            reference_sum += (unsigned char)encoded[i];
+        }
+    }
+
+    reference_time = time_elapsed(&start_time);
+
+    // Selected encoder with the checksum calculated in the same pass
+    start_timer(&start_time);
+    sum = 0;
+
+    for (unsigned n = 0; n < HEX_BENCHMARK_REPEAT; n++)
+    {
+        sum += bin_to_hex(reference, hex_data, HEX_BENCHMARK_SIZE);
+    }
+
+    double encoder_time = time_elapsed(&start_time);
+
+    printf("\n   sprintf_s(): %.1f ms (%.1f MB/s)", reference_time, data_size_mb / reference_time * 1e3);
+    printf("\n   %s encoder: %.1f ms (%.1f MB/s), %.1f times faster",
+        encoder_name, encoder_time, data_size_mb / encoder_time * 1e3, reference_time / encoder_time);
+
+    if ((sum != reference_sum) || (memcmp(hex_data, encoded, hex_length) != 0))
+    {
+        printf("\n   Error: the results of the encoders are not the same!");
+    }
+
+    printf("\n");
+    free(hex_data);
+    free(reference);
+    free(decoded);
+    free(encoded);
+}
+
+/*==== End of file ====*/
@@ -0,0 +1,22 @@
+/*
+ * Copyright (c) 2024 Branko Premzel.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * @file    hex_codec.h
+ * @brief   Hex encoding / decoding and checksum functions for the GDB messages.
+ * @author  B. Premzel
+ */
+
+#pragma once
+
+void hex_codec_init(void);
+int  get_hex_digit(const char * ptr);
+bool hex_to_bin(const char * src, unsigned char * dst, unsigned length);
+unsigned char calculate_checksum(const char * data, unsigned length);
+unsigned char bin_to_hex(const unsigned char * src, char * dst, unsigned length);
+void benchmark_hex_decoding(void);
+
+/*==== End of file ====*/
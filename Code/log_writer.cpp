@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2024 Branko Premzel.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * @file    log_writer.cpp
+ * @brief   Buffered file output written by a background thread (-debug and -capture arguments).
+ * @author  B. Premzel
+ *
+ * The data is copied to one of two memory buffers. The full buffer is handed over to the
+ * writer thread, which writes it to the file while the next buffer is being filled.
+ * The writer thread also takes over the partly filled buffer after LOG_WRITER_FLUSH_MS,
+ * so that the file contents lag behind by a fraction of a second only.
+ * The caller thus does not wait for the file write and flush after every message,
+ * which slowed down the data transfer considerably with the -debug argument.
+ *
+ * Each writer is used by one thread only (the logging state is thread local).
+ */
+
+#include "pch.h"
+#include <stdlib.h>
+#include <string.h>
+#include <process.h>
+#include "RTEgdbData.h"
+#include "log_writer.h"
+
+
+struct log_writer_s
+{
+    FILE* file;                     // Output file
+    HANDLE thread;                  // Writer thread
+    HANDLE work_event;              // Auto-reset event - buffer handed over or stop requested
+    HANDLE idle_event;              // Manual-reset event - the writer thread has no buffer to write
+    CRITICAL_SECTION lock;          // Protects the variables below
+    char* buffers[2];               // Buffers filled alternately
+    unsigned active;                // Index of the buffer being filled
+    unsigned length;                // Number of bytes in the active buffer
+    char* write_buffer;             // Buffer written by the writer thread
+    unsigned write_length;          // Number of bytes to write (0 - nothing to write)
+    bool stop;                      // true - write the remaining data and exit
+};
+
+
+/*---------------- Local functions ---------------*/
+static unsigned __stdcall writer_thread_function(void* arg);
+static void hand_over_active_buffer(log_writer_t* writer);
+static void free_writer(log_writer_t* writer);
+
+
+/***
+ * @brief Allocate the buffers and start the writer thread.
+ *
+ * @param file  File to which the data will be written
+ *
+ * @return Pointer to the writer, NULL - writer could not be started
+ */
+
+log_writer_t* log_writer_start(FILE* file)
+{
+    log_writer_t* writer = (log_writer_t*)calloc(1, sizeof(log_writer_t));
+    if (writer == NULL)
+    {
+        return NULL;
+    }
+
+    writer->file = file;
+    writer->buffers[0] = (char*)malloc(LOG_WRITER_BUFFER_SIZE);
+    writer->buffers[1] = (char*)malloc(LOG_WRITER_BUFFER_SIZE);
+    writer->work_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+    writer->idle_event = CreateEvent(NULL, TRUE, TRUE, NULL);
+    InitializeCriticalSection(&writer->lock);
+
+    if ((writer->buffers[0] != NULL) && (writer->buffers[1] != NULL)
+        && (writer->work_event != NULL) && (writer->idle_event != NULL))
+    {
+        writer->thread = (HANDLE)_beginthreadex(NULL, 0, writer_thread_function, writer, 0, NULL);
+    }
+
+    if (writer->thread == NULL)
+    {
+        free_writer(writer);
+        return NULL;
+    }
+
+    return writer;
+}
+
+
+/***
+ * @brief Copy the data to the buffer. The caller waits only if both buffers are full.
+ *
+ * @param writer  Writer
+ * @param data    Data to be written
+ * @param length  Number of bytes
+ */
+
+void log_writer_write(log_writer_t* writer, const void* data, unsigned length)
+{
+    const char* src = (const char*)data;
+    EnterCriticalSection(&writer->lock);
+
+    while (length > 0)
+    {
+        if (writer->length >= LOG_WRITER_BUFFER_SIZE)
+        {
+            hand_over_active_buffer(writer);
+        }
+
+        unsigned chunk = LOG_WRITER_BUFFER_SIZE - writer->length;
+        if (chunk > length)
+        {
+            chunk = length;
+        }
+
+        memcpy(&writer->buffers[writer->active][writer->length], src, chunk);
+        writer->length += chunk;
+        src += chunk;
+        length -= chunk;
+    }
+
+    LeaveCriticalSection(&writer->lock);
+}
+
+
+/***
+ * @brief Write the remaining data and stop the writer thread.
+ *        The file is not closed.
+ *
+ * @param writer  Writer (NULL - not started)
+ */
+
+void log_writer_stop(log_writer_t* writer)
+{
+    if (writer == NULL)
+    {
+        return;
+    }
+
+    EnterCriticalSection(&writer->lock);
+    writer->stop = true;
+    LeaveCriticalSection(&writer->lock);
+    (void)SetEvent(writer->work_event);
+    (void)WaitForSingleObject(writer->thread, INFINITE);
+    free_writer(writer);
+}
+
+
+/***
+ * @brief Hand over the active buffer to the writer thread after the previous one has been
+ *        written. Must be called with the lock taken.
+ *
+ * @param writer  Writer
+ */
+
+static void hand_over_active_buffer(log_writer_t* writer)
+{
+    while (writer->write_length != 0)
+    {
+        LeaveCriticalSection(&writer->lock);
+        (void)WaitForSingleObject(writer->idle_event, INFINITE);
+        EnterCriticalSection(&writer->lock);
+    }
+
+    writer->write_buffer = writer->buffers[writer->active];
+    writer->write_length = writer->length;
+    writer->active ^= 1U;
+    writer->length = 0;
+    (void)ResetEvent(writer->idle_event);
+    (void)SetEvent(writer->work_event);
+}
+
+
+/***
+ * @brief Writer thread - write the handed over buffers to the file. The partly filled
+ *        buffer is taken over if nothing has been handed over for LOG_WRITER_FLUSH_MS.
+ *
+ * @param arg  Writer
+ *
+ * @return 0
+ */
+
+static unsigned __stdcall writer_thread_function(void* arg)
+{
+    log_writer_t* writer = (log_writer_t*)arg;
+
+    for (;;)
+    {
+        (void)WaitForSingleObject(writer->work_event, LOG_WRITER_FLUSH_MS);
+
+        EnterCriticalSection(&writer->lock);
+
+        if ((writer->write_length == 0) && (writer->length > 0))
+        {
+            hand_over_active_buffer(writer);
+        }
+
+        const char* buffer = writer->write_buffer;
+        unsigned length = writer->write_length;
+        bool stop = writer->stop;
+        LeaveCriticalSection(&writer->lock);
+
+        if (length == 0)
+        {
+            if (stop)
+            {
+                break;
+            }
+
+            continue;
+        }
+
+        (void)fwrite(buffer, 1, length, writer->file);
+        (void)fflush(writer->file);
+
+        EnterCriticalSection(&writer->lock);
+        writer->write_length = 0;
+        (void)SetEvent(writer->idle_event);
+        LeaveCriticalSection(&writer->lock);
+    }
+
+    return 0;
+}
+
+
+/***
+ * @brief Release the buffers, events and the writer structure.
+ *
+ * @param writer  Writer
+ */
+
+static void free_writer(log_writer_t* writer)
+{
+    if (writer->thread != NULL)
+    {
+        (void)CloseHandle(writer->thread);
+    }
+
+    if (writer->work_event != NULL)
+    {
+        (void)CloseHandle(writer->work_event);
+    }
+
+    if (writer->idle_event != NULL)
+    {
+        (void)CloseHandle(writer->idle_event);
+    }
+
+    DeleteCriticalSection(&writer->lock);
+    free(writer->buffers[0]);
+    free(writer->buffers[1]);
+    free(writer);
+}
+
+/*==== End of file ====*/
@@ -0,0 +1,22 @@
+/*
+ * Copyright (c) 2024 Branko Premzel.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * @file    log_writer.h
+ * @brief   Buffered file output written by a background thread (-debug and -capture arguments).
+ * @author  B. Premzel
+ */
+
+#pragma once
+#include <stdio.h>
+
+typedef struct log_writer_s log_writer_t;
+
+log_writer_t* log_writer_start(FILE* file);
+void log_writer_write(log_writer_t* writer, const void* data, unsigned length);
+void log_writer_stop(log_writer_t* writer);
+
+/*==== End of file ====*/
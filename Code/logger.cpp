@@ -17,13 +17,23 @@
 #include "gdb_defs.h"
 #include "gdb_lib.h"
 #include "cmd_line.h"
+#include "log_writer.h"
+#include "packet_capture.h"
 #include <share.h>
+#include <stdarg.h>
 
 
 /*---------------- GLOBAL VARIABLES ------------------*/
-static FILE * log_output = stdout;      // File to which the messages will be logged (default = console)
-static bool logging_enabled = true;     // false - do not log any information
-static LARGE_INTEGER Frequency;         // Frequency of the performance counter
+// Each thread has its own log output (see -targets argument)
+static thread_local FILE * log_output = stdout; // File to which the messages will be logged (default = console)
+static thread_local bool logging_enabled = true; // false - do not log any information
+static thread_local LARGE_INTEGER Frequency;     // Frequency of the performance counter
+static thread_local log_writer_t* log_writer = NULL; // Background writer of the log file (-debug), NULL - not used
+
+
+/*---------------- Local functions ---------------*/
+static void log_printf(const char* format, ...);
+static void stop_log_writer(void);
 
 
 /***
@@ -84,6 +94,108 @@ void create_log_file(const char * file_name)
 }
 
 
+/***
+ * @brief Start the background writer of the log file if all communication with the GDB server
+ *        is logged (-debug) and start the binary capture (-capture=file).
+ *        Must be called after the log file has been created.
+ */
+
+void start_communication_logging(void)
+{
+    if (parameters.log_gdb_communication && logging_to_file() && (log_writer == NULL))
+    {
+        log_writer = log_writer_start(log_output);
+
+        if (log_writer == NULL)
+        {
+            log_string("\nCould not start the log writer thread - logging directly.", NULL);
+        }
+    }
+
+    if (parameters.capture_file != NULL)
+    {
+        (void)capture_start(parameters.capture_file);
+    }
+}
+
+
+/***
+ * @brief Write the remaining buffered data, stop the capture and close the log file.
+ */
+
+void close_log_file(void)
+{
+    stop_log_writer();
+    capture_stop();
+
+    if (logging_to_file())
+    {
+        (void)fclose(log_output);
+        log_output = stdout;
+    }
+}
+
+
+/***
+ * @brief Stop the background writer of the log file after the remaining data has been written.
+ */
+
+static void stop_log_writer(void)
+{
+    log_writer_stop(log_writer);
+    log_writer = NULL;
+}
+
+
+/***
+ * @brief Write the formatted text to the log output - with the background writer
+ *        if it is active, otherwise directly (the log file is flushed).
+ *
+ * @param format  Format string
+ */
+
+static void log_printf(const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+
+    if (log_writer != NULL)
+    {
+        char text[1024];
+        int length = vsnprintf(text, sizeof(text), format, args);
+
+        if ((length >= 0) && ((size_t)length < sizeof(text)))
+        {
+            log_writer_write(log_writer, text, (unsigned)length);
+        }
+        else if (length > 0)
+        {
+            // Longer text - e.g. a complete message received from the GDB server
+            char* long_text = (char*)malloc((size_t)length + 1U);
+            if (long_text != NULL)
+            {
+                va_end(args);
+                va_start(args, format);
+                (void)vsnprintf(long_text, (size_t)length + 1U, format, args);
+                log_writer_write(log_writer, long_text, (unsigned)length);
+                free(long_text);
+            }
+        }
+    }
+    else
+    {
+        (void)vfprintf(log_output, format, args);
+
+        if (logging_to_file())
+        {
+            fflush(log_output);
+        }
+    }
+
+    va_end(args);
+}
+
+
 /***
  * @brief Record the starting time.
  * 
@@ -108,12 +220,7 @@ void log_data(const char * text, long long int data)
 {
     if (logging_enabled)
     {
-        fprintf(log_output, text, data);
-
-        if (logging_to_file())
-        {
-            fflush(log_output);
-        }
+        log_printf(text, data);
     }
 }
 
@@ -131,16 +238,11 @@ void log_string(const char * text, const char * string)
     {
         if (string != NULL)
         {
-            fprintf(log_output, text, string);
+            log_printf(text, string);
         }
         else
         {
-            fprintf(log_output, text);
-        }
-
-        if (logging_to_file())
-        {
-            fflush(log_output);
+            log_printf(text);
         }
     }
 }
@@ -166,12 +268,7 @@ void log_timing(const char * text, LARGE_INTEGER * start_timer)
         double time_elapsed = (double)elapsed.QuadPart * 1e3 / (double)Frequency.QuadPart;
         
         // Log the elapsed time with the provided text message
-        fprintf(log_output, text, time_elapsed);
-
-        if (logging_to_file())
-        {
-            fflush(log_output);
-        }
+        log_printf(text, time_elapsed);
     }
 }
 
@@ -191,51 +288,46 @@ void log_wsock_error(const char * text)
 
     // Get the last socket error
     int sock_err = GetLastError();
-    fprintf(log_output, "%s - Winsock error %d", text, sock_err);
+    log_printf("%s - Winsock error %d", text, sock_err);
 
     // Log specific error messages based on the error code
     switch (sock_err)
     {
     case WSAETIMEDOUT:
-        fprintf(log_output, " - (time-out). ");
+        log_printf(" - (time-out). ");
         break;
 
     case WSAECONNRESET:
-        fprintf(log_output, " - (an existing connection was forcibly closed). ");
+        log_printf(" - (an existing connection was forcibly closed). ");
         break;
 
     case WSAECONNABORTED:
-        fprintf(log_output, " - (an established connection was aborted). ");
+        log_printf(" - (an established connection was aborted). ");
         break;
 
     case WSAECONNREFUSED:
-        fprintf(log_output, " - (connection refused - i.e. no service at this port). ");
+        log_printf(" - (connection refused - i.e. no service at this port). ");
         break;
 
     case WSAEADDRINUSE:
-        fprintf(log_output, " - (only one usage of each socket address (protocol/network address/port) is normally permitted).");
+        log_printf(" - (only one usage of each socket address (protocol/network address/port) is normally permitted).");
         break;
 
     case WSAENETUNREACH:
-        fprintf(log_output, " - (a socket operation was attempted to an unreachable network). ");
+        log_printf(" - (a socket operation was attempted to an unreachable network). ");
         break;
 
     case WSAEISCONN:
-        fprintf(log_output, " - (a connect request was made on an already connected socket). ");
+        log_printf(" - (a connect request was made on an already connected socket). ");
         break;
 
     case WSAEHOSTDOWN:
-        fprintf(log_output, " - (a socket operation failed because the destination host was down). ");
+        log_printf(" - (a socket operation failed because the destination host was down). ");
         break;
 
     default:
         break;
     }
-
-    if (logging_to_file())
-    {
-        fflush(log_output);
-    }
 }
 
 
@@ -271,15 +363,25 @@ double time_elapsed(LARGE_INTEGER * start_timer)
 
 void log_communication(const char* direction, const char* msg, int length)
 {
-    if (parameters.log_gdb_communication)
+    capture_packet(direction, msg, length);
+
+    if (!parameters.log_gdb_communication)
     {
-        fprintf(log_output, "\n%6.3f ms [%s: %.*s]\n",
-            (double)(clock_ms() - app_start_time) / CLOCKS_PER_SEC * 1000, direction, length, msg);
+        return;
+    }
 
-        if (logging_to_file())
-        {
-            fflush(log_output);
-        }
+    double time = (double)(clock_ms() - app_start_time) / CLOCKS_PER_SEC * 1000;
+
+    if ((log_writer != NULL) && (length > 0))
+    {
+        // The message is copied to the buffer without formatting
+        log_printf("\n%6.3f ms [%s: ", time, direction);
+        log_writer_write(log_writer, msg, (unsigned)length);
+        log_printf("]\n");
+    }
+    else
+    {
+        log_printf("\n%6.3f ms [%s: %.*s]\n", time, direction, length, msg);
     }
 }
 
@@ -298,6 +400,7 @@ void disable_enable_logging_to_file(void)
 
     if (logging_to_file())
     {
+        stop_log_writer();
         fflush(log_output);
         fclose(log_output);
         log_output = stdout;
@@ -306,6 +409,12 @@ void disable_enable_logging_to_file(void)
     else
     {
         create_log_file(parameters.log_file);
+
+        if (parameters.log_gdb_communication && logging_to_file())
+        {
+            log_writer = log_writer_start(log_output);
+        }
+
         printf("\nLogging to file enabled.\n");
     }
 }
@@ -18,6 +18,8 @@
 
 void enable_logging(bool on_off);
 void create_log_file(const char* file_name);
+void start_communication_logging(void);
+void close_log_file(void);
 void start_timer(LARGE_INTEGER * start_timer);
 void log_data(const char * text, long long int data);
 void log_string(const char * text, const char * string);
@@ -0,0 +1,1056 @@
+/*
+ * Copyright (c) 2024 Branko Premzel.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * @file    mock_server.cpp
+ * @brief   Mock GDB server for RTEgdbData tests and benchmarks without a debug probe (RTEgdbMock.exe).
+ * @author  B. Premzel
+ *
+ * The mock server serves the memory image loaded from a file (e.g. a g_rtedbg structure
+ * saved by RTEgdbData) with the subset of the GDB remote serial protocol used by RTEgdbData:
+ * qSupported, QStartNoAckMode, m/M, x/X, qCRC, qRcmd, ? and D. Memory writes change the image,
+ * so the message filter writes and the circular buffer clear work as with a real target.
+ * The delay of the debug probe and embedded system is simulated with a fixed latency
+ * for each reply and a limited bandwidth.
+ *
+ * In the replay mode, a recorded session (RTEgdbData -capture=file) is played back.
+ * The data received from the client replaces the recorded requests and the recorded
+ * replies are sent with the recorded timing (or the -latency/-bandwidth timing if set).
+ *
+ * Usage: RTEgdbMock port image_file hex_address [-latency=us] [-bandwidth=kB/s]
+ *                   [-packet=size] [-noprefix] [-hex]
+ *        RTEgdbMock port -replay=capture_file [-latency=us] [-bandwidth=kB/s]
+ *
+ * Only one client is served at a time. The server waits for the next client after
+ * the previous one has disconnected. Press Ctrl+C to exit.
+ */
+
+#pragma comment(lib, "Ws2_32.lib")   // Link additional libraries
+
+#include "pch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <WinSock2.h>
+#include <Windows.h>
+#include "packet_capture.h"
+
+
+#define MOCK_DEFAULT_PACKET_SIZE 0x4000U    // Default PacketSize reported in the capability data
+#define MOCK_MAX_PACKET_SIZE (1024U * 1024U) // Max. packet size (-packet argument)
+#define MOCK_RECV_TIMEOUT_MS 10000          // Max. time to wait for the recorded request in the replay mode
+#define MOCK_MAX_IMAGE_SIZE (256U * 1024U * 1024U) // Max. size of the memory image
+
+typedef struct
+{
+    unsigned short port;                    // Port number of the mock server
+    const char* image_file;                 // File with the memory image
+    unsigned address;                       // Address of the memory image
+    unsigned latency_us;                    // Delay before each reply [us]
+    unsigned bandwidth_kBps;                // Max. data rate of the replies [kB/s] (0 - unlimited)
+    unsigned packet_size;                   // PacketSize reported in the capability data
+    bool binary_prefix;                     // true - 'x' replies start with 'b', binary-upload+ reported
+    bool hex_only;                          // true - 'x' and 'X' packets not supported
+    const char* replay_file;                // Capture file played back (NULL - serve the memory image)
+} mock_parameters_t;
+
+
+/*---------------- GLOBAL VARIABLES ------------------*/
+static mock_parameters_t mock;              // Command line parameters
+static unsigned char* image = NULL;         // Memory image
+static unsigned image_size = 0;             // Size of the memory image [bytes]
+static SOCKET client = INVALID_SOCKET;      // Connection to the client (RTEgdbData)
+static bool ack_mode = true;                // true - received packets are acknowledged with '+'
+static char* packet = NULL;                 // Received packet (payload only)
+static char* reply = NULL;                  // Reply payload
+static char* frame = NULL;                  // Reply with the '$', '#' and checksum
+static unsigned buffer_size = 0;            // Size of the buffers above
+static char recv_buffer[64U * 1024U];       // Data received from the client
+static unsigned recv_length = 0;            // Number of bytes in the recv_buffer
+static unsigned recv_index = 0;             // Index of the next byte to be processed
+static LARGE_INTEGER frequency;             // Frequency of the performance counter
+
+
+/*---------------- Local functions ---------------*/
+static void process_arguments(int argc, char* argv[]);
+static void show_usage_and_exit(void);
+static bool load_image(void);
+static SOCKET open_listen_socket(void);
+static void serve_client(void);
+static int  receive_packet(void);
+static int  next_char(void);
+static bool handle_packet(unsigned length);
+static void send_reply(const char* payload, unsigned length);
+static void send_text_reply(const char* text);
+static void handle_read(const char* request, bool binary);
+static void handle_write(char* request, unsigned length, bool binary);
+static void handle_crc(const char* request);
+static unsigned char* image_pointer(unsigned address, unsigned length);
+static unsigned escape_binary(const unsigned char* src, unsigned length, char* dst);
+static unsigned unescape_binary(const char* src, unsigned length, unsigned char* dst);
+static void simulate_link_delay(unsigned length, LARGE_INTEGER* request_time);
+static void wait_until(const LARGE_INTEGER* time);
+static void replay_session(void);
+static unsigned char* load_capture_file(unsigned* size);
+static unsigned mock_crc32(const unsigned char* data, unsigned length);
+
+
+/***
+ * @brief Main function
+ *
+ * @param argc Number of command line parameters (including the APP full path name)
+ * @param argv Array of pointers to the command line parameter strings
+ *
+ * @return 0 - OK
+ *         1 - error occurred
+ */
+
+int __cdecl main(int argc, char* argv[])
+{
+    process_arguments(argc, argv);
+    (void)QueryPerformanceFrequency(&frequency);
+
+    if ((mock.replay_file == NULL) && !load_image())
+    {
+        return 1;
+    }
+
+    buffer_size = 2U * mock.packet_size + 16U;
+    packet = (char*)malloc(buffer_size);
+    reply = (char*)malloc(buffer_size);
+    frame = (char*)malloc(buffer_size + 4U);
+
+    if ((packet == NULL) || (reply == NULL) || (frame == NULL))
+    {
+        printf("\nCould not allocate memory buffer.\n");
+        return 1;
+    }
+
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != NO_ERROR)
+    {
+        printf("\nWinsock startup error.\n");
+        return 1;
+    }
+
+    SOCKET listen_socket = open_listen_socket();
+    if (listen_socket == INVALID_SOCKET)
+    {
+        (void)WSACleanup();
+        return 1;
+    }
+
+    for (;;)
+    {
+        printf("\nWaiting for the client on port %u ...", mock.port);
+        client = accept(listen_socket, NULL, NULL);
+
+        if (client == INVALID_SOCKET)
+        {
+            printf("\nAccept error %d.\n", WSAGetLastError());
+            break;
+        }
+
+        BOOL no_delay = TRUE;
+        (void)setsockopt(client, IPPROTO_TCP, TCP_NODELAY, (const char*)&no_delay, sizeof(no_delay));
+        printf("\nClient connected.");
+
+        ack_mode = true;
+        recv_length = 0;
+        recv_index = 0;
+
+        if (mock.replay_file != NULL)
+        {
+            replay_session();
+        }
+        else
+        {
+            serve_client();
+        }
+
+        (void)closesocket(client);
+        client = INVALID_SOCKET;
+        printf("\nClient disconnected.");
+    }
+
+    (void)closesocket(listen_socket);
+    (void)WSACleanup();
+    return 1;
+}
+
+
+/***
+ * @brief Process the command line arguments.
+ *
+ * @param argc Number of command line parameters
+ * @param argv Array of pointers to the command line parameter strings
+ */
+
+static void process_arguments(int argc, char* argv[])
+{
+    memset(&mock, 0, sizeof(mock));
+    mock.packet_size = MOCK_DEFAULT_PACKET_SIZE;
+    mock.binary_prefix = true;
+
+    if (argc < 3)
+    {
+        show_usage_and_exit();
+    }
+
+    mock.port = (unsigned short)atoi(argv[1]);
+    if (mock.port == 0)
+    {
+        show_usage_and_exit();
+    }
+
+    int i = 2;
+    if (strncmp(argv[2], "-replay=", 8) != 0)
+    {
+        if ((argc < 4) || (sscanf_s(argv[3], "%x", &mock.address) != 1))
+        {
+            show_usage_and_exit();
+        }
+
+        mock.image_file = argv[2];
+        i = 4;
+    }
+
+    for (; i < argc; i++)
+    {
+        const char* arg = argv[i];
+
+        if (strncmp(arg, "-replay=", 8) == 0)
+        {
+            mock.replay_file = &arg[8];
+        }
+        else if (strncmp(arg, "-latency=", 9) == 0)
+        {
+            mock.latency_us = (unsigned)atoi(&arg[9]);
+        }
+        else if (strncmp(arg, "-bandwidth=", 11) == 0)
+        {
+            mock.bandwidth_kBps = (unsigned)atoi(&arg[11]);
+        }
+        else if (strncmp(arg, "-packet=", 8) == 0)
+        {
+            mock.packet_size = (unsigned)atoi(&arg[8]);
+
+            if ((mock.packet_size < 256U) || (mock.packet_size > MOCK_MAX_PACKET_SIZE))
+            {
+                printf("The -packet=size value must be between 256 and %u.", MOCK_MAX_PACKET_SIZE);
+                exit(1);
+            }
+        }
+        else if (strcmp(arg, "-noprefix") == 0)
+        {
+            mock.binary_prefix = false;
+        }
+        else if (strcmp(arg, "-hex") == 0)
+        {
+            mock.hex_only = true;
+        }
+        else
+        {
+            printf("Incorrect parameter: '%s'", arg);
+            show_usage_and_exit();
+        }
+    }
+}
+
+
+/***
+ * @brief Print the command line arguments and exit.
+ */
+
+static void show_usage_and_exit(void)
+{
+    printf(
+        "\nMock GDB server for RTEgdbData tests and benchmarks."
+        "\nUsage: RTEgdbMock port image_file hex_address [options]"
+        "\n       RTEgdbMock port -replay=capture_file [-latency=us] [-bandwidth=kB/s]"
+        "\nOptions:"
+        "\n   -latency=us      Delay before each reply [us]."
+        "\n   -bandwidth=kB/s  Max. data rate of the replies."
+        "\n   -packet=size     PacketSize reported in the capability data (default %u)."
+        "\n   -noprefix        Binary read replies without the 'b' prefix (binary-upload+ not reported)."
+        "\n   -hex             Binary memory read and write packets not supported."
+        "\n   -replay=file     Play back a session recorded with RTEgdbData -capture=file."
+        "\n",
+        MOCK_DEFAULT_PACKET_SIZE);
+    exit(1);
+}
+
+
+/***
+ * @brief Load the memory image.
+ *
+ * @return true - image loaded
+ */
+
+static bool load_image(void)
+{
+    FILE* file;
+    if ((fopen_s(&file, mock.image_file, "rb") != 0) || (file == NULL))
+    {
+        printf("\nCould not open the image file: %s.\n", mock.image_file);
+        return false;
+    }
+
+    (void)fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    rewind(file);
+
+    if ((size <= 0) || ((unsigned long)size > MOCK_MAX_IMAGE_SIZE))
+    {
+        printf("\nIncorrect size of the image file: %s.\n", mock.image_file);
+        (void)fclose(file);
+        return false;
+    }
+
+    image_size = (unsigned)size;
+    image = (unsigned char*)malloc(image_size);
+
+    if ((image == NULL) || (fread(image, 1, image_size, file) != image_size))
+    {
+        printf("\nCould not read the image file: %s.\n", mock.image_file);
+        (void)fclose(file);
+        return false;
+    }
+
+    (void)fclose(file);
+    printf("\nImage '%s': %u bytes at address 0x%08X.", mock.image_file, image_size, mock.address);
+    return true;
+}
+
+
+/***
+ * @brief Create the socket and listen for the client connections.
+ *
+ * @return Listening socket, INVALID_SOCKET - error
+ */
+
+static SOCKET open_listen_socket(void)
+{
+    SOCKET listen_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listen_socket == INVALID_SOCKET)
+    {
+        printf("\nCannot create socket - error %d.\n", WSAGetLastError());
+        return INVALID_SOCKET;
+    }
+
+    sockaddr_in service;
+    memset(&service, 0, sizeof(service));
+    service.sin_family = AF_INET;
+    service.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    service.sin_port = htons(mock.port);
+
+    if ((bind(listen_socket, (SOCKADDR*)&service, sizeof(service)) == SOCKET_ERROR)
+        || (listen(listen_socket, 1) == SOCKET_ERROR))
+    {
+        printf("\nCannot listen on port %u - error %d.\n", mock.port, WSAGetLastError());
+        (void)closesocket(listen_socket);
+        return INVALID_SOCKET;
+    }
+
+    return listen_socket;
+}
+
+
+/***
+ * @brief Serve the client until it detaches or disconnects.
+ */
+
+static void serve_client(void)
+{
+    for (;;)
+    {
+        int length = receive_packet();
+        if (length < 0)
+        {
+            break;      // Connection closed
+        }
+
+        if (!handle_packet((unsigned)length))
+        {
+            break;      // Detached
+        }
+    }
+}
+
+
+/***
+ * @brief Receive the next packet. The acknowledge characters are skipped.
+ *        The packet is acknowledged if the no-ACK mode is not active.
+ *        The checksum is not checked (TCP connection to the local host).
+ *
+ * @return Payload length, -1 - connection closed or packet too long
+ */
+
+static int receive_packet(void)
+{
+    int c;
+
+    do
+    {
+        c = next_char();
+        if (c < 0)
+        {
+            return -1;
+        }
+    }
+    while (c != '$');
+
+    unsigned length = 0;
+
+    for (;;)
+    {
+        c = next_char();
+        if (c < 0)
+        {
+            return -1;
+        }
+
+        if (c == '#')
+        {
+            break;
+        }
+
+        if (length >= (buffer_size - 1U))
+        {
+            printf("\nPacket too long.");
+            return -1;
+        }
+
+        packet[length++] = (char)c;
+    }
+
+    if ((next_char() < 0) || (next_char() < 0))     // Checksum
+    {
+        return -1;
+    }
+
+    packet[length] = '\0';
+
+    if (ack_mode)
+    {
+        (void)send(client, "+", 1, 0);
+    }
+
+    return (int)length;
+}
+
+
+/***
+ * @brief Get the next character received from the client.
+ *
+ * @return Character, -1 - connection closed
+ */
+
+static int next_char(void)
+{
+    if (recv_index >= recv_length)
+    {
+        int res = recv(client, recv_buffer, sizeof(recv_buffer), 0);
+        if (res <= 0)
+        {
+            return -1;
+        }
+
+        recv_length = (unsigned)res;
+        recv_index = 0;
+    }
+
+    return (unsigned char)recv_buffer[recv_index++];
+}
+
+
+/***
+ * @brief Execute the request and send the reply.
+ *
+ * @param length  Payload length
+ *
+ * @return false - client detached, the connection must be closed
+ */
+
+static bool handle_packet(unsigned length)
+{
+    switch (packet[0])
+    {
+    case 'm':
+        handle_read(&packet[1], false);
+        break;
+
+    case 'x':
+        if (mock.hex_only)
+        {
+            send_text_reply("");
+        }
+        else
+        {
+            handle_read(&packet[1], true);
+        }
+        break;
+
+    case 'M':
+        handle_write(packet, length, false);
+        break;
+
+    case 'X':
+        if (mock.hex_only)
+        {
+            send_text_reply("");
+        }
+        else
+        {
+            handle_write(packet, length, true);
+        }
+        break;
+
+    case '?':
+        send_text_reply("S05");
+        break;
+
+    case 'D':
+        send_text_reply("OK");
+        return false;
+
+    case 'k':
+        return false;
+
+    case 'q':
+        if (strncmp(packet, "qSupported", 10) == 0)
+        {
+            char capabilities[128];
+            sprintf_s(capabilities, sizeof(capabilities), "PacketSize=%x;QStartNoAckMode+%s",
+                mock.packet_size, (mock.binary_prefix && !mock.hex_only) ? ";binary-upload+" : "");
+            send_text_reply(capabilities);
+        }
+        else if (strncmp(packet, "qCRC:", 5) == 0)
+        {
+            handle_crc(&packet[5]);
+        }
+        else if (strncmp(packet, "qRcmd,", 6) == 0)
+        {
+            send_text_reply("OK");      // Monitor commands are accepted but not executed
+        }
+        else
+        {
+            send_text_reply("");
+        }
+        break;
+
+    case 'Q':
+        if (strcmp(packet, "QStartNoAckMode") == 0)
+        {
+            send_text_reply("OK");
+            ack_mode = false;
+        }
+        else
+        {
+            send_text_reply("");
+        }
+        break;
+
+    default:
+        send_text_reply("");            // Not supported
+        break;
+    }
+
+    return true;
+}
+
+
+/***
+ * @brief Send the reply after the simulated delay.
+ *
+ * @param payload  Reply payload
+ * @param length   Payload length
+ */
+
+static void send_reply(const char* payload, unsigned length)
+{
+    LARGE_INTEGER request_time;
+    (void)QueryPerformanceCounter(&request_time);
+
+    unsigned char checksum = 0;
+    for (unsigned i = 0; i < length; i++)
+    {
+        checksum += (unsigned char)payload[i];
+    }
+
+    frame[0] = '$';
+    memcpy(&frame[1], payload, length);
+    sprintf_s(&frame[length + 1U], 4U, "#%02x", checksum);
+
+    simulate_link_delay(length + 4U, &request_time);
+    (void)send(client, frame, (int)(length + 4U), 0);
+}
+
+
+/***
+ * @brief Send a text reply.
+ *
+ * @param text  Reply payload
+ */
+
+static void send_text_reply(const char* text)
+{
+    send_reply(text, (unsigned)strlen(text));
+}
+
+
+/***
+ * @brief Read the memory image - "maddr,length" or "xaddr,length" request.
+ *
+ * @param request  Request without the packet type
+ * @param binary   true - binary reply ('x' packet)
+ */
+
+static void handle_read(const char* request, bool binary)
+{
+    unsigned address;
+    unsigned length;
+
+    if (sscanf_s(request, "%x,%x", &address, &length) != 2)
+    {
+        send_text_reply("E01");
+        return;
+    }
+
+    unsigned max_length = binary ? ((mock.packet_size - 1U) / 2U) : (mock.packet_size / 2U);
+    if (length > max_length)
+    {
+        length = max_length;            // Short reply - the client requests the rest again
+    }
+
+    const unsigned char* data = image_pointer(address, length);
+    if (data == NULL)
+    {
+        send_text_reply("E14");
+        return;
+    }
+
+    unsigned reply_length = 0;
+
+    if (binary)
+    {
+        if (mock.binary_prefix)
+        {
+            reply[reply_length++] = 'b';
+        }
+
+        reply_length += escape_binary(data, length, &reply[reply_length]);
+    }
+    else
+    {
+        static const char hex_digits[] = "0123456789abcdef";
+
+        for (unsigned i = 0; i < length; i++)
+        {
+            reply[reply_length++] = hex_digits[data[i] >> 4U];
+            reply[reply_length++] = hex_digits[data[i] & 0x0FU];
+        }
+    }
+
+    send_reply(reply, reply_length);
+}
+
+
+/***
+ * @brief Write to the memory image - "Maddr,length:XX..." or "Xaddr,length:binary" request.
+ *
+ * @param request  Complete request
+ * @param length   Request length
+ * @param binary   true - binary data ('X' packet)
+ */
+
+static void handle_write(char* request, unsigned length, bool binary)
+{
+    unsigned address;
+    unsigned size;
+    char* data = (char*)memchr(request, ':', length);
+
+    if ((data == NULL) || (sscanf_s(&request[1], "%x,%x", &address, &size) != 2))
+    {
+        send_text_reply("E01");
+        return;
+    }
+
+    data++;
+    unsigned data_length = length - (unsigned)(data - request);
+    unsigned char* dst = image_pointer(address, size);
+
+    if ((dst == NULL) && (size > 0))
+    {
+        send_text_reply("E14");
+        return;
+    }
+
+    if (binary)
+    {
+        if (unescape_binary(data, data_length, (unsigned char*)reply) != size)
+        {
+            send_text_reply("E02");
+            return;
+        }
+
+        memcpy(dst, reply, size);
+    }
+    else
+    {
+        if (data_length != (2U * size))
+        {
+            send_text_reply("E02");
+            return;
+        }
+
+        for (unsigned i = 0; i < size; i++)
+        {
+            char hex[3] = { data[2U * i], data[2U * i + 1U], '\0' };
+            dst[i] = (unsigned char)strtoul(hex, NULL, 16);
+        }
+    }
+
+    send_text_reply("OK");
+}
+
+
+/***
+ * @brief Calculate the CRC of the memory image part - "qCRC:addr,length" request.
+ *
+ * @param request  Request parameters
+ */
+
+static void handle_crc(const char* request)
+{
+    unsigned address;
+    unsigned length;
+
+    if (sscanf_s(request, "%x,%x", &address, &length) != 2)
+    {
+        send_text_reply("E01");
+        return;
+    }
+
+    const unsigned char* data = image_pointer(address, length);
+    if (data == NULL)
+    {
+        send_text_reply("E14");
+        return;
+    }
+
+    char text[16];
+    sprintf_s(text, sizeof(text), "C%08x", mock_crc32(data, length));
+    send_text_reply(text);
+}
+
+
+/***
+ * @brief Get the pointer to the memory image part.
+ *
+ * @param address  Address of the memory block
+ * @param length   Length of the memory block
+ *
+ * @return Pointer to the data, NULL - block not inside the image
+ */
+
+static unsigned char* image_pointer(unsigned address, unsigned length)
+{
+    if ((address < mock.address) || ((uint64_t)address - mock.address + length > image_size))
+    {
+        return NULL;
+    }
+
+    return &image[address - mock.address];
+}
+
+
+/***
+ * @brief Escape the binary data - '#', '$', '}' and '*' are sent as '}' and the character XOR 0x20.
+ *
+ * @param src     Binary data
+ * @param length  Data length
+ * @param dst     Buffer for the escaped data (2 x length bytes)
+ *
+ * @return Length of the escaped data
+ */
+
+static unsigned escape_binary(const unsigned char* src, unsigned length, char* dst)
+{
+    unsigned out = 0;
+
+    for (unsigned i = 0; i < length; i++)
+    {
+        unsigned char c = src[i];
+
+        if ((c == '#') || (c == '$') || (c == '}') || (c == '*'))
+        {
+            dst[out++] = '}';
+            c ^= 0x20U;
+        }
+
+        dst[out++] = (char)c;
+    }
+
+    return out;
+}
+
+
+/***
+ * @brief Decode the escaped binary data of the 'X' packet.
+ *
+ * @param src     Escaped data
+ * @param length  Length of the escaped data
+ * @param dst     Buffer for the decoded data
+ *
+ * @return Length of the decoded data
+ */
+
+static unsigned unescape_binary(const char* src, unsigned length, unsigned char* dst)
+{
+    unsigned out = 0;
+
+    for (unsigned i = 0; i < length; i++)
+    {
+        unsigned char c = (unsigned char)src[i];
+
+        if ((c == '}') && ((i + 1U) < length))
+        {
+            c = (unsigned char)(src[++i] ^ 0x20);
+        }
+
+        dst[out++] = c;
+    }
+
+    return out;
+}
+
+
+/***
+ * @brief Wait for the simulated latency and the transfer time of the reply.
+ *
+ * @param length        Reply length [bytes]
+ * @param request_time  Time at which the request has been received
+ */
+
+static void simulate_link_delay(unsigned length, LARGE_INTEGER* request_time)
+{
+    double delay_us = (double)mock.latency_us;
+
+    if (mock.bandwidth_kBps > 0)
+    {
+        delay_us += (double)length * 1000.0 / (double)mock.bandwidth_kBps;
+    }
+
+    if (delay_us <= 0)
+    {
+        return;
+    }
+
+    LARGE_INTEGER end_time;
+    end_time.QuadPart = request_time->QuadPart + (LONGLONG)(delay_us * (double)frequency.QuadPart / 1e6);
+    wait_until(&end_time);
+}
+
+
+/***
+ * @brief Wait until the performance counter reaches the time. Sleep() is used for
+ *        the longer waits and the rest is waited actively (1 ms Sleep() resolution).
+ *
+ * @param time  Performance counter value
+ */
+
+static void wait_until(const LARGE_INTEGER* time)
+{
+    for (;;)
+    {
+        LARGE_INTEGER now;
+        (void)QueryPerformanceCounter(&now);
+        LONGLONG remaining = time->QuadPart - now.QuadPart;
+
+        if (remaining <= 0)
+        {
+            break;
+        }
+
+        if (remaining > (frequency.QuadPart / 500))     // More than 2 ms
+        {
+            Sleep(1);
+        }
+    }
+}
+
+
+/***
+ * @brief Play back the recorded session. The data sent by the client is received
+ *        instead of the recorded requests (the contents are only compared) and the
+ *        recorded replies are sent with the recorded delay after the requests.
+ */
+
+static void replay_session(void)
+{
+    unsigned size = 0;
+    unsigned char* capture = load_capture_file(&size);
+    if (capture == NULL)
+    {
+        return;
+    }
+
+    bool reported = false;
+    unsigned record_number = 0;
+    uint64_t last_time_us = 0;
+    LARGE_INTEGER last_event;
+    (void)QueryPerformanceCounter(&last_event);
+
+    for (unsigned offset = sizeof(capture_file_header_t); (offset + sizeof(capture_record_t)) <= size; )
+    {
+        capture_record_t record;
+        memcpy(&record, &capture[offset], sizeof(record));
+        unsigned length = record.info & CAPTURE_MAX_LENGTH;
+        const unsigned char* data = &capture[offset + sizeof(record)];
+        uint64_t time_us = ((uint64_t)record.time_high << 32U) | record.time_low;
+        offset += sizeof(record) + length;
+        record_number++;
+
+        if (offset > size)
+        {
+            break;      // Incomplete record
+        }
+
+        switch ((capture_direction_t)(record.info >> CAPTURE_DIRECTION_SHIFT))
+        {
+        case CAPTURE_SEND:
+            // Receive the same number of bytes as the client sent in the recorded session
+            for (unsigned i = 0; i < length; i++)
+            {
+                int c = next_char();
+                if (c < 0)
+                {
+                    free(capture);
+                    return;
+                }
+
+                if (((unsigned char)c != data[i]) && !reported)
+                {
+                    printf("\nThe requests differ from the recorded ones from record %u on.", record_number);
+                    reported = true;
+                }
+            }
+
+            (void)QueryPerformanceCounter(&last_event);
+            last_time_us = time_us;
+            break;
+
+        case CAPTURE_RECV:
+            if ((mock.latency_us > 0) || (mock.bandwidth_kBps > 0))
+            {
+                LARGE_INTEGER now;
+                (void)QueryPerformanceCounter(&now);
+                simulate_link_delay(length, &now);
+            }
+            else
+            {
+                LARGE_INTEGER send_time;
+                send_time.QuadPart = last_event.QuadPart
+                    + (LONGLONG)((double)(time_us - last_time_us) * (double)frequency.QuadPart / 1e6);
+                wait_until(&send_time);
+            }
+
+            (void)send(client, (const char*)data, (int)length, 0);
+            (void)QueryPerformanceCounter(&last_event);
+            last_time_us = time_us;
+            break;
+
+        default:
+            break;      // The discarded data has already been recorded as received
+        }
+    }
+
+    printf("\nReplay of %u records completed.", record_number);
+    free(capture);
+}
+
+
+/***
+ * @brief Load the capture file defined with the -replay argument.
+ *
+ * @param size  Size of the loaded file
+ *
+ * @return File contents, NULL - file could not be loaded
+ */
+
+static unsigned char* load_capture_file(unsigned* size)
+{
+    FILE* file;
+    if ((fopen_s(&file, mock.replay_file, "rb") != 0) || (file == NULL))
+    {
+        printf("\nCould not open the capture file: %s.\n", mock.replay_file);
+        return NULL;
+    }
+
+    (void)fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    rewind(file);
+
+    unsigned char* capture = NULL;
+
+    if ((file_size >= (long)sizeof(capture_file_header_t)) && ((unsigned long)file_size <= MOCK_MAX_IMAGE_SIZE))
+    {
+        capture = (unsigned char*)malloc((size_t)file_size);
+    }
+
+    if ((capture == NULL) || (fread(capture, 1, (size_t)file_size, file) != (size_t)file_size))
+    {
+        printf("\nCould not read the capture file: %s.\n", mock.replay_file);
+        free(capture);
+        (void)fclose(file);
+        return NULL;
+    }
+
+    (void)fclose(file);
+
+    const capture_file_header_t* header = (const capture_file_header_t*)capture;
+    if ((memcmp(header->id, CAPTURE_FILE_ID, sizeof(header->id)) != 0) || (header->version != CAPTURE_FILE_VERSION))
+    {
+        printf("\n'%s' is not a capture file.\n", mock.replay_file);
+        free(capture);
+        return NULL;
+    }
+
+    *size = (unsigned)file_size;
+    return capture;
+}
+
+
+/***
+ * @brief Calculate the CRC-32 as the GDB qCRC request (polynomial 0x04C11DB7, initial value
+ *        0xFFFFFFFF, no reflection and no final XOR) - the same as gdb_crc32() of RTEgdbData.
+ *
+ * @param data    Data
+ * @param length  Data length
+ *
+ * @return CRC value
+ */
+
+static unsigned mock_crc32(const unsigned char* data, unsigned length)
+{
+    unsigned crc = 0xFFFFFFFFU;
+
+    for (unsigned i = 0; i < length; i++)
+    {
+        crc ^= (unsigned)data[i] << 24U;
+
+        for (unsigned bit = 0; bit < 8U; bit++)
+        {
+            crc = (crc & 0x80000000U) ? ((crc << 1U) ^ 0x04C11DB7U) : (crc << 1U);
+        }
+    }
+
+    return crc;
+}
+
+/*==== End of file ====*/
@@ -0,0 +1,292 @@
+/*
+ * Copyright (c) 2024 Branko Premzel.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * @file    multi_target.cpp
+ * @brief   Parallel data transfer from several embedded systems (-targets argument).
+ * @author  B. Premzel
+ *
+ * Every embedded system (the one defined with the port number and -ip argument and the
+ * ones defined with the -targets argument) is accessed by its own thread with its own
+ * GDB server session, so that the data of all systems is captured almost at the same time.
+ * The threads use a copy of the command line parameters with the port number, IP address
+ * and the file names of their target. The target number is added to the binary and
+ * log file names (and to the -capture file name) - e.g. data_1.bin, data_2.bin, ...
+ *
+ * The -decode batch file is started for each target after all the transfers have been
+ * completed. The binary file name is added to the command line of the batch file.
+ */
+
+#include "pch.h"
+#include <stdlib.h>
+#include <string.h>
+#include <process.h>
+#include "gdb_lib.h"
+#include "RTEgdbData.h"
+#include "cmd_line.h"
+#include "logger.h"
+#include "multi_target.h"
+#include "parallel_read.h"
+
+
+typedef struct
+{
+    parameters_t parameters;            // Parameters of the target thread
+    char bin_file_name[MAX_PATH];       // Binary file name with the target number
+    char log_file_name[MAX_PATH];       // Log file name with the target number
+    char capture_file_name[MAX_PATH];   // Capture file name with the target number
+    HANDLE thread;                      // Thread transferring the data (NULL - not started)
+    int result;                         // 0 - data transferred, 1 - error occurred
+    unsigned error;                     // Last GDB error reported by the target session
+    long transfer_time;                 // Time used for the connection and data transfer [ms]
+} target_job_t;
+
+
+/*---------------- Local functions ---------------*/
+static void prepare_target_job(target_job_t* job, unsigned index);
+static void numbered_file_name(char* name, size_t size, const char* file_name, unsigned number);
+static unsigned __stdcall target_thread_function(void* arg);
+static int  print_target_results(const target_job_t* jobs, unsigned count);
+static void decode_target_data(const target_job_t* job);
+
+
+/***
+ * @brief Transfer the data from all embedded systems in parallel - one thread per target.
+ *
+ * @return 0 - data transferred from all targets
+ *         1 - error occurred
+ */
+
+int multi_target_transfer(void)
+{
+    const unsigned count = parameters.target_count + 1U;
+    target_job_t* jobs = (target_job_t*)calloc(count, sizeof(target_job_t));
+    if (jobs == NULL)
+    {
+        log_string("\nCould not allocate memory buffer.", NULL);
+        return 1;
+    }
+
+    printf("\nReading from %u embedded systems ... ", count);
+    clock_t start_time = clock_ms();
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        prepare_target_job(&jobs[i], i);
+        jobs[i].thread = (HANDLE)_beginthreadex(NULL, 0, target_thread_function, &jobs[i], 0, NULL);
+
+        if (jobs[i].thread == NULL)
+        {
+            log_data("\nCould not start the data transfer thread for target %llu.", (long long)(i + 1U));
+        }
+    }
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (jobs[i].thread != NULL)
+        {
+            (void)WaitForSingleObject(jobs[i].thread, INFINITE);
+            (void)CloseHandle(jobs[i].thread);
+        }
+    }
+
+    long total_time = clock_ms() - start_time;
+    int rez = print_target_results(jobs, count);
+    printf("\nTotal time: %ld ms\n", total_time);
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (jobs[i].result == 0)
+        {
+            decode_target_data(&jobs[i]);
+        }
+    }
+
+    free(jobs);
+    return rez;
+}
+
+
+/***
+ * @brief Prepare the parameters for the target thread.
+ *
+ * @param job    Target job data
+ * @param index  Target index (0 - target defined with the port number and -ip argument)
+ */
+
+static void prepare_target_job(target_job_t* job, unsigned index)
+{
+    job->parameters = parameters;
+    job->parameters.target_count = 0;
+    job->result = 1;
+
+    if (index > 0)
+    {
+        job->parameters.gdb_port = parameters.targets[index - 1U].gdb_port;
+        job->parameters.ip_address = parameters.targets[index - 1U].ip_address;
+    }
+
+    numbered_file_name(job->bin_file_name, sizeof(job->bin_file_name), parameters.bin_file_name, index + 1U);
+    job->parameters.bin_file_name = job->bin_file_name;
+
+    if (parameters.log_file != NULL)
+    {
+        numbered_file_name(job->log_file_name, sizeof(job->log_file_name), parameters.log_file, index + 1U);
+        job->parameters.log_file = job->log_file_name;
+    }
+
+    if (parameters.capture_file != NULL)
+    {
+        numbered_file_name(job->capture_file_name, sizeof(job->capture_file_name), parameters.capture_file, index + 1U);
+        job->parameters.capture_file = job->capture_file_name;
+    }
+}
+
+
+/***
+ * @brief Add the target number to the file name (before the file name extension).
+ *
+ * @param name       Buffer for the new file name
+ * @param size       Size of the buffer
+ * @param file_name  Original file name
+ * @param number     Target number
+ */
+
+static void numbered_file_name(char* name, size_t size, const char* file_name, unsigned number)
+{
+    const char* extension = strrchr(file_name, '.');
+    const char* last_slash = strrchr(file_name, '\\');
+
+    if (last_slash == NULL)
+    {
+        last_slash = strrchr(file_name, '/');
+    }
+
+    if ((extension == NULL) || ((last_slash != NULL) && (extension < last_slash)))
+    {
+        extension = file_name + strlen(file_name);      // No file name extension
+    }
+
+    sprintf_s(name, size, "%.*s_%u%s", (int)(extension - file_name), file_name, number, extension);
+}
+
+
+/***
+ * @brief Target thread - connect to the GDB server and transfer the data.
+ *        The messages are written to the target's log file. Without the -log argument
+ *        the logging is disabled because the messages of the threads would be mixed.
+ *
+ * @param arg  Target job data
+ *
+ * @return 0
+ */
+
+static unsigned __stdcall target_thread_function(void* arg)
+{
+    target_job_t* job = (target_job_t*)arg;
+    parameters = job->parameters;
+
+    if (parameters.log_file != NULL)
+    {
+        create_log_file(parameters.log_file);
+    }
+    else
+    {
+        enable_logging(false);
+    }
+
+    start_communication_logging();
+    clock_t start_time = clock_ms();
+
+    if (gdb_connect(parameters.gdb_port) == GDB_OK)
+    {
+        if (gdb_send_commands_from_file(parameters.start_cmd_file) == 0)
+        {
+            parallel_read_start();
+
+            if (data_transfer_cycle(NULL) == GDB_OK)
+            {
+                job->result = 0;
+            }
+        }
+
+        parallel_read_stop();
+        gdb_detach();
+        gdb_socket_cleanup();
+    }
+
+    job->error = last_gdb_error;
+    job->transfer_time = clock_ms() - start_time;
+
+    gdb_session_release();
+    free_rtedbg_structure_memory();
+    close_log_file();
+    return 0;
+}
+
+
+/***
+ * @brief Print the data transfer result of each target.
+ *
+ * @param jobs   Target job data
+ * @param count  Number of targets
+ *
+ * @return 0 - data transferred from all targets
+ *         1 - error occurred
+ */
+
+static int print_target_results(const target_job_t* jobs, unsigned count)
+{
+    int rez = 0;
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        const target_job_t* job = &jobs[i];
+        printf("\n%2u: %s:%u - ", i + 1U, job->parameters.ip_address, job->parameters.gdb_port);
+
+        if (job->result == 0)
+        {
+            printf("data written to \"%s\" (%ld ms)", job->bin_file_name, job->transfer_time);
+            continue;
+        }
+
+        rez = 1;
+        printf("data transfer failed (error %u)", job->error);
+
+        if (job->parameters.log_file != NULL)
+        {
+            printf(" - check the log file \"%s\" for details", job->parameters.log_file);
+        }
+    }
+
+    return rez;
+}
+
+
+/***
+ * @brief Start the -decode=name batch file with the binary file name as the argument.
+ *
+ * @param job  Target job data
+ */
+
+static void decode_target_data(const target_job_t* job)
+{
+    if (parameters.decode_file == NULL)
+    {
+        return;
+    }
+
+    char command[2U * MAX_PATH + 4U];
+    sprintf_s(command, sizeof(command), "%s %s", parameters.decode_file, job->bin_file_name);
+    printf("\nStarting the batch file: %s", command);
+
+    if (system(command) != 0)
+    {
+        printf("\nThe '%s' batch file could not be started!", parameters.decode_file);
+    }
+}
+
+/*==== End of file ====*/
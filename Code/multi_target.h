@@ -0,0 +1,17 @@
+/*
+ * Copyright (c) 2024 Branko Premzel.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * @file    multi_target.h
+ * @brief   Parallel data transfer from several embedded systems (-targets argument).
+ * @author  B. Premzel
+ */
+
+#pragma once
+
+int multi_target_transfer(void);
+
+/*==== End of file ====*/
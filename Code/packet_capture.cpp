@@ -0,0 +1,276 @@
+/*
+ * Copyright (c) 2024 Branko Premzel.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * @file    packet_capture.cpp
+ * @brief   Binary capture of the GDB server communication (-capture and -convert arguments).
+ * @author  B. Premzel
+ *
+ * All data sent to and received from the GDB server is written to the capture file
+ * without any formatting. The file starts with the capture_file_header_t followed by
+ * records - a capture_record_t and the raw bytes of the sent or received data:
+ *
+ *    time_low, time_high - time since the start of the capture [us]
+ *    info                - bits 0...29: data length, bits 30...31: direction (capture_direction_t)
+ *
+ * The data is written by the background log writer (see log_writer.cpp), so that
+ * the capture of the complete communication slows down the data transfer only slightly.
+ * Use the -convert=capture_file argument to convert the capture file to text.
+ */
+
+#include "pch.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "gdb_lib.h"
+#include "RTEgdbData.h"
+#include "cmd_line.h"
+#include "logger.h"
+#include "log_writer.h"
+#include "packet_capture.h"
+
+
+/*---------------- GLOBAL VARIABLES ------------------*/
+// Each thread has its own capture file (see -targets argument)
+static thread_local FILE* capture_file = NULL;            // Capture file (NULL - capture not active)
+static thread_local log_writer_t* capture_writer = NULL;  // Background writer (NULL - written directly)
+static thread_local LARGE_INTEGER capture_start_time;     // Performance counter value at the capture start
+static thread_local LARGE_INTEGER capture_frequency;      // Frequency of the performance counter
+
+
+/*---------------- Local functions ---------------*/
+static void write_capture_data(const void* data, unsigned length);
+static void convert_record(FILE* out, const capture_record_t* record, const unsigned char* data);
+
+
+/***
+ * @brief Create the capture file and start the background writer.
+ *
+ * @param file_name  Capture file name
+ *
+ * @return true - capture started
+ */
+
+bool capture_start(const char* file_name)
+{
+    capture_stop();
+
+    if ((fopen_s(&capture_file, file_name, "wb") != 0) || (capture_file == NULL))
+    {
+        capture_file = NULL;
+        log_string("\nCould not create the capture file: %s.", file_name);
+        return false;
+    }
+
+    (void)QueryPerformanceFrequency(&capture_frequency);
+    (void)QueryPerformanceCounter(&capture_start_time);
+    capture_writer = log_writer_start(capture_file);
+
+    capture_file_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.id, CAPTURE_FILE_ID, sizeof(header.id));
+    header.version = CAPTURE_FILE_VERSION;
+    write_capture_data(&header, sizeof(header));
+
+    return true;
+}
+
+
+/***
+ * @brief Write the data sent to or received from the GDB server to the capture file.
+ *
+ * @param direction  Direction of communication ("Send", "Recv" or "Discarded")
+ * @param msg        Data sent to or received from the GDB server
+ * @param length     Data length
+ */
+
+void capture_packet(const char* direction, const char* msg, int length)
+{
+    if ((capture_file == NULL) || (length <= 0))
+    {
+        return;
+    }
+
+    LARGE_INTEGER now;
+    (void)QueryPerformanceCounter(&now);
+    uint64_t ticks = (uint64_t)(now.QuadPart - capture_start_time.QuadPart);
+    uint64_t frequency = (uint64_t)capture_frequency.QuadPart;
+    uint64_t time_us = (ticks / frequency) * 1000000U + ((ticks % frequency) * 1000000U) / frequency;
+
+    capture_direction_t dir = CAPTURE_SEND;
+    if (direction[0] == 'R')
+    {
+        dir = CAPTURE_RECV;
+    }
+    else if (direction[0] == 'D')
+    {
+        dir = CAPTURE_DISCARDED;
+    }
+
+    unsigned data_length = ((unsigned)length > CAPTURE_MAX_LENGTH) ? CAPTURE_MAX_LENGTH : (unsigned)length;
+
+    capture_record_t record;
+    record.time_low = (uint32_t)time_us;
+    record.time_high = (uint32_t)(time_us >> 32U);
+    record.info = data_length | ((uint32_t)dir << CAPTURE_DIRECTION_SHIFT);
+
+    write_capture_data(&record, sizeof(record));
+    write_capture_data(msg, data_length);
+}
+
+
+/***
+ * @brief Write the remaining data and close the capture file.
+ */
+
+void capture_stop(void)
+{
+    if (capture_file == NULL)
+    {
+        return;
+    }
+
+    log_writer_stop(capture_writer);
+    capture_writer = NULL;
+    (void)fclose(capture_file);
+    capture_file = NULL;
+}
+
+
+/***
+ * @brief Write the data with the background writer or directly if it could not be started.
+ *
+ * @param data    Data to be written
+ * @param length  Number of bytes
+ */
+
+static void write_capture_data(const void* data, unsigned length)
+{
+    if (capture_writer != NULL)
+    {
+        log_writer_write(capture_writer, data, length);
+    }
+    else
+    {
+        (void)fwrite(data, 1, length, capture_file);
+    }
+}
+
+
+/***
+ * @brief Convert the capture file defined with the -convert=name argument to text.
+ *        The text is written to the file with the ".txt" extension added to the name.
+ *        The format is the same as with the -debug argument.
+ *
+ * @return 0 - file converted
+ *         1 - error occurred
+ */
+
+int capture_convert(void)
+{
+    FILE* in;
+    if ((fopen_s(&in, parameters.convert_file, "rb") != 0) || (in == NULL))
+    {
+        printf("\nCould not open the capture file: %s.\n", parameters.convert_file);
+        return 1;
+    }
+
+    capture_file_header_t header;
+    if ((fread(&header, sizeof(header), 1, in) != 1)
+        || (memcmp(header.id, CAPTURE_FILE_ID, sizeof(header.id)) != 0)
+        || (header.version != CAPTURE_FILE_VERSION))
+    {
+        printf("\n'%s' is not a capture file.\n", parameters.convert_file);
+        (void)fclose(in);
+        return 1;
+    }
+
+    char out_name[MAX_PATH];
+    sprintf_s(out_name, sizeof(out_name), "%s.txt", parameters.convert_file);
+
+    FILE* out;
+    if ((fopen_s(&out, out_name, "w") != 0) || (out == NULL))
+    {
+        printf("\nCould not create the file: %s.\n", out_name);
+        (void)fclose(in);
+        return 1;
+    }
+
+    int rez = 0;
+    unsigned count = 0;
+    unsigned char* data = NULL;
+    unsigned data_size = 0;
+    capture_record_t record;
+
+    while (fread(&record, sizeof(record), 1, in) == 1)
+    {
+        unsigned length = record.info & CAPTURE_MAX_LENGTH;
+
+        if (length > data_size)
+        {
+            unsigned char* new_data = (unsigned char*)realloc(data, length);
+            if (new_data == NULL)
+            {
+                printf("\nCould not allocate memory buffer.");
+                rez = 1;
+                break;
+            }
+
+            data = new_data;
+            data_size = length;
+        }
+
+        if (fread(data, 1, length, in) != length)
+        {
+            printf("\nThe last record of the capture file is not complete.");
+            rez = 1;
+            break;
+        }
+
+        convert_record(out, &record, data);
+        count++;
+    }
+
+    free(data);
+    (void)fclose(in);
+    (void)fclose(out);
+    printf("\n%u records written to '%s'.\n", count, out_name);
+    return rez;
+}
+
+
+/***
+ * @brief Write a capture record as text. Non-printable characters are written as \xNN.
+ *
+ * @param out     Text file
+ * @param record  Record header
+ * @param data    Data of the record
+ */
+
+static void convert_record(FILE* out, const capture_record_t* record, const unsigned char* data)
+{
+    static const char* const direction_names[] = { "Send", "Recv", "Discarded", "?" };
+    uint64_t time_us = ((uint64_t)record->time_high << 32U) | record->time_low;
+    unsigned length = record->info & CAPTURE_MAX_LENGTH;
+
+    fprintf(out, "\n%6.3f ms [%s: ", (double)time_us / 1000.0, direction_names[record->info >> CAPTURE_DIRECTION_SHIFT]);
+
+    for (unsigned i = 0; i < length; i++)
+    {
+        if ((data[i] >= ' ') && (data[i] < 0x7FU) && (data[i] != '\\'))
+        {
+            (void)fputc(data[i], out);
+        }
+        else
+        {
+            fprintf(out, "\\x%02X", data[i]);
+        }
+    }
+
+    fprintf(out, "]\n");
+}
+
+/*==== End of file ====*/
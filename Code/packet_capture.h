@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2024 Branko Premzel.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * @file    packet_capture.h
+ * @brief   Binary capture of the GDB server communication (-capture and -convert arguments).
+ * @author  B. Premzel
+ */
+
+#pragma once
+#include <stdint.h>
+
+// Capture file format - also read by the mock GDB server (mock_server.cpp)
+#define CAPTURE_FILE_ID      "RTEgdbCP"     // Capture file identification (without a terminating zero)
+#define CAPTURE_FILE_VERSION 1U
+#define CAPTURE_MAX_LENGTH   0x3FFFFFFFU    // Max. data length in the record
+#define CAPTURE_DIRECTION_SHIFT 30U
+
+typedef enum
+{
+    CAPTURE_SEND = 0,                       // Data sent to the GDB server
+    CAPTURE_RECV,                           // Data received from the GDB server
+    CAPTURE_DISCARDED                       // Received data discarded
+} capture_direction_t;
+
+typedef struct
+{
+    char id[8];                             // CAPTURE_FILE_ID
+    uint32_t version;                       // CAPTURE_FILE_VERSION
+    uint32_t reserved;
+} capture_file_header_t;
+
+typedef struct
+{
+    uint32_t time_low;                      // Time since the start of the capture [us] - lower 32 bits
+    uint32_t time_high;                     // Upper 32 bits of the time
+    uint32_t info;                          // Data length and direction
+} capture_record_t;
+
+bool capture_start(const char* file_name);
+void capture_packet(const char* direction, const char* msg, int length);
+void capture_stop(void);
+int  capture_convert(void);
+
+/*==== End of file ====*/
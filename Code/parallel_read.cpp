@@ -0,0 +1,480 @@
+/*
+ * Copyright (c) 2024 Branko Premzel.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * @file    parallel_read.cpp
+ * @brief   Read of large g_rtedbg structures over several GDB server connections (-connections argument).
+ * @author  B. Premzel
+ *
+ * With a single connection, each memory read request waits for the complete round trip
+ * through the GDB server and the debug probe. GDB servers that accept several client
+ * connections (e.g. OpenOCD with gdb-max-connections > 1) can process the requests of
+ * different connections in parallel. The structure is split into disjoint address
+ * ranges - the first range is read over the primary connection and the others by read
+ * worker threads, each with its own GDB server session.
+ *
+ * The worker connections are opened with parallel_read_start() right after the primary
+ * connection (and the -start commands) - not during a data transfer while the data
+ * logging is paused. They stay open until parallel_read_stop() is called. Workers that
+ * cannot connect (the GDB server does not accept more connections) are not used.
+ * The gain is measured after the connection with a probe read of the g_rtedbg structure
+ * (logging not paused) over the primary connection only and over all connections.
+ * The workers are stopped if the parallel read is not at least PARALLEL_MIN_GAIN
+ * times faster.
+ * The logging pause, filter restore and buffer clear stay on the primary connection.
+ *
+ * The worker threads use a copy of the parameters of the thread that started them.
+ * Their logging is disabled because the log file functions are not thread safe.
+ * The pool state is thread local - each -targets thread has its own workers.
+ */
+
+#include "pch.h"
+#include <stdlib.h>
+#include <string.h>
+#include <process.h>
+#include "gdb_lib.h"
+#include "RTEgdbData.h"
+#include "cmd_line.h"
+#include "logger.h"
+#include "parallel_read.h"
+
+
+typedef struct
+{
+    HANDLE thread;                  // Worker thread (NULL - not started)
+    HANDLE start_event;             // Auto-reset event - new read job or stop request
+    HANDLE done_event;              // Auto-reset event - connection attempt or read job completed
+    const parameters_t* parameters; // Parameters copied by the worker thread
+    unsigned char* buffer;          // Buffer for the data read
+    uint32_t address;               // Start address of the range read
+    uint32_t size;                  // Size of the range read [bytes]
+    int result;                     // GDB_OK - data read
+    unsigned error;                 // Last GDB error reported by the worker session
+    bool connected;                 // true - connected to the GDB server
+    bool stop;                      // true - the worker must disconnect and exit
+} read_worker_t;
+
+typedef struct
+{
+    read_worker_t workers[MAX_CONNECTIONS - 1U];
+    read_worker_t* connected[MAX_CONNECTIONS - 1U]; // Workers connected to the GDB server
+    unsigned worker_count;          // Number of connected workers
+    parameters_t parameters;        // Copy of the parameters for the worker threads
+} read_pool_t;
+
+
+/*---------------- GLOBAL VARIABLES ------------------*/
+static thread_local read_pool_t* pool = NULL;   // Read workers of the calling thread (NULL - not started)
+
+
+/*---------------- Local functions ---------------*/
+static bool start_read_workers(void);
+static void stop_read_workers(void);
+static void measure_parallel_gain(void);
+static int  read_in_parallel(unsigned char* buffer, uint32_t address, uint32_t size);
+static unsigned __stdcall read_worker_function(void* arg);
+static int  wait_for_workers(unsigned count);
+static int  read_failed_ranges(unsigned count);
+
+
+/***
+ * @brief Connect the read workers to the GDB server and measure the gain of the parallel
+ *        read (-connections argument). Must be called after the primary connection has
+ *        been established - the worker connections are not opened during the data transfers.
+ *        The parallel read is not used if the g_rtedbg structure is too small.
+ */
+
+void parallel_read_start(void)
+{
+    if ((parameters.connections < 2U) || (pool != NULL))
+    {
+        return;
+    }
+
+    if ((parameters.size == 0) && (load_rtedbg_structure_header() != GDB_OK))
+    {
+        log_string("\nThe g_rtedbg structure size is not known - parallel read not used.", NULL);
+        last_gdb_error = 0;
+        return;
+    }
+
+    if (parameters.size < (2U * PARALLEL_MIN_CHUNK_SIZE))
+    {
+        return;     // Each connection would read less than PARALLEL_MIN_CHUNK_SIZE
+    }
+
+    if (start_read_workers())
+    {
+        measure_parallel_gain();
+    }
+}
+
+
+/***
+ * @brief Read the memory block over the primary connection and the read worker connections.
+ *        Smaller blocks (less than PARALLEL_MIN_CHUNK_SIZE per connection) are read over
+ *        the primary connection only. The function does not open any connection.
+ *
+ * @param buffer   Buffer for the data read
+ * @param address  Start address of the block
+ * @param size     Size of the block [bytes]
+ *
+ * @return GDB_OK    - no error
+ *         GDB_ERROR - data not received
+ */
+
+int parallel_read_memory(unsigned char* buffer, uint32_t address, uint32_t size)
+{
+    if ((pool == NULL) || (pool->worker_count == 0) || (size < (2U * PARALLEL_MIN_CHUNK_SIZE)))
+    {
+        return gdb_read_memory(buffer, address, size);
+    }
+
+    return read_in_parallel(buffer, address, size);
+}
+
+
+/***
+ * @brief Measure the gain of the parallel read with a probe read of the g_rtedbg structure
+ *        (up to PARALLEL_PROBE_SIZE bytes) - first over the primary connection only and
+ *        then over all connections. The read workers are stopped if the parallel read is
+ *        not at least PARALLEL_MIN_GAIN times faster.
+ */
+
+static void measure_parallel_gain(void)
+{
+    uint32_t size = (parameters.size < PARALLEL_PROBE_SIZE) ? parameters.size : PARALLEL_PROBE_SIZE;
+    unsigned char* buffer = (unsigned char*)malloc(size);
+
+    if (buffer == NULL)
+    {
+        log_string("\nCould not allocate memory buffer.", NULL);
+        stop_read_workers();
+        return;
+    }
+
+    LARGE_INTEGER start_time;
+    start_timer(&start_time);
+    int rez = gdb_read_memory(buffer, parameters.start_address, size);
+    double single_time = time_elapsed(&start_time);
+
+    if (rez == GDB_OK)
+    {
+        start_timer(&start_time);
+        rez = read_in_parallel(buffer, parameters.start_address, size);
+    }
+
+    double parallel_time = time_elapsed(&start_time);
+    free(buffer);
+
+    if ((rez != GDB_OK) || (pool->worker_count == 0))
+    {
+        log_string("\nParallel read probe failed - the single connection is used.", NULL);
+        stop_read_workers();
+        last_gdb_error = 0;
+        gdb_flush_socket();
+        return;
+    }
+
+    double gain = (parallel_time > 0) ? (single_time / parallel_time) : 0;
+    log_data("\nParallel read over %llu connections", (long long)(pool->worker_count + 1U));
+    log_data(": speed %llu %% of the single connection read.", (long long)(gain * 100.0));
+
+    if (gain < PARALLEL_MIN_GAIN)
+    {
+        log_string(" The additional connections are closed.", NULL);
+        stop_read_workers();
+    }
+}
+
+
+/***
+ * @brief Split the memory block into parts and read the first part over the primary
+ *        connection and the others by the read workers at the same time.
+ *
+ * @param buffer   Buffer for the data read
+ * @param address  Start address of the block
+ * @param size     Size of the block [bytes] (at least 2 x PARALLEL_MIN_CHUNK_SIZE)
+ *
+ * @return GDB_OK    - no error
+ *         GDB_ERROR - data not received
+ */
+
+static int read_in_parallel(unsigned char* buffer, uint32_t address, uint32_t size)
+{
+    unsigned parts = pool->worker_count + 1U;
+    if (parts > (size / PARALLEL_MIN_CHUNK_SIZE))
+    {
+        parts = size / PARALLEL_MIN_CHUNK_SIZE;
+    }
+
+    const uint32_t chunk = (size / parts) & ~3U;
+    const unsigned jobs = parts - 1U;
+
+    for (unsigned i = 0; i < jobs; i++)
+    {
+        read_worker_t* worker = pool->connected[i];
+        uint32_t offset = (i + 1U) * chunk;
+        worker->buffer = buffer + offset;
+        worker->address = address + offset;
+        worker->size = (i == (jobs - 1U)) ? (size - offset) : chunk;
+        (void)SetEvent(worker->start_event);
+    }
+
+    int rez = gdb_read_memory(buffer, address, chunk);
+    int workers_rez = wait_for_workers(jobs);
+
+    if (rez != GDB_OK)
+    {
+        return GDB_ERROR;
+    }
+
+    if (workers_rez != GDB_OK)
+    {
+        // The ranges of the failed workers are read over the primary connection
+        return read_failed_ranges(jobs);
+    }
+
+    return GDB_OK;
+}
+
+
+/***
+ * @brief Close the read worker connections and stop the worker threads. The workers are
+ *        started again with parallel_read_start() (e.g. after the reconnection to the GDB server).
+ *        Must be called by the thread that called parallel_read_start().
+ */
+
+void parallel_read_stop(void)
+{
+    if (pool == NULL)
+    {
+        return;
+    }
+
+    stop_read_workers();
+    free(pool);
+    pool = NULL;
+}
+
+
+/***
+ * @brief Start the read worker threads and wait until they are connected to the GDB server.
+ *
+ * @return true  - connected workers are available
+ *         false - no additional connection accepted by the GDB server
+ */
+
+static bool start_read_workers(void)
+{
+    if (pool == NULL)
+    {
+        pool = (read_pool_t*)calloc(1, sizeof(read_pool_t));
+        if (pool == NULL)
+        {
+            log_string("\nCould not allocate memory buffer.", NULL);
+            return false;
+        }
+    }
+
+    pool->parameters = parameters;
+    pool->parameters.connections = 1U;      // The workers use only their own connection
+    pool->parameters.log_file = NULL;
+    pool->parameters.capture_file = NULL;
+    pool->parameters.log_gdb_communication = false;
+
+    const unsigned count = parameters.connections - 1U;
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        read_worker_t* worker = &pool->workers[i];
+        worker->parameters = &pool->parameters;
+        worker->start_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+        worker->done_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+        if ((worker->start_event != NULL) && (worker->done_event != NULL))
+        {
+            worker->thread = (HANDLE)_beginthreadex(NULL, 0, read_worker_function, worker, 0, NULL);
+        }
+
+        if (worker->thread == NULL)
+        {
+            log_data("\nCould not start the read worker thread %llu.", (long long)(i + 1U));
+        }
+    }
+
+    unsigned connected = 0;
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        read_worker_t* worker = &pool->workers[i];
+
+        if (worker->thread != NULL)
+        {
+            (void)WaitForSingleObject(worker->done_event, INFINITE);
+
+            if (worker->connected)
+            {
+                pool->connected[connected++] = worker;
+                continue;
+            }
+
+            (void)WaitForSingleObject(worker->thread, INFINITE);     // The thread exits
+            (void)CloseHandle(worker->thread);
+            worker->thread = NULL;
+        }
+
+        if (worker->start_event != NULL)
+        {
+            (void)CloseHandle(worker->start_event);
+            worker->start_event = NULL;
+        }
+
+        if (worker->done_event != NULL)
+        {
+            (void)CloseHandle(worker->done_event);
+            worker->done_event = NULL;
+        }
+    }
+
+    pool->worker_count = connected;
+    log_data("\nAdditional GDB server connections for parallel reads: %llu", (long long)connected);
+
+    if (connected < count)
+    {
+        log_data(" (%llu not accepted)", (long long)(count - connected));
+    }
+
+    return connected > 0;
+}
+
+
+/***
+ * @brief Stop the read worker threads. The workers detach from the GDB server and close their connections.
+ */
+
+static void stop_read_workers(void)
+{
+    for (unsigned i = 0; i < pool->worker_count; i++)
+    {
+        read_worker_t* worker = pool->connected[i];
+        worker->stop = true;
+        (void)SetEvent(worker->start_event);
+        (void)WaitForSingleObject(worker->thread, INFINITE);
+        (void)CloseHandle(worker->thread);
+        (void)CloseHandle(worker->start_event);
+        (void)CloseHandle(worker->done_event);
+        memset(worker, 0, sizeof(read_worker_t));
+    }
+
+    pool->worker_count = 0;
+}
+
+
+/***
+ * @brief Read worker thread - connect to the GDB server and read the memory ranges
+ *        assigned by parallel_read_memory() until the stop request.
+ *
+ * @param arg  Read worker data
+ *
+ * @return 0
+ */
+
+static unsigned __stdcall read_worker_function(void* arg)
+{
+    read_worker_t* worker = (read_worker_t*)arg;
+    parameters = *worker->parameters;
+    enable_logging(false);
+
+    worker->connected = (gdb_connect(parameters.gdb_port) == GDB_OK);
+    (void)SetEvent(worker->done_event);
+
+    while (worker->connected)
+    {
+        (void)WaitForSingleObject(worker->start_event, INFINITE);
+
+        if (worker->stop)
+        {
+            break;
+        }
+
+        worker->result = gdb_read_memory(worker->buffer, worker->address, worker->size);
+        worker->error = last_gdb_error;
+        (void)SetEvent(worker->done_event);
+    }
+
+    if (worker->connected)
+    {
+        gdb_detach();
+    }
+
+    gdb_socket_cleanup();
+    gdb_session_release();
+    return 0;
+}
+
+
+/***
+ * @brief Wait until the read workers have finished their read jobs.
+ *
+ * @param count  Number of workers with a read job
+ *
+ * @return GDB_OK    - all ranges read
+ *         GDB_ERROR - at least one worker could not read its range
+ */
+
+static int wait_for_workers(unsigned count)
+{
+    int rez = GDB_OK;
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        read_worker_t* worker = pool->connected[i];
+        (void)WaitForSingleObject(worker->done_event, INFINITE);
+
+        if (worker->result != GDB_OK)
+        {
+            log_data("\nParallel read - connection %llu failed", (long long)(i + 2U));
+            log_data(" (error %llu).", (long long)worker->error);
+            rez = GDB_ERROR;
+        }
+    }
+
+    return rez;
+}
+
+
+/***
+ * @brief Read the ranges of the workers that could not read them over the primary
+ *        connection and close the additional connections - the single connection
+ *        is used for the rest of the session.
+ *
+ * @param count  Number of workers with a read job
+ *
+ * @return GDB_OK    - all ranges read
+ *         GDB_ERROR - data not received
+ */
+
+static int read_failed_ranges(unsigned count)
+{
+    int rez = GDB_OK;
+
+    for (unsigned i = 0; (i < count) && (rez == GDB_OK); i++)
+    {
+        const read_worker_t* worker = pool->connected[i];
+
+        if (worker->result != GDB_OK)
+        {
+            rez = gdb_read_memory(worker->buffer, worker->address, worker->size);
+        }
+    }
+
+    log_string(" The single connection is used for the next transfers.", NULL);
+    stop_read_workers();
+    return rez;
+}
+
+/*==== End of file ====*/
@@ -0,0 +1,21 @@
+/*
+ * Copyright (c) 2024 Branko Premzel.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * @file    parallel_read.h
+ * @brief   Read of large g_rtedbg structures over several GDB server connections (-connections argument).
+ * @author  B. Premzel
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+void parallel_read_start(void);
+int  parallel_read_memory(unsigned char* buffer, uint32_t address, uint32_t size);
+void parallel_read_stop(void);
+
+/*==== End of file ====*/
@@ -0,0 +1,388 @@
+/*
+ * Copyright (c) 2024 Branko Premzel.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * @file    rsp_frame.cpp
+ * @brief   Incremental decoder for the memory read replies of the GDB server.
+ * @author  B. Premzel
+ *
+ * The reply is decoded while it is being received. Each part of the message is
+ * passed to rsp_frame_decode() as soon as it arrives. The payload is decoded
+ * (hex or binary with escape sequences and run-length encoding) directly to the
+ * destination buffer, and the checksum is calculated on the fly. The decoder stops
+ * after the second checksum character, so that the data of the following message
+ * stays in the receive buffer. Plain runs of payload characters are decoded in one
+ * step with the (vectorized) hex_to_bin() or memcpy().
+ *
+ * Errors in the payload do not stop the decoding - the end of the message must still
+ * be found to stay synchronized with the GDB server. Only the first error is reported.
+ */
+
+#include "pch.h"
+#include <stdlib.h>
+#include <string.h>
+#include "rsp_frame.h"
+#include "hex_codec.h"
+
+
+/*---------------- Local functions ---------------*/
+static unsigned plain_data_length(const char* data, unsigned length);
+static void set_frame_error(rsp_frame_t* frame, frame_error_t error);
+static void emit_data(rsp_frame_t* frame, const char* data, unsigned length);
+static void emit_hex_data(rsp_frame_t* frame, const char* data, unsigned length);
+static void emit_repeated_char(rsp_frame_t* frame, int repeat_count);
+
+
+/***
+ * @brief Prepare the decoder for a new message.
+ *
+ * @param frame          Decoder state
+ * @param dst            Buffer for the decoded data
+ * @param max_len        Size of the buffer for the decoded data
+ * @param binary         true - binary payload ('x' packet reply), false - hex encoded payload
+ * @param binary_prefix  true - binary payload starts with the 'b' character
+ */
+
+void rsp_frame_init(rsp_frame_t* frame, unsigned char* dst, unsigned max_len, bool binary, bool binary_prefix)
+{
+    memset(frame, 0, sizeof(rsp_frame_t));
+    frame->state = FRAME_START;
+    frame->error = FRAME_OK;
+    frame->dst = dst;
+    frame->max_len = max_len;
+    frame->binary = binary;
+    frame->binary_prefix = binary && binary_prefix;
+}
+
+
+/***
+ * @brief Decode the next part of the received message.
+ *
+ * @param frame   Decoder state
+ * @param data    Received data not yet processed by the decoder
+ * @param length  Number of received bytes
+ *
+ * @return Number of bytes processed. It is less than 'length' if the message ended
+ *         before the end of data (frame->state == FRAME_DONE).
+ */
+
+unsigned rsp_frame_decode(rsp_frame_t* frame, const char* data, unsigned length)
+{
+    unsigned i = 0;
+
+    while ((i < length) && (frame->state != FRAME_DONE))
+    {
+        char c = data[i];
+
+        switch (frame->state)
+        {
+            case FRAME_START:
+                i++;
+                if (c != '$')
+                {
+                    set_frame_error(frame, FRAME_BAD_FORMAT);
+                }
+                frame->state = frame->binary_prefix ? FRAME_PREFIX : FRAME_PAYLOAD;
+                break;
+
+            case FRAME_PREFIX:
+                i++;
+                if (c == '#')
+                {
+                    frame->state = FRAME_CHECKSUM_1;
+                    break;
+                }
+
+                // Error replies without the 'b' are checked by the caller
+                frame->sum += (unsigned char)c;
+                if (c != 'b')
+                {
+                    set_frame_error(frame, FRAME_BAD_FORMAT);
+                }
+                frame->last_char = c;
+                frame->last_char_valid = true;
+                frame->state = FRAME_PAYLOAD;
+                break;
+
+            case FRAME_PAYLOAD:
+            {
+                unsigned span = plain_data_length(&data[i], length - i);
+
+                if (span > 0)
+                {
+                    frame->sum += calculate_checksum(&data[i], span);
+                    emit_data(frame, &data[i], span);
+                    frame->last_char = data[i + span - 1U];
+                    frame->last_char_valid = true;
+                    i += span;
+                    break;
+                }
+
+                i++;
+                if (c == '#')
+                {
+                    frame->state = FRAME_CHECKSUM_1;
+                }
+                else
+                {
+                    frame->sum += (unsigned char)c;
+                    frame->state = (c == '}') ? FRAME_ESCAPE : FRAME_RLE_COUNT;
+                }
+                break;
+            }
+
+            case FRAME_ESCAPE:
+                i++;
+                if (c == '#')
+                {
+                    set_frame_error(frame, FRAME_BAD_FORMAT);
+                    frame->state = FRAME_CHECKSUM_1;
+                    break;
+                }
+
+                frame->sum += (unsigned char)c;
+                if (frame->binary)
+                {
+                    char unescaped = (char)(c ^ 0x20);
+                    emit_data(frame, &unescaped, 1U);
+                }
+                else
+                {
+                    set_frame_error(frame, FRAME_BAD_FORMAT);
+                }
+
+                // The run-length encoding repeats the character as it was received
+                frame->last_char = c;
+                frame->last_char_valid = true;
+                frame->state = FRAME_PAYLOAD;
+                break;
+
+            case FRAME_RLE_COUNT:
+                i++;
+                if (c == '#')
+                {
+                    set_frame_error(frame, FRAME_BAD_RUN_LENGTH_ENCODING);
+                    frame->state = FRAME_CHECKSUM_1;
+                    break;
+                }
+
+                frame->sum += (unsigned char)c;
+                emit_repeated_char(frame, (unsigned char)c - 29);
+                frame->state = FRAME_PAYLOAD;
+                break;
+
+            case FRAME_CHECKSUM_1:
+                i++;
+                frame->checksum[0] = c;
+                frame->state = FRAME_CHECKSUM_2;
+                break;
+
+            case FRAME_CHECKSUM_2:
+            {
+                i++;
+                frame->checksum[1] = c;
+                int checksum = get_hex_digit(frame->checksum);
+                frame->checksum_ok = (checksum >= 0) && ((unsigned char)checksum == frame->sum);
+
+                if (frame->hex_char_valid)
+                {
+                    set_frame_error(frame, FRAME_BAD_FORMAT);   // Odd number of hex characters
+                }
+
+                frame->state = FRAME_DONE;
+                break;
+            }
+
+            default:
+                frame->state = FRAME_DONE;
+                break;
+        }
+    }
+
+    return i;
+}
+
+
+/***
+ * @brief Find the number of payload characters without special meaning ('#', '}' and '*').
+ *
+ * @param data    Payload data
+ * @param length  Number of bytes available
+ *
+ * @return Number of characters that can be decoded without further checks
+ */
+
+static unsigned plain_data_length(const char* data, unsigned length)
+{
+    unsigned i = 0;
+
+    while (i < length)
+    {
+        char c = data[i];
+
+        if ((c == '#') || (c == '}') || (c == '*'))
+        {
+            break;
+        }
+
+        i++;
+    }
+
+    return i;
+}
+
+
+/***
+ * @brief Remember the first error found in the payload.
+ *
+ * @param frame  Decoder state
+ * @param error  Error type
+ */
+
+static void set_frame_error(rsp_frame_t* frame, frame_error_t error)
+{
+    if (frame->error == FRAME_OK)
+    {
+        frame->error = error;
+    }
+}
+
+
+/***
+ * @brief Copy the decoded data to the destination buffer.
+ *        Nothing is written after an error has been found.
+ *
+ * @param frame   Decoder state
+ * @param data    Payload characters
+ * @param length  Number of payload characters
+ */
+
+static void emit_data(rsp_frame_t* frame, const char* data, unsigned length)
+{
+    if ((frame->error != FRAME_OK) || (length == 0))
+    {
+        return;
+    }
+
+    if (!frame->binary)
+    {
+        emit_hex_data(frame, data, length);
+        return;
+    }
+
+    if (length > (frame->max_len - frame->decoded))
+    {
+        set_frame_error(frame, FRAME_DATA_OVERFLOW);
+        return;
+    }
+
+    memcpy(&frame->dst[frame->decoded], data, length);
+    frame->decoded += length;
+}
+
+
+/***
+ * @brief Convert the hex characters to binary data. A hex pair may be split between
+ *        two calls - the first character is kept until the next one arrives.
+ *
+ * @param frame   Decoder state
+ * @param data    Hex characters
+ * @param length  Number of hex characters
+ */
+
+static void emit_hex_data(rsp_frame_t* frame, const char* data, unsigned length)
+{
+    if (frame->hex_char_valid)
+    {
+        char pair[2] = { frame->hex_char, data[0] };
+        int value = get_hex_digit(pair);
+        frame->hex_char_valid = false;
+
+        if (value < 0)
+        {
+            set_frame_error(frame, FRAME_BAD_FORMAT);
+            return;
+        }
+
+        if (frame->decoded >= frame->max_len)
+        {
+            set_frame_error(frame, FRAME_DATA_OVERFLOW);
+            return;
+        }
+
+        frame->dst[frame->decoded++] = (unsigned char)value;
+        data++;
+        length--;
+    }
+
+    unsigned bytes = length / 2U;
+
+    if (bytes > 0)
+    {
+        if (bytes > (frame->max_len - frame->decoded))
+        {
+            set_frame_error(frame, FRAME_DATA_OVERFLOW);
+            return;
+        }
+
+        if (!hex_to_bin(data, &frame->dst[frame->decoded], bytes))
+        {
+            set_frame_error(frame, FRAME_BAD_FORMAT);
+            return;
+        }
+
+        frame->decoded += bytes;
+    }
+
+    if ((length & 1U) != 0)
+    {
+        frame->hex_char = data[length - 1U];
+        frame->hex_char_valid = true;
+    }
+}
+
+
+/***
+ * @brief Expand the run-length encoded sequence 'X*n' - the character X is repeated
+ *        (n - 29) more times.
+ *
+ * @param frame         Decoder state
+ * @param repeat_count  Number of repetitions
+ */
+
+static void emit_repeated_char(rsp_frame_t* frame, int repeat_count)
+{
+    if (!frame->last_char_valid || (repeat_count < 1))
+    {
+        set_frame_error(frame, FRAME_BAD_RUN_LENGTH_ENCODING);
+        return;
+    }
+
+    if (frame->error != FRAME_OK)
+    {
+        return;
+    }
+
+    if (frame->binary)
+    {
+        if ((unsigned)repeat_count > (frame->max_len - frame->decoded))
+        {
+            set_frame_error(frame, FRAME_DATA_OVERFLOW);
+            return;
+        }
+
+        memset(&frame->dst[frame->decoded], (unsigned char)frame->last_char, (size_t)repeat_count);
+        frame->decoded += (unsigned)repeat_count;
+        return;
+    }
+
+    for (int i = 0; (i < repeat_count) && (frame->error == FRAME_OK); i++)
+    {
+        emit_hex_data(frame, &frame->last_char, 1U);
+    }
+}
+
+/*==== End of file ====*/
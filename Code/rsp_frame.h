@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2024 Branko Premzel.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * @file    rsp_frame.h
+ * @brief   Incremental decoder for the memory read replies of the GDB server.
+ * @author  B. Premzel
+ */
+
+#pragma once
+
+typedef enum
+{
+    FRAME_START = 0,                // Waiting for the '$' character
+    FRAME_PREFIX,                   // Waiting for the 'b' prefix of the binary data
+    FRAME_PAYLOAD,                  // Decoding the payload
+    FRAME_ESCAPE,                   // Character after the '}' escape character expected
+    FRAME_RLE_COUNT,                // Repeat count after the '*' character expected
+    FRAME_CHECKSUM_1,               // First checksum character expected
+    FRAME_CHECKSUM_2,               // Second checksum character expected
+    FRAME_DONE                      // Complete message received
+} frame_state_t;
+
+typedef enum
+{
+    FRAME_OK = 0,
+    FRAME_BAD_FORMAT,               // Bad message format or bad escape sequence
+    FRAME_BAD_RUN_LENGTH_ENCODING,  // Repeat count without a preceding character or out of range
+    FRAME_DATA_OVERFLOW             // More data received than requested
+} frame_error_t;
+
+typedef struct
+{
+    frame_state_t state;
+    frame_error_t error;            // First error found in the payload
+    unsigned char* dst;             // Buffer for the decoded data
+    unsigned max_len;               // Size of the buffer for the decoded data
+    unsigned decoded;               // Number of decoded bytes
+    bool binary;                    // true - binary payload, false - hex encoded payload
+    bool binary_prefix;             // true - binary payload starts with 'b'
+    unsigned char sum;              // Checksum of the payload characters received
+    char last_char;                 // Last payload character (repeated by the run-length encoding)
+    bool last_char_valid;           // true - last_char can be repeated
+    char hex_char;                  // First character of a hex pair split between the receive calls
+    bool hex_char_valid;            // true - hex_char contains the first half of a byte
+    char checksum[2];               // Checksum characters following the '#'
+    bool checksum_ok;               // true - the checksum matches (valid in the FRAME_DONE state)
+} rsp_frame_t;
+
+void rsp_frame_init(rsp_frame_t* frame, unsigned char* dst, unsigned max_len, bool binary, bool binary_prefix);
+unsigned rsp_frame_decode(rsp_frame_t* frame, const char* data, unsigned length);
+
+/*==== End of file ====*/
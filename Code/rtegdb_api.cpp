@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2024 Branko Premzel.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * @file    rtegdb_api.cpp
+ * @brief   C API of the RTEgdbLib.dll library - data transfer from the embedded system
+ *          directly to the memory of the calling program.
+ * @author  B. Premzel
+ *
+ * The library contains the same GDB communication and data transfer code as the
+ * RTEgdbData.exe (compiled with RTEGDB_LIBRARY defined - without the main() function).
+ * A test program can stay connected to the GDB server and capture the g_rtedbg structure
+ * as often as needed without the process startup, GDB server capability negotiation and
+ * the binary file write and read for each capture. The memory read replies are decoded
+ * directly to the buffer provided by the caller.
+ *
+ * The connection state, parameters and logging are thread local - see gdb_lib.cpp.
+ */
+
+#include "pch.h"
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include "gdb_lib.h"
+#include "RTEgdbData.h"
+#include "cmd_line.h"
+#include "rtedbg.h"
+#include "logger.h"
+#include "rtegdb_api.h"
+
+static_assert(sizeof(rtegdb_header_t) == sizeof(rtedbg_header_t), "rtegdb_header_t must match rtedbg_header_t");
+
+
+/*---------------- Local functions ---------------*/
+static int check_config(const rtegdb_config_t* config);
+
+
+/***
+ * @brief Connect to the GDB server. The previous connection of the calling thread
+ *        must be closed with rtegdb_disconnect() first.
+ *
+ * @param config  Connection settings (the strings are only used during the call)
+ *
+ * @return RTEGDB_OK    - connected
+ *         RTEGDB_ERROR - incorrect settings or could not connect to the GDB server
+ */
+
+RTEGDB_API int rtegdb_connect(const rtegdb_config_t* config)
+{
+    if (check_config(config) != RTEGDB_OK)
+    {
+        last_gdb_error = ERR_BAD_INPUT_DATA;
+        return RTEGDB_ERROR;
+    }
+
+    memset(&parameters, 0, sizeof(parameters));
+    parameters.ip_address = (config->ip_address != NULL) ? config->ip_address : DEFAULT_HOST_ADDRESS;
+    parameters.gdb_port = config->gdb_port;
+    parameters.start_address = config->start_address;
+    parameters.size = config->size;
+    parameters.max_message_size = config->max_message_size;
+    parameters.pipeline_depth = config->pipeline_depth;
+    parameters.clear_buffer = (config->clear_buffer != 0);
+    parameters.bin_file_name = NULL;        // The data is not written to a file
+
+    if (config->log_file != NULL)
+    {
+        create_log_file(config->log_file);
+        enable_logging(true);
+    }
+    else
+    {
+        create_log_file(NULL);
+        enable_logging(false);
+    }
+
+    set_rtedbg_structure_buffer(NULL, 0);
+    gdb_lib_init();
+
+    int rez = gdb_connect(parameters.gdb_port);
+    parameters.ip_address = DEFAULT_HOST_ADDRESS;   // The caller's string may not be valid any more
+    return (rez == GDB_OK) ? RTEGDB_OK : RTEGDB_ERROR;
+}
+
+
+/***
+ * @brief Check the connection settings.
+ *
+ * @param config  Connection settings
+ *
+ * @return RTEGDB_OK    - settings are correct
+ *         RTEGDB_ERROR - incorrect settings
+ */
+
+static int check_config(const rtegdb_config_t* config)
+{
+    if ((config == NULL) || (config->gdb_port == 0)
+        || ((config->start_address & 3U) != 0)
+        || ((config->size & 3U) != 0)
+        || ((config->size < MIN_BUFFER_SIZE) && (config->size != 0))
+        || ((config->max_message_size != 0)
+            && ((config->max_message_size < 256U) || (config->max_message_size > MAX_MESSAGE_BUFFER_SIZE)))
+        || (config->pipeline_depth > MAX_PIPELINE_DEPTH))
+    {
+        return RTEGDB_ERROR;
+    }
+
+    return RTEGDB_OK;
+}
+
+
+/***
+ * @brief Read the g_rtedbg structure header from the embedded system.
+ *
+ * @param header  Header contents
+ *
+ * @return RTEGDB_OK    - header read
+ *         RTEGDB_ERROR - data not received or incorrect header contents
+ */
+
+RTEGDB_API int rtegdb_read_header(rtegdb_header_t* header)
+{
+    if (header == NULL)
+    {
+        last_gdb_error = ERR_BAD_INPUT_DATA;
+        return RTEGDB_ERROR;
+    }
+
+    if (load_rtedbg_structure_header() != GDB_OK)
+    {
+        return RTEGDB_ERROR;
+    }
+
+    memcpy(header, &rtedbg_header, sizeof(rtegdb_header_t));
+    return RTEGDB_OK;
+}
+
+
+/***
+ * @brief Transfer the g_rtedbg structure to the caller's buffer - the same data transfer
+ *        cycle as a single data transfer of RTEgdbData.exe (logging is paused during the
+ *        transfer, the circular buffer is cleared if enabled and the filter is restored).
+ *        The buffer contents are the same as the contents of the binary file.
+ *
+ * @param buffer       Buffer for the g_rtedbg structure (32-bit word aligned)
+ * @param buffer_size  Size of the buffer [bytes]
+ * @param length       Number of bytes written to the buffer (size of the g_rtedbg structure)
+ *
+ * @return RTEGDB_OK    - data transferred
+ *         RTEGDB_ERROR - data not received or the buffer is too small
+ */
+
+RTEGDB_API int rtegdb_capture(void* buffer, uint32_t buffer_size, uint32_t* length)
+{
+    if ((buffer == NULL) || ((((uintptr_t)buffer) & 3U) != 0) || (length == NULL))
+    {
+        last_gdb_error = ERR_BAD_INPUT_DATA;
+        return RTEGDB_ERROR;
+    }
+
+    *length = 0;
+    set_rtedbg_structure_buffer((unsigned*)buffer, buffer_size);
+
+    if (data_transfer_cycle(NULL) != GDB_OK)
+    {
+        return RTEGDB_ERROR;
+    }
+
+    *length = parameters.size;
+    return RTEGDB_OK;
+}
+
+
+/***
+ * @brief Set the message filter. The value is also restored after each data transfer.
+ *
+ * @param filter  New message filter value
+ *
+ * @return RTEGDB_OK    - filter set
+ *         RTEGDB_ERROR - message filtering disabled in the firmware or data not sent
+ */
+
+RTEGDB_API int rtegdb_set_filter(uint32_t filter)
+{
+    if (load_rtedbg_structure_header() != GDB_OK)
+    {
+        return RTEGDB_ERROR;
+    }
+
+    if (!RTE_MSG_FILTERING_ENABLED)
+    {
+        log_string("\nMessage filtering disabled in the firmware.", NULL);
+        last_gdb_error = ERR_BAD_INPUT_DATA;
+        return RTEGDB_ERROR;
+    }
+
+    parameters.filter = filter;
+    parameters.set_filter = true;
+
+    int rez = gdb_write_memory((const unsigned char*)&filter, MESSAGE_FILTER_ADDRESS, 4U);
+    return (rez == GDB_OK) ? RTEGDB_OK : RTEGDB_ERROR;
+}
+
+
+/***
+ * @brief Read the current message filter value.
+ *
+ * @param filter  Message filter value
+ *
+ * @return RTEGDB_OK    - filter read
+ *         RTEGDB_ERROR - data not received
+ */
+
+RTEGDB_API int rtegdb_get_filter(uint32_t* filter)
+{
+    if (filter == NULL)
+    {
+        last_gdb_error = ERR_BAD_INPUT_DATA;
+        return RTEGDB_ERROR;
+    }
+
+    int rez = gdb_read_memory((unsigned char*)filter, MESSAGE_FILTER_ADDRESS, 4U);
+    return (rez == GDB_OK) ? RTEGDB_OK : RTEGDB_ERROR;
+}
+
+
+/***
+ * @brief Get the last error reported for the connection of the calling thread.
+ *
+ * @return Error code (see gdb_defs.h), 0 - no error
+ */
+
+RTEGDB_API unsigned rtegdb_last_error(void)
+{
+    return last_gdb_error;
+}
+
+
+/***
+ * @brief Close the connection to the GDB server and the log file and release the memory.
+ *        The caller's buffer is not used by the library any more.
+ */
+
+RTEGDB_API void rtegdb_disconnect(void)
+{
+    gdb_detach();
+    gdb_socket_cleanup();
+    gdb_session_release();
+    set_rtedbg_structure_buffer(NULL, 0);
+    close_log_file();
+}
+
+/*==== End of file ====*/
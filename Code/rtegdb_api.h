@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2024 Branko Premzel.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * @file    rtegdb_api.h
+ * @brief   C API of the RTEgdbLib.dll library - data transfer from the embedded system
+ *          directly to the memory of the calling program.
+ * @author  B. Premzel
+ *
+ * The functions act on the GDB server connection of the calling thread. All functions
+ * for a connection must be called from the same thread. Several connections (embedded
+ * systems) can be used in parallel from different threads.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef RTEGDB_LIBRARY
+#define RTEGDB_API __declspec(dllexport)
+#else
+#define RTEGDB_API __declspec(dllimport)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RTEGDB_OK       0
+#define RTEGDB_ERROR    1
+
+// Connection settings (see the command line arguments with the same names in Readme.md)
+typedef struct
+{
+    const char* ip_address;         // GDB server IP address (NULL - "127.0.0.1")
+    unsigned short gdb_port;        // GDB server port number
+    uint32_t start_address;         // Address of the g_rtedbg structure
+    uint32_t size;                  // Size of the g_rtedbg structure (0 - size from the structure header)
+    uint32_t max_message_size;      // Max. GDB message size (0 - as reported by the GDB server, -msgsize)
+    uint32_t pipeline_depth;        // Number of memory read requests sent without waiting for replies (-pipeline)
+    int clear_buffer;               // Not zero - clear the circular buffer after the data transfer (-clear)
+    const char* log_file;           // Log file name (NULL - logging disabled)
+} rtegdb_config_t;
+
+// Header of the g_rtedbg structure (see rtedbg.h)
+typedef struct
+{
+    uint32_t last_index;            // Index to the circular data logging buffer
+    uint32_t filter;                // Message filter
+    uint32_t rte_cfg;               // RTEdbg configuration
+    uint32_t timestamp_frequency;   // Frequency of the timestamp counter [Hz]
+    uint32_t filter_copy;           // Last non-zero message filter value
+    uint32_t buffer_size;           // Size of the circular buffer [32-bit words]
+} rtegdb_header_t;
+
+RTEGDB_API int  rtegdb_connect(const rtegdb_config_t* config);
+RTEGDB_API int  rtegdb_read_header(rtegdb_header_t* header);
+RTEGDB_API int  rtegdb_capture(void* buffer, uint32_t buffer_size, uint32_t* length);
+RTEGDB_API int  rtegdb_set_filter(uint32_t filter);
+RTEGDB_API int  rtegdb_get_filter(uint32_t* filter);
+RTEGDB_API unsigned rtegdb_last_error(void);
+RTEGDB_API void rtegdb_disconnect(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+/*==== End of file ====*/
@@ -0,0 +1,807 @@
+/*
+ * Copyright (c) 2024 Branko Premzel.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * @file    snapshot_series.cpp
+ * @brief   Series of time-stamped snapshots in a single file (-series=file argument).
+ * @author  B. Premzel
+ *
+ * Each snapshot written to the binary file is also appended to the series file.
+ * The snapshot is split into SERIES_PAGE_SIZE pages and only the pages that differ
+ * from the previous snapshot are stored. All pages are stored in the first snapshot
+ * after the file has been opened, after a change of the structure size and in every
+ * SERIES_KEYFRAME_INTERVAL-th snapshot, so that a snapshot can be rebuilt without
+ * processing the complete file. With the -compress argument, the pages are compressed
+ * with a simple LZ77 compression (format similar to the LZ4 block format).
+ *
+ * File format (little endian):
+ * - series_file_header_t
+ * - for each snapshot: series_record_t followed by 'page_count' stored pages,
+ *   each with a series_page_t header and the (compressed) page data.
+ *
+ * The record headers are the index of the file - they contain the snapshot number,
+ * capture time and the size of the data that follows. Use the -extract=n argument
+ * to rebuild a single snapshot as a normal binary file that can be decoded with RTEmsg.
+ *
+ * Errors are reported with printf(), because the snapshots may be appended by the
+ * file writer thread (-async argument) and the log file functions are not thread safe.
+ */
+
+#include "pch.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <io.h>
+#include "gdb_lib.h"
+#include "RTEgdbData.h"
+#include "cmd_line.h"
+#include "snapshot_series.h"
+
+
+#define SERIES_FILE_MAGIC       "RTESER01"  // Identification of the series file
+#define SERIES_RECORD_MAGIC     0x50414E53U // "SNAP" - start of the snapshot record
+#define SERIES_KEYFRAME         1U          // Record flag - all pages are stored
+#define SERIES_PAGE_COMPRESSED  0x80000000U // Page stored_size flag - the page data is compressed
+#define LZ_MIN_MATCH            4U          // Shortest sequence encoded as a match
+#define LZ_HASH_BITS            12U         // Size of the match finder hash table (bits)
+
+
+typedef struct
+{
+    char magic[8];                  // SERIES_FILE_MAGIC (without the terminating zero)
+    uint32_t page_size;             // SERIES_PAGE_SIZE
+    uint32_t reserved;
+} series_file_header_t;
+
+typedef struct
+{
+    uint32_t magic;                 // SERIES_RECORD_MAGIC
+    uint32_t number;                // Snapshot number (the first snapshot in the file is number 1)
+    int64_t  time_s;                // Capture time - seconds since 1.1.1970 (UTC)
+    uint32_t time_ms;               // Capture time - milliseconds
+    uint32_t structure_size;        // Size of the g_rtedbg structure snapshot [bytes]
+    uint32_t page_count;            // Number of pages stored in the record
+    uint32_t flags;                 // SERIES_KEYFRAME
+    uint32_t payload_size;          // Number of bytes following the record header
+    uint32_t reserved;
+} series_record_t;
+
+typedef struct
+{
+    uint32_t page_index;            // Page number in the snapshot
+    uint32_t stored_size;           // Number of bytes stored (+ SERIES_PAGE_COMPRESSED flag)
+} series_page_t;
+
+
+/*---------------- GLOBAL VARIABLES ------------------*/
+static FILE* series_file = NULL;            // Series file (NULL - not opened yet)
+static unsigned char* previous_snapshot = NULL; // Data of the last snapshot appended to the file
+static unsigned previous_size = 0;          // Size of the last snapshot [bytes]
+static unsigned snapshot_number = 0;        // Number of the last snapshot in the file
+static unsigned records_since_keyframe = 0; // Number of snapshots appended after the last keyframe
+static unsigned char* record_buffer = NULL; // Buffer for the stored pages of a snapshot
+static unsigned record_buffer_size = 0;     // Size of the allocated record buffer [bytes]
+
+
+/*---------------- Local functions ---------------*/
+static int  open_series_file(void);
+static bool read_file_header(FILE* file);
+static bool read_record_header(FILE* file, long long file_size, series_record_t* record);
+static bool apply_record(FILE* file, const series_record_t* record, unsigned char* image);
+static void print_snapshot_time(const series_record_t* record);
+static unsigned lz_compress(const unsigned char* src, unsigned length, unsigned char* dst, unsigned max_length);
+static bool lz_emit_sequence(unsigned char* dst, unsigned max_length, unsigned* out,
+    const unsigned char* literals, unsigned literal_length, unsigned offset, unsigned match_length);
+static unsigned lz_write_length(unsigned char* dst, unsigned out, unsigned length);
+static bool lz_decompress(const unsigned char* src, unsigned length, unsigned char* dst, unsigned dst_length);
+static bool lz_read_length(const unsigned char* src, unsigned length, unsigned* in, unsigned* value);
+
+
+/***
+ * @brief Append the snapshot to the series file if the -series argument was used.
+ *        Only the pages changed since the previous snapshot are stored.
+ *
+ * @param data    Snapshot of the g_rtedbg structure
+ * @param length  Snapshot size [bytes]
+ *
+ * @return GDB_OK    - no error or series not enabled
+ *         GDB_ERROR - snapshot not appended
+ */
+
+int series_append_snapshot(const void* data, unsigned length)
+{
+    if (parameters.series_file_name == NULL)
+    {
+        return GDB_OK;
+    }
+
+    if ((series_file == NULL) && (open_series_file() != GDB_OK))
+    {
+        return GDB_ERROR;
+    }
+
+    const unsigned char* snapshot = (const unsigned char*)data;
+    const unsigned pages = (length + SERIES_PAGE_SIZE - 1U) / SERIES_PAGE_SIZE;
+    const unsigned max_record_size = pages * (SERIES_PAGE_SIZE + sizeof(series_page_t));
+
+    if (max_record_size > record_buffer_size)
+    {
+        unsigned char* new_buffer = (unsigned char*)realloc(record_buffer, max_record_size);
+        if (new_buffer == NULL)
+        {
+            printf("\nCould not allocate memory for the snapshot series.");
+            return GDB_ERROR;
+        }
+
+        record_buffer = new_buffer;
+        record_buffer_size = max_record_size;
+    }
+
+    bool keyframe = (previous_snapshot == NULL) || (length != previous_size)
+        || ((records_since_keyframe + 1U) >= SERIES_KEYFRAME_INTERVAL);
+
+    series_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.magic = SERIES_RECORD_MAGIC;
+    record.number = snapshot_number + 1U;
+    record.structure_size = length;
+    record.flags = keyframe ? SERIES_KEYFRAME : 0U;
+
+    struct timespec now;
+    if (timespec_get(&now, TIME_UTC) != 0)
+    {
+        record.time_s = (int64_t)now.tv_sec;
+        record.time_ms = (uint32_t)(now.tv_nsec / 1000000L);
+    }
+
+    unsigned used = 0;
+
+    for (unsigned page = 0; page < pages; page++)
+    {
+        const unsigned offset = page * SERIES_PAGE_SIZE;
+        const unsigned page_length = ((length - offset) < SERIES_PAGE_SIZE) ? (length - offset) : SERIES_PAGE_SIZE;
+
+        if (!keyframe && (memcmp(&snapshot[offset], &previous_snapshot[offset], page_length) == 0))
+        {
+            continue;
+        }
+
+        series_page_t page_header;
+        page_header.page_index = page;
+        unsigned char* page_data = &record_buffer[used + sizeof(series_page_t)];
+        unsigned stored = 0;
+
+        if (parameters.series_compress)
+        {
+            stored = lz_compress(&snapshot[offset], page_length, page_data, page_length - 1U);
+        }
+
+        if (stored > 0)
+        {
+            page_header.stored_size = stored | SERIES_PAGE_COMPRESSED;
+        }
+        else
+        {
+            memcpy(page_data, &snapshot[offset], page_length);
+            stored = page_length;
+            page_header.stored_size = stored;
+        }
+
+        memcpy(&record_buffer[used], &page_header, sizeof(series_page_t));
+        used += sizeof(series_page_t) + stored;
+        record.page_count++;
+    }
+
+    record.payload_size = used;
+
+    if ((fwrite(&record, sizeof(record), 1U, series_file) != 1U)
+        || ((used > 0) && (fwrite(record_buffer, used, 1U, series_file) != 1U))
+        || (fflush(series_file) != 0))
+    {
+        printf("\nCould not write to the file: %s.", parameters.series_file_name);
+        series_close();         // The file is checked and the partial record removed when it is reopened
+        return GDB_ERROR;
+    }
+
+    if (length != previous_size)
+    {
+        free(previous_snapshot);
+        previous_snapshot = (unsigned char*)malloc(length);
+        previous_size = (previous_snapshot != NULL) ? length : 0;
+    }
+
+    if (previous_snapshot != NULL)
+    {
+        memcpy(previous_snapshot, snapshot, length);
+    }
+
+    snapshot_number = record.number;
+    records_since_keyframe = keyframe ? 0 : (records_since_keyframe + 1U);
+    return GDB_OK;
+}
+
+
+/***
+ * @brief Close the series file and release the buffers.
+ */
+
+void series_close(void)
+{
+    if (series_file != NULL)
+    {
+        (void)fclose(series_file);
+        series_file = NULL;
+    }
+
+    free(previous_snapshot);
+    previous_snapshot = NULL;
+    previous_size = 0;
+    free(record_buffer);
+    record_buffer = NULL;
+    record_buffer_size = 0;
+}
+
+
+/***
+ * @brief Open the series file and find the end of the last complete snapshot record.
+ *        A new file is created if it does not exist. An incomplete record at the end
+ *        of the file (e.g. the program was terminated while writing) is removed.
+ *
+ * @return GDB_OK    - file ready for the next snapshot
+ *         GDB_ERROR - file could not be opened or it is not a series file
+ */
+
+static int open_series_file(void)
+{
+    errno_t rez = fopen_s(&series_file, parameters.series_file_name, "r+b");
+
+    if ((rez != 0) || (series_file == NULL))
+    {
+        rez = fopen_s(&series_file, parameters.series_file_name, "w+b");
+        if ((rez != 0) || (series_file == NULL))
+        {
+            char error_text[256];
+            (void)strerror_s(error_text, sizeof(error_text), errno);
+            printf("\nCannot create file '%s' - error: %s.", parameters.series_file_name, error_text);
+            series_file = NULL;
+            return GDB_ERROR;
+        }
+
+        series_file_header_t header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, SERIES_FILE_MAGIC, sizeof(header.magic));
+        header.page_size = SERIES_PAGE_SIZE;
+
+        if (fwrite(&header, sizeof(header), 1U, series_file) != 1U)
+        {
+            printf("\nCould not write to the file: %s.", parameters.series_file_name);
+            series_close();
+            return GDB_ERROR;
+        }
+
+        snapshot_number = 0;
+        return GDB_OK;
+    }
+
+    if (!read_file_header(series_file))
+    {
+        printf("\nThe file '%s' is not a snapshot series file.", parameters.series_file_name);
+        series_close();
+        return GDB_ERROR;
+    }
+
+    (void)_fseeki64(series_file, 0, SEEK_END);
+    const long long file_size = _ftelli64(series_file);
+    long long end = sizeof(series_file_header_t);
+    series_record_t record;
+    snapshot_number = 0;
+
+    (void)_fseeki64(series_file, end, SEEK_SET);
+    while (read_record_header(series_file, file_size, &record))
+    {
+        end += (long long)sizeof(record) + record.payload_size;
+        snapshot_number = record.number;
+        (void)_fseeki64(series_file, end, SEEK_SET);
+    }
+
+    if (end < file_size)
+    {
+        printf("\nIncomplete snapshot removed from the end of '%s'.", parameters.series_file_name);
+        (void)fflush(series_file);
+        (void)_chsize_s(_fileno(series_file), end);
+    }
+
+    (void)_fseeki64(series_file, end, SEEK_SET);
+    records_since_keyframe = 0;
+    return GDB_OK;
+}
+
+
+/***
+ * @brief Read and check the series file header.
+ *
+ * @param file  Series file (positioned at the start)
+ *
+ * @return true - correct header
+ */
+
+static bool read_file_header(FILE* file)
+{
+    series_file_header_t header;
+
+    return (fread(&header, sizeof(header), 1U, file) == 1U)
+        && (memcmp(header.magic, SERIES_FILE_MAGIC, sizeof(header.magic)) == 0)
+        && (header.page_size == SERIES_PAGE_SIZE);
+}
+
+
+/***
+ * @brief Read the header of the next snapshot record and check that the complete
+ *        record is in the file.
+ *
+ * @param file       Series file (positioned at the start of the record)
+ * @param file_size  Size of the file [bytes]
+ * @param record     Record header
+ *
+ * @return true - complete record found
+ */
+
+static bool read_record_header(FILE* file, long long file_size, series_record_t* record)
+{
+    long long position = _ftelli64(file);
+
+    if (fread(record, sizeof(series_record_t), 1U, file) != 1U)
+    {
+        return false;
+    }
+
+    return (record->magic == SERIES_RECORD_MAGIC)
+        && (record->structure_size > 0) && (record->structure_size <= MAX_BUFFER_SIZE)
+        && ((position + (long long)sizeof(series_record_t) + record->payload_size) <= file_size);
+}
+
+
+/***
+ * @brief Rebuild the snapshot selected with the -extract=n argument from the series file
+ *        and write it to the binary file (-bin argument).
+ *
+ * @return 0 - no error
+ *         1 - snapshot not found or file operation failed
+ */
+
+int series_extract_snapshot(void)
+{
+    FILE* file;
+    errno_t rez = fopen_s(&file, parameters.series_file_name, "rb");
+
+    if ((rez != 0) || (file == NULL))
+    {
+        char error_text[256];
+        (void)strerror_s(error_text, sizeof(error_text), errno);
+        printf("\nCannot open file '%s' - error: %s.\n", parameters.series_file_name, error_text);
+        return 1;
+    }
+
+    if (!read_file_header(file))
+    {
+        printf("\nThe file '%s' is not a snapshot series file.\n", parameters.series_file_name);
+        (void)fclose(file);
+        return 1;
+    }
+
+    (void)_fseeki64(file, 0, SEEK_END);
+    const long long file_size = _ftelli64(file);
+    long long position = sizeof(series_file_header_t);
+    long long keyframe_position = -1;
+    unsigned snapshots = 0;
+    unsigned last_number = 0;
+    series_record_t record;
+    series_record_t selected;
+    memset(&selected, 0, sizeof(selected));
+
+    // Find the selected snapshot (0 = last one) and the last keyframe before it
+    (void)_fseeki64(file, position, SEEK_SET);
+    while (read_record_header(file, file_size, &record))
+    {
+        if ((parameters.extract_snapshot != 0) && (record.number > parameters.extract_snapshot))
+        {
+            break;
+        }
+
+        if ((record.flags & SERIES_KEYFRAME) != 0)
+        {
+            keyframe_position = position;
+        }
+
+        selected = record;
+        last_number = record.number;
+        snapshots++;
+        position += (long long)sizeof(record) + record.payload_size;
+        (void)_fseeki64(file, position, SEEK_SET);
+    }
+
+    if ((snapshots == 0) || (keyframe_position < 0)
+        || ((parameters.extract_snapshot != 0) && (last_number != parameters.extract_snapshot)))
+    {
+        printf("\nSnapshot %u not found in '%s'.\n", parameters.extract_snapshot, parameters.series_file_name);
+        (void)fclose(file);
+        return 1;
+    }
+
+    unsigned char* image = (unsigned char*)malloc(selected.structure_size);
+    if (image == NULL)
+    {
+        printf("\nCould not allocate memory buffer.\n");
+        (void)fclose(file);
+        return 1;
+    }
+
+    // Apply the records from the keyframe to the selected snapshot
+    bool ok = true;
+    (void)_fseeki64(file, keyframe_position, SEEK_SET);
+
+    do
+    {
+        ok = (fread(&record, sizeof(record), 1U, file) == 1U)
+            && (record.structure_size == selected.structure_size)
+            && apply_record(file, &record, image);
+    }
+    while (ok && (record.number != selected.number));
+
+    (void)fclose(file);
+
+    if (!ok)
+    {
+        printf("\nThe file '%s' is damaged - snapshot %u cannot be rebuilt.\n",
+            parameters.series_file_name, selected.number);
+        free(image);
+        return 1;
+    }
+
+    FILE* bin_file;
+    rez = fopen_s(&bin_file, parameters.bin_file_name, "wb");
+    if ((rez != 0) || (bin_file == NULL))
+    {
+        char error_text[256];
+        (void)strerror_s(error_text, sizeof(error_text), errno);
+        printf("\nCannot create file '%s' - error: %s.\n", parameters.bin_file_name, error_text);
+        free(image);
+        return 1;
+    }
+
+    size_t written = fwrite(image, 1U, selected.structure_size, bin_file);
+    free(image);
+
+    if ((fclose(bin_file) != 0) || (written != selected.structure_size))
+    {
+        printf("\nCould not write to the file: %s.\n", parameters.bin_file_name);
+        return 1;
+    }
+
+    printf("\nSnapshot %u captured at ", selected.number);
+    print_snapshot_time(&selected);
+    printf(" written to \"%s\"\n", parameters.bin_file_name);
+    return 0;
+}
+
+
+/***
+ * @brief Copy the pages stored in the record to the snapshot image.
+ *
+ * @param file    Series file (positioned after the record header)
+ * @param record  Record header
+ * @param image   Snapshot image (record->structure_size bytes)
+ *
+ * @return true - no error
+ */
+
+static bool apply_record(FILE* file, const series_record_t* record, unsigned char* image)
+{
+    unsigned char* page_data = (unsigned char*)malloc(SERIES_PAGE_SIZE);
+    if (page_data == NULL)
+    {
+        return false;
+    }
+
+    const unsigned pages = (record->structure_size + SERIES_PAGE_SIZE - 1U) / SERIES_PAGE_SIZE;
+    bool ok = true;
+
+    for (unsigned i = 0; ok && (i < record->page_count); i++)
+    {
+        series_page_t page;
+        if ((fread(&page, sizeof(page), 1U, file) != 1U) || (page.page_index >= pages))
+        {
+            ok = false;
+            break;
+        }
+
+        const unsigned offset = page.page_index * SERIES_PAGE_SIZE;
+        const unsigned page_length = ((record->structure_size - offset) < SERIES_PAGE_SIZE)
+            ? (record->structure_size - offset) : SERIES_PAGE_SIZE;
+        const bool compressed = (page.stored_size & SERIES_PAGE_COMPRESSED) != 0;
+        const unsigned stored = page.stored_size & ~SERIES_PAGE_COMPRESSED;
+
+        if ((stored > page_length) || (fread(page_data, 1U, stored, file) != stored))
+        {
+            ok = false;
+        }
+        else if (compressed)
+        {
+            ok = lz_decompress(page_data, stored, &image[offset], page_length);
+        }
+        else
+        {
+            ok = (stored == page_length);
+            memcpy(&image[offset], page_data, stored);
+        }
+    }
+
+    free(page_data);
+    return ok;
+}
+
+
+/***
+ * @brief Print the capture time of the snapshot (local time).
+ *
+ * @param record  Record header
+ */
+
+static void print_snapshot_time(const series_record_t* record)
+{
+    char date_text[32] = "?";
+    time_t capture_time = (time_t)record->time_s;
+    struct tm local_time;
+
+    if (localtime_s(&local_time, &capture_time) == 0)
+    {
+        (void)strftime(date_text, sizeof(date_text), "%Y-%m-%d %H:%M:%S", &local_time);
+    }
+
+    printf("%s.%03u", date_text, record->time_ms);
+}
+
+
+/***
+ * @brief Compress a block of data (LZ77 - format similar to the LZ4 block format).
+ *        Each sequence starts with a token (literal length in the upper and match
+ *        length - 4 in the lower nibble; 15 = the length continues in the following
+ *        bytes), followed by the literals, the 16-bit match offset and the rest of
+ *        the match length. The last sequence contains only literals.
+ *
+ * @param src         Data to be compressed (max. 64 kB)
+ * @param length      Number of bytes to compress
+ * @param dst         Buffer for the compressed data
+ * @param max_length  Size of the buffer
+ *
+ * @return Size of the compressed data, 0 - the data does not fit into the buffer
+ */
+
+static unsigned lz_compress(const unsigned char* src, unsigned length, unsigned char* dst, unsigned max_length)
+{
+    unsigned table[1U << LZ_HASH_BITS];     // Last position of each hashed 4-byte sequence
+    unsigned anchor = 0;                    // Start of the literals not yet written
+    unsigned pos = 0;
+    unsigned out = 0;
+    memset(table, 0, sizeof(table));
+
+    while ((pos + LZ_MIN_MATCH) <= length)
+    {
+        uint32_t sequence;
+        memcpy(&sequence, &src[pos], sizeof(sequence));
+        unsigned hash = (unsigned)((sequence * 2654435761U) >> (32U - LZ_HASH_BITS));
+        unsigned candidate = table[hash];
+        table[hash] = pos;
+
+        if ((candidate >= pos) || ((pos - candidate) > 0xFFFFU)
+            || (memcmp(&src[candidate], &src[pos], LZ_MIN_MATCH) != 0))
+        {
+            pos++;
+            continue;
+        }
+
+        unsigned match_length = LZ_MIN_MATCH;
+        while (((pos + match_length) < length) && (src[candidate + match_length] == src[pos + match_length]))
+        {
+            match_length++;
+        }
+
+        if (!lz_emit_sequence(dst, max_length, &out, &src[anchor], pos - anchor, pos - candidate, match_length))
+        {
+            return 0;
+        }
+
+        pos += match_length;
+        anchor = pos;
+    }
+
+    if (!lz_emit_sequence(dst, max_length, &out, &src[anchor], length - anchor, 0, 0))
+    {
+        return 0;
+    }
+
+    return out;
+}
+
+
+/***
+ * @brief Write a sequence of literals and a match to the compressed data.
+ *
+ * @param dst             Buffer for the compressed data
+ * @param max_length      Size of the buffer
+ * @param out             Number of bytes already in the buffer (updated)
+ * @param literals        Literal bytes
+ * @param literal_length  Number of literal bytes
+ * @param offset          Distance of the match from the current position
+ * @param match_length    Match length (0 - last sequence without a match)
+ *
+ * @return true - sequence written, false - not enough space in the buffer
+ */
+
+static bool lz_emit_sequence(unsigned char* dst, unsigned max_length, unsigned* out,
+    const unsigned char* literals, unsigned literal_length, unsigned offset, unsigned match_length)
+{
+    const unsigned match_code = (match_length > 0) ? (match_length - LZ_MIN_MATCH) : 0;
+    const unsigned max_size = 1U + (literal_length / 255U + 1U) + literal_length + 2U + (match_code / 255U + 1U);
+    unsigned o = *out;
+
+    if ((o + max_size) > max_length)
+    {
+        return false;
+    }
+
+    dst[o++] = (unsigned char)(((literal_length < 15U) ? literal_length : 15U) << 4U
+        | ((match_code < 15U) ? match_code : 15U));
+    o = lz_write_length(dst, o, literal_length);
+    memcpy(&dst[o], literals, literal_length);
+    o += literal_length;
+
+    if (match_length > 0)
+    {
+        dst[o++] = (unsigned char)(offset & 0xFFU);
+        dst[o++] = (unsigned char)(offset >> 8U);
+        o = lz_write_length(dst, o, match_code);
+    }
+
+    *out = o;
+    return true;
+}
+
+
+/***
+ * @brief Write the continuation bytes of a literal or match length (if length >= 15).
+ *
+ * @param dst     Buffer for the compressed data
+ * @param out     Current position in the buffer
+ * @param length  Literal length or match length - 4
+ *
+ * @return New position in the buffer
+ */
+
+static unsigned lz_write_length(unsigned char* dst, unsigned out, unsigned length)
+{
+    if (length < 15U)
+    {
+        return out;
+    }
+
+    length -= 15U;
+    while (length >= 255U)
+    {
+        dst[out++] = 255U;
+        length -= 255U;
+    }
+
+    dst[out++] = (unsigned char)length;
+    return out;
+}
+
+
+/***
+ * @brief Decompress the data compressed with lz_compress().
+ *
+ * @param src         Compressed data
+ * @param length      Size of the compressed data
+ * @param dst         Buffer for the decompressed data
+ * @param dst_length  Expected size of the decompressed data
+ *
+ * @return true - no error, false - the compressed data is damaged
+ */
+
+static bool lz_decompress(const unsigned char* src, unsigned length, unsigned char* dst, unsigned dst_length)
+{
+    unsigned in = 0;
+    unsigned out = 0;
+
+    while (in < length)
+    {
+        const unsigned token = src[in++];
+        unsigned literal_length = token >> 4U;
+
+        if (!lz_read_length(src, length, &in, &literal_length)
+            || (literal_length > (length - in)) || (literal_length > (dst_length - out)))
+        {
+            return false;
+        }
+
+        memcpy(&dst[out], &src[in], literal_length);
+        in += literal_length;
+        out += literal_length;
+
+        if (in >= length)
+        {
+            break;          // Last sequence
+        }
+
+        if ((length - in) < 2U)
+        {
+            return false;
+        }
+
+        const unsigned offset = src[in] | ((unsigned)src[in + 1U] << 8U);
+        in += 2U;
+        unsigned match_length = token & 0x0FU;
+
+        if (!lz_read_length(src, length, &in, &match_length))
+        {
+            return false;
+        }
+
+        match_length += LZ_MIN_MATCH;
+
+        if ((offset == 0) || (offset > out) || (match_length > (dst_length - out)))
+        {
+            return false;
+        }
+
+        for (unsigned i = 0; i < match_length; i++)     // The match may overlap the data being copied
+        {
+            dst[out] = dst[out - offset];
+            out++;
+        }
+    }
+
+    return out == dst_length;
+}
+
+
+/***
+ * @brief Read the continuation bytes of a literal or match length.
+ *
+ * @param src     Compressed data
+ * @param length  Size of the compressed data
+ * @param in      Current position in the compressed data (updated)
+ * @param value   Length from the token (updated)
+ *
+ * @return true - no error, false - end of data
+ */
+
+static bool lz_read_length(const unsigned char* src, unsigned length, unsigned* in, unsigned* value)
+{
+    if (*value < 15U)
+    {
+        return true;
+    }
+
+    for (;;)
+    {
+        if (*in >= length)
+        {
+            return false;
+        }
+
+        const unsigned char next = src[(*in)++];
+        *value += next;
+
+        if (next != 255U)
+        {
+            return true;
+        }
+    }
+}
+
+/*==== End of file ====*/
@@ -0,0 +1,19 @@
+/*
+ * Copyright (c) 2024 Branko Premzel.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * @file    snapshot_series.h
+ * @brief   Series of time-stamped snapshots in a single file (-series=file argument).
+ * @author  B. Premzel
+ */
+
+#pragma once
+
+int  series_append_snapshot(const void* data, unsigned length);
+void series_close(void);
+int  series_extract_snapshot(void);
+
+/*==== End of file ====*/
@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2024 Branko Premzel.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * @file    transfer_stats.cpp
+ * @brief   Timing of the GDB communication and data transfer steps (-stats argument).
+ * @author  B. Premzel
+ *
+ * The time spent sending the requests, waiting for and receiving the replies, decoding
+ * the memory read replies, writing the binary file and in each data transfer phase
+ * (see transfer_phases) is accumulated with the performance counter, together with
+ * the communication counters. The statistics are displayed with the 'T' key in the
+ * persistent mode and at the end of the program. They are also written to the
+ * -stats=file - in the JSON format if the file name extension is ".json", otherwise
+ * as a CSV file.
+ *
+ * The statistics are kept per thread - only for the main thread (not with -targets).
+ */
+
+#include "pch.h"
+#include <string.h>
+#include <stdint.h>
+#include "gdb_lib.h"
+#include "RTEgdbData.h"
+#include "cmd_line.h"
+#include "logger.h"
+#include "transfer_stats.h"
+
+static_assert((SPAN_PHASE_RESTORE - SPAN_PHASE_HEADER + 1) == TRANSFER_PHASES, "Update the stats_span_t phases");
+
+typedef struct
+{
+    unsigned long long count;           // Number of measurements
+    double total_ms;                    // Total time [ms]
+    double max_ms;                      // Longest measurement [ms]
+} span_data_t;
+
+
+/*---------------- GLOBAL VARIABLES ------------------*/
+thread_local bool stats_enabled = false;                     // true - statistics are collected
+thread_local unsigned long long stats_counters[STATS_COUNTERS];
+static thread_local span_data_t spans[STATS_SPANS];
+static thread_local double counter_period_ms;               // Performance counter period [ms]
+
+static const char* const span_names[STATS_SPANS] =
+{
+    "send", "wait", "recv", "decode", "file write",
+    "header", "pause", "read", "clear", "restore"
+};
+
+static const char* const counter_names[STATS_COUNTERS] =
+{
+    "bytes sent", "bytes received", "packets sent", "packets received", "retries", "timeouts", "transfers"
+};
+
+
+/*---------------- Local functions ---------------*/
+static void add_span_time(stats_span_t span, double time_ms);
+static bool json_file_name(const char* file_name);
+static void write_csv(FILE* file);
+static void write_json(FILE* file);
+
+
+/***
+ * @brief Clear the statistics and start collecting them if the -stats argument is used.
+ */
+
+void stats_init(void)
+{
+    memset(spans, 0, sizeof(spans));
+    memset(stats_counters, 0, sizeof(stats_counters));
+
+    LARGE_INTEGER frequency;
+    (void)QueryPerformanceFrequency(&frequency);
+    counter_period_ms = 1000.0 / (double)frequency.QuadPart;
+    stats_enabled = parameters.stats;
+}
+
+
+/***
+ * @brief Add the time elapsed since the start to the measured part.
+ *
+ * @param span   Measured part
+ * @param start  Start time
+ */
+
+void stats_add_span(stats_span_t span, const LARGE_INTEGER* start)
+{
+    LARGE_INTEGER now;
+    (void)QueryPerformanceCounter(&now);
+    add_span_time(span, (double)(now.QuadPart - start->QuadPart) * counter_period_ms);
+}
+
+
+/***
+ * @brief Add the duration of the data transfer phases.
+ *
+ * @param phase_times  Duration of the TRANSFER_PHASES phases [ms]
+ */
+
+void stats_add_phases(const double* phase_times)
+{
+    if (!stats_enabled)
+    {
+        return;
+    }
+
+    for (unsigned i = 0; i < TRANSFER_PHASES; i++)
+    {
+        add_span_time((stats_span_t)(SPAN_PHASE_HEADER + i), phase_times[i]);
+    }
+}
+
+
+/***
+ * @brief Add the duration measured by another thread (e.g. the background file writer).
+ *
+ * @param span     Measured part
+ * @param time_ms  Duration [ms]
+ */
+
+void stats_add_time(stats_span_t span, double time_ms)
+{
+    if (stats_enabled)
+    {
+        add_span_time(span, time_ms);
+    }
+}
+
+
+/***
+ * @brief Add a measurement to the measured part.
+ *
+ * @param span     Measured part
+ * @param time_ms  Duration [ms]
+ */
+
+static void add_span_time(stats_span_t span, double time_ms)
+{
+    span_data_t* data = &spans[span];
+    data->count++;
+    data->total_ms += time_ms;
+
+    if (time_ms > data->max_ms)
+    {
+        data->max_ms = time_ms;
+    }
+}
+
+
+/***
+ * @brief Display the statistics.
+ */
+
+void stats_display(void)
+{
+    if (!stats_enabled)
+    {
+        printf("\nStatistics not enabled - use the -stats argument.\n");
+        return;
+    }
+
+    printf("\n\nTransfer statistics"
+        "\n   Part          Count    Total [ms]  Average [us]    Max [us]");
+
+    for (unsigned i = 0; i < STATS_SPANS; i++)
+    {
+        const span_data_t* data = &spans[i];
+        double average_us = (data->count > 0) ? (data->total_ms * 1000.0 / (double)data->count) : 0.0;
+        printf("\n   %-10s %8llu %13.2f %13.1f %11.1f",
+            span_names[i], data->count, data->total_ms, average_us, data->max_ms * 1000.0);
+    }
+
+    for (unsigned i = 0; i < STATS_COUNTERS; i++)
+    {
+        printf("\n   %-16s %llu", counter_names[i], stats_counters[i]);
+    }
+
+    printf("\n");
+}
+
+
+/***
+ * @brief Write the statistics to the -stats=file (JSON or CSV format).
+ *
+ * @return GDB_OK    - file written or not defined
+ *         GDB_ERROR - file could not be written
+ */
+
+int stats_write_file(void)
+{
+    if (!stats_enabled || (parameters.stats_file == NULL))
+    {
+        return GDB_OK;
+    }
+
+    FILE* file;
+    if ((fopen_s(&file, parameters.stats_file, "w") != 0) || (file == NULL))
+    {
+        printf("\nCould not create the statistics file: %s.", parameters.stats_file);
+        return GDB_ERROR;
+    }
+
+    if (json_file_name(parameters.stats_file))
+    {
+        write_json(file);
+    }
+    else
+    {
+        write_csv(file);
+    }
+
+    (void)fclose(file);
+    return GDB_OK;
+}
+
+
+/***
+ * @brief Check if the file name extension is ".json".
+ *
+ * @param file_name  File name
+ *
+ * @return true - JSON file
+ */
+
+static bool json_file_name(const char* file_name)
+{
+    const char* extension = strrchr(file_name, '.');
+    return (extension != NULL) && (_stricmp(extension, ".json") == 0);
+}
+
+
+/***
+ * @brief Write the statistics in the CSV format.
+ *
+ * @param file  Output file
+ */
+
+static void write_csv(FILE* file)
+{
+    fprintf(file, "Part;Count;Total [ms];Average [us];Max [us]\n");
+
+    for (unsigned i = 0; i < STATS_SPANS; i++)
+    {
+        const span_data_t* data = &spans[i];
+        double average_us = (data->count > 0) ? (data->total_ms * 1000.0 / (double)data->count) : 0.0;
+        fprintf(file, "%s;%llu;%.3f;%.2f;%.2f\n",
+            span_names[i], data->count, data->total_ms, average_us, data->max_ms * 1000.0);
+    }
+
+    fprintf(file, "\nCounter;Value\n");
+
+    for (unsigned i = 0; i < STATS_COUNTERS; i++)
+    {
+        fprintf(file, "%s;%llu\n", counter_names[i], stats_counters[i]);
+    }
+}
+
+
+/***
+ * @brief Write the statistics in the JSON format.
+ *
+ * @param file  Output file
+ */
+
+static void write_json(FILE* file)
+{
+    fprintf(file, "{\n  \"spans\": {");
+
+    for (unsigned i = 0; i < STATS_SPANS; i++)
+    {
+        const span_data_t* data = &spans[i];
+        double average_us = (data->count > 0) ? (data->total_ms * 1000.0 / (double)data->count) : 0.0;
+        fprintf(file, "%s\n    \"%s\": { \"count\": %llu, \"total_ms\": %.3f, \"average_us\": %.2f, \"max_us\": %.2f }",
+            (i > 0) ? "," : "", span_names[i], data->count, data->total_ms, average_us, data->max_ms * 1000.0);
+    }
+
+    fprintf(file, "\n  },\n  \"counters\": {");
+
+    for (unsigned i = 0; i < STATS_COUNTERS; i++)
+    {
+        fprintf(file, "%s\n    \"%s\": %llu", (i > 0) ? "," : "", counter_names[i], stats_counters[i]);
+    }
+
+    fprintf(file, "\n  }\n}\n");
+}
+
+/*==== End of file ====*/
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2024 Branko Premzel.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/***
+ * @file    transfer_stats.h
+ * @brief   Timing of the GDB communication and data transfer steps (-stats argument).
+ * @author  B. Premzel
+ *
+ * The inline functions only check the stats_enabled flag if the statistics are disabled.
+ */
+
+#pragma once
+#include <WinSock2.h>
+#include <Windows.h>
+
+// Measured parts of the communication and data transfer
+typedef enum
+{
+    SPAN_SEND = 0,                      // Sending the requests - send()
+    SPAN_WAIT,                          // Waiting for the data from the GDB server
+    SPAN_RECV,                          // Receiving the data - recv()
+    SPAN_DECODE,                        // Decoding the memory read replies
+    SPAN_FILE_WRITE,                    // Writing the binary file
+    SPAN_PHASE_HEADER,                  // Data transfer phases - in the transfer_phases order
+    SPAN_PHASE_PAUSE,
+    SPAN_PHASE_READ,
+    SPAN_PHASE_CLEAR,
+    SPAN_PHASE_RESTORE,
+    STATS_SPANS                         // Number of measured parts
+} stats_span_t;
+
+typedef enum
+{
+    COUNT_BYTES_SENT = 0,               // Number of bytes sent to the GDB server
+    COUNT_BYTES_RECEIVED,               // Number of bytes received from the GDB server
+    COUNT_PACKETS_SENT,                 // Number of messages sent to the GDB server
+    COUNT_PACKETS_RECEIVED,             // Number of messages received from the GDB server
+    COUNT_RETRIES,                      // Memory read requests repeated because of a short reply
+    COUNT_TIMEOUTS,                     // Receive timeouts
+    COUNT_TRANSFERS,                    // Completed data transfers
+    STATS_COUNTERS                      // Number of counters
+} stats_counter_t;
+
+extern thread_local bool stats_enabled;
+extern thread_local unsigned long long stats_counters[STATS_COUNTERS];
+
+void stats_init(void);
+void stats_add_span(stats_span_t span, const LARGE_INTEGER* start);
+void stats_add_phases(const double* phase_times);
+void stats_add_time(stats_span_t span, double time_ms);
+void stats_display(void);
+int  stats_write_file(void);
+
+
+/***
+ * @brief Record the start time of a measured part (if the statistics are enabled).
+ *
+ * @param start  Start time
+ */
+
+static inline void stats_span_start(LARGE_INTEGER* start)
+{
+    if (stats_enabled)
+    {
+        (void)QueryPerformanceCounter(start);
+    }
+}
+
+
+/***
+ * @brief Add the time elapsed since the start to the measured part.
+ *
+ * @param span   Measured part
+ * @param start  Start time recorded with stats_span_start()
+ */
+
+static inline void stats_span_end(stats_span_t span, const LARGE_INTEGER* start)
+{
+    if (stats_enabled)
+    {
+        stats_add_span(span, start);
+    }
+}
+
+
+/***
+ * @brief Increment the counter.
+ *
+ * @param counter  Counter
+ * @param value    Value added to the counter
+ */
+
+static inline void stats_count(stats_counter_t counter, unsigned long long value)
+{
+    if (stats_enabled)
+    {
+        stats_counters[counter] += value;
+    }
+}
+
+/*==== End of file ====*/